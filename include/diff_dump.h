@@ -5,10 +5,19 @@
 
 #include "expression_types.h"
 
+//Logging is optional: with NULL log_info the whole call costs one branch
+#define _LATEX_LOG_WRITE(_log_info, ...) {                            \
+    if((_log_info) != NULL) {                                         \
+        _RETURN_IF_ERROR(latex_log_write((_log_info), __VA_ARGS__));  \
+    }                                                                 \
+}
+
 enum log_action_t {
     DIFFERENTIATION,
     SIMPLIFICATION_EVALUATE,
     SIMPLIFICATION_NEUTRALS,
+    SIMPLIFICATION_NORMALIZE,
+    SIMPLIFICATION_SATURATE,
     WRITING_RESULT,
     DIFF_START,
     DIFF_RESULT,
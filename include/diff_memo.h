@@ -0,0 +1,15 @@
+#ifndef DIFF_MEMO_H
+#define DIFF_MEMO_H
+
+#include "expression_types.h"
+
+expression_error_t diff_memo_ctor (diff_memo_t       *memo,
+                                   expression_node_t *root);
+
+diff_memo_entry_t *diff_memo_find (diff_memo_t       *memo,
+                                   expression_node_t *node);
+
+expression_error_t diff_memo_dtor (diff_memo_t       *memo,
+                                   expression_t      *derivative);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef DIFF_PARALLEL_H
+#define DIFF_PARALLEL_H
+
+#include "expression_types.h"
+
+expression_error_t diff_parallel_ctor (diff_parallel_t   *parallel,
+                                       expression_node_t *root,
+                                       size_t             threads_number);
+
+expression_error_t diff_parallel_run  (diff_parallel_t   *parallel,
+                                       expression_t      *derivative,
+                                       size_t             diff_variable,
+                                       size_t             threads_number);
+
+expression_node_t *diff_parallel_take (diff_parallel_t   *parallel,
+                                       expression_node_t *node);
+
+expression_error_t diff_parallel_dtor (diff_parallel_t   *parallel,
+                                       expression_t      *derivative);
+
+#endif
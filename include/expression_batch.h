@@ -0,0 +1,18 @@
+#ifndef EXPRESSION_BATCH_H
+#define EXPRESSION_BATCH_H
+
+#include "expression_types.h"
+
+expression_error_t expression_evaluate_batch (expression_t        *expression,
+                                              const double *const *inputs,
+                                              size_t               points_number,
+                                              double              *outputs);
+
+//Instantiated for double and float, float blocks have twice as many points
+template <typename Scalar>
+expression_error_t bytecode_evaluate_batch   (const bytecode_t    *bytecode,
+                                              const Scalar *const *inputs,
+                                              size_t               points_number,
+                                              Scalar              *outputs);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef EXPRESSION_BUDGET_H
+#define EXPRESSION_BUDGET_H
+
+#include "expression_types.h"
+
+expression_error_t expression_budget_ctor   (expression_budget_t *budget,
+                                             double               seconds,
+                                             size_t               max_nodes);
+
+expression_error_t expression_budget_cancel (expression_budget_t *budget);
+
+expression_error_t expression_budget_check  (expression_budget_t *budget,
+                                             size_t               nodes_number);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef EXPRESSION_BUILDERS_H
+#define EXPRESSION_BUILDERS_H
+
+#include "expression_types.h"
+
+enum build_fold_t {
+    BUILD_FOLD_NONE ,
+    BUILD_FOLD_CONST,
+    BUILD_FOLD_LEFT ,
+    BUILD_FOLD_RIGHT,
+};
+
+expression_node_t *build_operation     (expression_t      *expression,
+                                        operation_t        operation,
+                                        expression_node_t *left,
+                                        expression_node_t *right,
+                                        latex_log_info_t  *log_info);
+
+expression_node_t *build_apply_fold    (expression_t      *expression,
+                                        build_fold_t       fold,
+                                        operation_t        operation,
+                                        expression_node_t *left,
+                                        expression_node_t *right,
+                                        double             value,
+                                        latex_log_info_t  *log_info);
+
+bool               is_binary_operation (operation_t        operation);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef EXPRESSION_BYTECODE_H
+#define EXPRESSION_BYTECODE_H
+
+#include "expression_types.h"
+
+expression_error_t bytecode_ctor     (bytecode_t       *bytecode,
+                                      expression_t     *expression);
+
+expression_error_t bytecode_evaluate (bytecode_t       *bytecode,
+                                      variables_list_t *variables_list,
+                                      double           *result);
+
+double             bytecode_run      (const bytecode_t *bytecode,
+                                      double           *registers);
+
+expression_error_t bytecode_dtor     (bytecode_t       *bytecode);
+
+//Instantiated for float, double, long double, dual_t and interval_t
+template <typename Scalar>
+Scalar             bytecode_run_scalar     (const bytecode_t *bytecode,
+                                            Scalar           *registers);
+
+template <typename Scalar>
+void               bytecode_load_constants (const bytecode_t *bytecode,
+                                            Scalar           *registers);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef EXPRESSION_COST_H
+#define EXPRESSION_COST_H
+
+#include "expression_types.h"
+
+expression_error_t expression_estimate_cost (expression_t      *expression,
+                                             expression_cost_t *cost);
+
+expression_cost_t  subtree_estimate_cost    (expression_node_t *node);
+
+double             operation_flops          (operation_t        operation);
+
+bool               is_square_power_cheaper  (expression_node_t *base);
+
+#endif
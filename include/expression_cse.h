@@ -0,0 +1,21 @@
+#ifndef EXPRESSION_CSE_H
+#define EXPRESSION_CSE_H
+
+#include "expression_types.h"
+
+static const size_t CseNoOperand = (size_t)-1;
+
+expression_error_t cse_program_ctor               (cse_program_t     *program,
+                                                   expression_node_t *root);
+
+expression_error_t cse_program_evaluate           (cse_program_t     *program,
+                                                   variables_list_t  *variables_list,
+                                                   double            *result);
+
+expression_error_t cse_program_mark_substitutions (cse_program_t     *program,
+                                                   expression_node_t *root,
+                                                   latex_log_info_t  *log_info);
+
+expression_error_t cse_program_dtor               (cse_program_t     *program);
+
+#endif
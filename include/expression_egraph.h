@@ -0,0 +1,24 @@
+#ifndef EXPRESSION_EGRAPH_H
+#define EXPRESSION_EGRAPH_H
+
+#include "expression_types.h"
+
+static const egraph_limits_t EgraphDefaultLimits = {
+    .max_nodes      = 50000,
+    .max_iterations = 12,
+    .max_seconds    = 0.5,
+    .max_matches    = 20000,
+    .rule_matches   = 2000,
+    .rule_ban       = 1,
+};
+
+expression_error_t expression_saturate (expression_t          *expression,
+                                        egraph_cost_t          cost,
+                                        const egraph_limits_t *limits,
+                                        latex_log_info_t      *log_info);
+
+double             egraph_cost_nodes   (egraph_node_t         *node);
+
+double             egraph_cost_flops   (egraph_node_t         *node);
+
+#endif
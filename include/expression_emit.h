@@ -0,0 +1,21 @@
+#ifndef EXPRESSION_EMIT_H
+#define EXPRESSION_EMIT_H
+
+#include <stdio.h>
+
+#include "expression_types.h"
+
+expression_error_t emit_cpp_header_begin    (FILE         *file);
+
+expression_error_t emit_cpp_function        (FILE         *file,
+                                             expression_t *expression,
+                                             const char   *name);
+
+expression_error_t emit_cpp_header_end      (FILE         *file);
+
+void               emit_write_power_helpers (FILE         *file,
+                                             const char   *integer_qualifier,
+                                             const char   *power_qualifier,
+                                             const char   *math_namespace);
+
+#endif
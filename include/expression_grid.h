@@ -0,0 +1,13 @@
+#ifndef EXPRESSION_GRID_H
+#define EXPRESSION_GRID_H
+
+#include "expression_types.h"
+
+expression_error_t grid_evaluate (const grid_t  *grid,
+                                  expression_t  *expression,
+                                  expression_t  *derivative,
+                                  size_t         threads_number,
+                                  const char    *filename,
+                                  grid_format_t  format);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef EXPRESSION_INCREMENTAL_H
+#define EXPRESSION_INCREMENTAL_H
+
+#include "expression_types.h"
+
+expression_error_t incremental_ctor         (incremental_evaluator_t *evaluator,
+                                             expression_t            *expression);
+
+expression_error_t incremental_set_variable (incremental_evaluator_t *evaluator,
+                                             size_t                   index,
+                                             double                   value);
+
+expression_error_t incremental_evaluate     (incremental_evaluator_t *evaluator,
+                                             double                  *result);
+
+expression_error_t incremental_dtor         (incremental_evaluator_t *evaluator);
+
+#endif
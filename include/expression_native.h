@@ -0,0 +1,21 @@
+#ifndef EXPRESSION_NATIVE_H
+#define EXPRESSION_NATIVE_H
+
+#include <stdio.h>
+
+#include "expression_types.h"
+
+expression_error_t native_code_ctor     (native_code_t    *native_code,
+                                         expression_t     *expression,
+                                         const char       *cache_directory);
+
+expression_error_t native_code_evaluate (native_code_t    *native_code,
+                                         variables_list_t *variables_list,
+                                         double           *result);
+
+expression_error_t native_code_dtor     (native_code_t    *native_code);
+
+expression_error_t native_write_source  (const bytecode_t *bytecode,
+                                         FILE             *file);
+
+#endif
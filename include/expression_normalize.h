@@ -0,0 +1,12 @@
+#ifndef EXPRESSION_NORMALIZE_H
+#define EXPRESSION_NORMALIZE_H
+
+#include "expression_types.h"
+
+expression_error_t expression_normalize (expression_t      *expression,
+                                         latex_log_info_t  *log_info);
+
+int                normalize_compare    (expression_node_t *first,
+                                         expression_node_t *second);
+
+#endif
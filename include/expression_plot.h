@@ -0,0 +1,19 @@
+#ifndef EXPRESSION_PLOT_H
+#define EXPRESSION_PLOT_H
+
+#include "expression_types.h"
+
+expression_error_t plot_ctor   (plot_t                *plot);
+
+expression_error_t plot_sample (plot_t                *plot,
+                                expression_t          *expression,
+                                expression_t          *derivative,
+                                expression_t          *second_derivative,
+                                const plot_settings_t *settings);
+
+expression_error_t plot_write  (const plot_t          *plot,
+                                const char            *filename);
+
+expression_error_t plot_dtor   (plot_t                *plot);
+
+#endif
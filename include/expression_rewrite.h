@@ -0,0 +1,26 @@
+#ifndef EXPRESSION_REWRITE_H
+#define EXPRESSION_REWRITE_H
+
+#include "expression_types.h"
+
+static const size_t RewriteNoRule = (size_t)-1;
+
+expression_error_t rewriter_ctor      (rewriter_t         *rewriter);
+
+expression_error_t rewriter_add_rule  (rewriter_t         *rewriter,
+                                       const char         *rule);
+
+expression_error_t rewriter_load_file (rewriter_t         *rewriter,
+                                       const char         *filename);
+
+size_t             rewriter_find      (rewriter_t         *rewriter,
+                                       expression_node_t  *node);
+
+expression_error_t rewriter_apply     (rewriter_t         *rewriter,
+                                       expression_t       *expression,
+                                       expression_node_t **node,
+                                       size_t              rule);
+
+expression_error_t rewriter_dtor      (rewriter_t         *rewriter);
+
+#endif
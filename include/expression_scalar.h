@@ -0,0 +1,440 @@
+#ifndef EXPRESSION_SCALAR_H
+#define EXPRESSION_SCALAR_H
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "utils.h"
+
+/*=========================================================================================================*/
+/* Operations are written once for any scalar type which has arithmetic operators and functions sin, log  */
+/* and so on. Besides float, double and long double these are dual numbers and intervals defined below.   */
+/* Tree and bytecode walkers call run_scalar_kernel, so each of them is compiled for every type.          */
+/*=========================================================================================================*/
+
+template <typename Scalar>
+inline Scalar scalar_constant(double value) {
+    return (Scalar)value;
+}
+
+template <>
+inline dual_t scalar_constant<dual_t>(double value) {
+    return {value, 0};
+}
+
+template <>
+inline interval_t scalar_constant<interval_t>(double value) {
+    return {value, value};
+}
+
+//Value which does not change with variables, or NAN, it decides if power is a multiplication chain
+inline double scalar_constant_value(double value) {
+    return value;
+}
+
+inline double scalar_constant_value(float value) {
+    return value;
+}
+
+inline double scalar_constant_value(long double value) {
+    return (double)value;
+}
+
+inline double scalar_constant_value(dual_t value) {
+    return fpclassify(value.derivative) == FP_ZERO ? value.value : NAN;
+}
+
+inline double scalar_constant_value(interval_t value) {
+    return value.lower < value.upper ? NAN : value.lower;
+}
+
+/*=========================================================================================================*/
+/* Dual numbers                                                                                            */
+/*=========================================================================================================*/
+
+inline dual_t operator+(dual_t left, dual_t right) {
+    return {left.value + right.value, left.derivative + right.derivative};
+}
+
+inline dual_t operator-(dual_t left, dual_t right) {
+    return {left.value - right.value, left.derivative - right.derivative};
+}
+
+inline dual_t operator*(dual_t left, dual_t right) {
+    return {left.value * right.value, left.derivative * right.value + left.value * right.derivative};
+}
+
+inline dual_t operator/(dual_t left, dual_t right) {
+    return {left.value / right.value,
+            (left.derivative * right.value - left.value * right.derivative) / (right.value * right.value)};
+}
+
+inline dual_t sin(dual_t x) {
+    return {sin(x.value), cos(x.value) * x.derivative};
+}
+
+inline dual_t cos(dual_t x) {
+    return {cos(x.value), -sin(x.value) * x.derivative};
+}
+
+inline dual_t tan(dual_t x) {
+    double value = tan(x.value);
+    return {value, (1 + value * value) * x.derivative};
+}
+
+inline dual_t log(dual_t x) {
+    return {log(x.value), x.derivative / x.value};
+}
+
+inline dual_t asin(dual_t x) {
+    return {asin(x.value), x.derivative / sqrt(1 - x.value * x.value)};
+}
+
+inline dual_t acos(dual_t x) {
+    return {acos(x.value), -x.derivative / sqrt(1 - x.value * x.value)};
+}
+
+inline dual_t atan(dual_t x) {
+    return {atan(x.value), x.derivative / (1 + x.value * x.value)};
+}
+
+inline dual_t sinh(dual_t x) {
+    return {sinh(x.value), cosh(x.value) * x.derivative};
+}
+
+inline dual_t cosh(dual_t x) {
+    return {cosh(x.value), sinh(x.value) * x.derivative};
+}
+
+inline dual_t tanh(dual_t x) {
+    double value = tanh(x.value);
+    return {value, (1 - value * value) * x.derivative};
+}
+
+//Constant exponent does not need logarithm, so negative bases keep their derivative
+inline dual_t pow(dual_t base, dual_t exponent) {
+    double value = pow(base.value, exponent.value);
+    if(fpclassify(exponent.derivative) == FP_ZERO) {
+        return {value, exponent.value * pow(base.value, exponent.value - 1) * base.derivative};
+    }
+    return {value, value * (exponent.derivative * log(base.value) + exponent.value * base.derivative / base.value)};
+}
+
+/*=========================================================================================================*/
+/* Intervals. Every bound is moved outwards by one ulp, so rounding never makes interval too narrow.      */
+/* Bound which is not a number makes the whole interval {NAN, NAN}: nothing is known about the value.     */
+/* Functions with restricted domain give bounds of their values on the part of interval inside domain.    */
+/*=========================================================================================================*/
+
+inline bool interval_is_nan(interval_t x) {
+    return isnan(x.lower) || isnan(x.upper);
+}
+
+inline interval_t interval_widen(double lower, double upper) {
+    if(isnan(lower) || isnan(upper)) {
+        return {NAN, NAN};
+    }
+    return {nextafter(lower, -INFINITY), nextafter(upper, INFINITY)};
+}
+
+//fmin and fmax drop NAN, so it is checked before them
+inline interval_t interval_hull(double first, double second, double third, double fourth) {
+    if(isnan(first) || isnan(second) || isnan(third) || isnan(fourth)) {
+        return {NAN, NAN};
+    }
+    return interval_widen(fmin(fmin(first, second), fmin(third, fourth)),
+                          fmax(fmax(first, second), fmax(third, fourth)));
+}
+
+//Checks if phase + period * k is inside of interval for some integer k
+inline bool interval_contains_phase(interval_t x, double phase, double period) {
+    return phase + period * ceil((x.lower - phase) / period) <= x.upper;
+}
+
+inline interval_t operator+(interval_t left, interval_t right) {
+    return interval_widen(left.lower + right.lower, left.upper + right.upper);
+}
+
+inline interval_t operator-(interval_t left, interval_t right) {
+    return interval_widen(left.lower - right.upper, left.upper - right.lower);
+}
+
+inline interval_t operator*(interval_t left, interval_t right) {
+    return interval_hull(left.lower * right.lower, left.lower * right.upper,
+                         left.upper * right.lower, left.upper * right.upper);
+}
+
+inline interval_t operator/(interval_t left, interval_t right) {
+    if(interval_is_nan(left) || interval_is_nan(right)) {
+        return {NAN, NAN};
+    }
+    if(right.lower <= 0 && right.upper >= 0) {
+        return {-INFINITY, INFINITY};
+    }
+    return interval_hull(left.lower / right.lower, left.lower / right.upper,
+                         left.upper / right.lower, left.upper / right.upper);
+}
+
+inline interval_t sin(interval_t x) {
+    if(interval_is_nan(x)) {
+        return x;
+    }
+    if(!(x.upper - x.lower < 2 * M_PI)) {
+        return {-1, 1};
+    }
+    interval_t result = interval_widen(fmin(sin(x.lower), sin(x.upper)), fmax(sin(x.lower), sin(x.upper)));
+    result.upper = interval_contains_phase(x,  M_PI / 2, 2 * M_PI) ? 1 : fmin(result.upper,  1);
+    result.lower = interval_contains_phase(x, -M_PI / 2, 2 * M_PI) ? -1 : fmax(result.lower, -1);
+    return result;
+}
+
+inline interval_t cos(interval_t x) {
+    if(interval_is_nan(x)) {
+        return x;
+    }
+    if(!(x.upper - x.lower < 2 * M_PI)) {
+        return {-1, 1};
+    }
+    interval_t result = interval_widen(fmin(cos(x.lower), cos(x.upper)), fmax(cos(x.lower), cos(x.upper)));
+    result.upper = interval_contains_phase(x, 0,    2 * M_PI) ? 1 : fmin(result.upper,  1);
+    result.lower = interval_contains_phase(x, M_PI, 2 * M_PI) ? -1 : fmax(result.lower, -1);
+    return result;
+}
+
+inline interval_t tan(interval_t x) {
+    if(interval_is_nan(x)) {
+        return x;
+    }
+    if(!(x.upper - x.lower < M_PI) || interval_contains_phase(x, M_PI / 2, M_PI)) {
+        return {-INFINITY, INFINITY};
+    }
+    return interval_widen(tan(x.lower), tan(x.upper));
+}
+
+//Interval entirely outside of domain gives NAN from the upper bound
+inline interval_t log(interval_t x) {
+    if(interval_is_nan(x)) {
+        return x;
+    }
+    return interval_widen(x.lower > 0 ? log(x.lower) : -INFINITY, log(x.upper));
+}
+
+inline interval_t asin(interval_t x) {
+    if(!(x.lower <= 1 && x.upper >= -1)) {
+        return {NAN, NAN};
+    }
+    return interval_widen(asin(fmax(x.lower, -1)), asin(fmin(x.upper, 1)));
+}
+
+inline interval_t acos(interval_t x) {
+    if(!(x.lower <= 1 && x.upper >= -1)) {
+        return {NAN, NAN};
+    }
+    return interval_widen(acos(fmin(x.upper, 1)), acos(fmax(x.lower, -1)));
+}
+
+inline interval_t atan(interval_t x) {
+    return interval_widen(atan(x.lower), atan(x.upper));
+}
+
+inline interval_t sinh(interval_t x) {
+    return interval_widen(sinh(x.lower), sinh(x.upper));
+}
+
+inline interval_t cosh(interval_t x) {
+    if(interval_is_nan(x)) {
+        return x;
+    }
+    double upper = fmax(cosh(x.lower), cosh(x.upper));
+    if(x.lower <= 0 && x.upper >= 0) {
+        return interval_widen(1, upper);
+    }
+    return interval_widen(fmin(cosh(x.lower), cosh(x.upper)), upper);
+}
+
+inline interval_t tanh(interval_t x) {
+    return interval_widen(tanh(x.lower), tanh(x.upper));
+}
+
+//Power is monotonic by each argument for positive base, other bases have no real power
+inline interval_t pow(interval_t base, interval_t exponent) {
+    if(!(base.lower > 0)) {
+        return {NAN, NAN};
+    }
+    return interval_hull(pow(base.lower, exponent.lower), pow(base.lower, exponent.upper),
+                         pow(base.upper, exponent.lower), pow(base.upper, exponent.upper));
+}
+
+//Multiplication chain would count the same variable as independent, so even powers are done exactly
+inline interval_t run_scalar_integer_power(interval_t base, long power) {
+    if(interval_is_nan(base)) {
+        return base;
+    }
+    if(power < 0) {
+        return scalar_constant<interval_t>(1) / run_scalar_integer_power(base, -power);
+    }
+    if(power == 0) {
+        return scalar_constant<interval_t>(1);
+    }
+    double lower = run_integer_power(base.lower, power);
+    double upper = run_integer_power(base.upper, power);
+    if(power % 2 == 1) {
+        return interval_widen(lower, upper);
+    }
+    if(base.lower <= 0 && base.upper >= 0) {
+        return interval_widen(0, fmax(lower, upper));
+    }
+    return interval_widen(fmin(lower, upper), fmax(lower, upper));
+}
+
+/*=========================================================================================================*/
+/* Kernels                                                                                                 */
+/*=========================================================================================================*/
+
+//Small integer powers are multiplication chains, negative ones are reciprocals of them
+template <typename Scalar>
+inline Scalar run_scalar_integer_power(Scalar base, long power) {
+    switch(power) {
+        case -2: {
+            return scalar_constant<Scalar>(1) / (base * base);
+        }
+        case -1: {
+            return scalar_constant<Scalar>(1) / base;
+        }
+        case 2: {
+            return base * base;
+        }
+        case 3: {
+            return base * base * base;
+        }
+        default: {
+            break;
+        }
+    }
+    unsigned long rest   = (unsigned long)labs(power);
+    Scalar        result = scalar_constant<Scalar>(1);
+    while(rest != 0) {
+        if(rest & 1) {
+            result = result * base;
+        }
+        base = base * base;
+        rest >>= 1;
+    }
+    return power < 0 ? scalar_constant<Scalar>(1) / result : result;
+}
+
+template <typename Scalar>
+inline Scalar run_scalar_power(Scalar base, Scalar exponent) {
+    double constant = scalar_constant_value(exponent);
+    if(fabs(constant) > (double)MaxIntegerPower || !is_integer(constant)) {
+        return pow(base, exponent);
+    }
+    return run_scalar_integer_power(base, (long)constant);
+}
+
+//Unary operations use only right operand
+template <operation_t Operation, typename Scalar>
+inline Scalar run_scalar_kernel(Scalar left, Scalar right) {
+    if      constexpr (Operation == OPERATION_ADD   ) { return left + right;                                   }
+    else if constexpr (Operation == OPERATION_SUB   ) { return left - right;                                   }
+    else if constexpr (Operation == OPERATION_DIV   ) { return left / right;                                   }
+    else if constexpr (Operation == OPERATION_MUL   ) { return left * right;                                   }
+    else if constexpr (Operation == OPERATION_SIN   ) { return sin(right);                                     }
+    else if constexpr (Operation == OPERATION_COS   ) { return cos(right);                                     }
+    else if constexpr (Operation == OPERATION_POW   ) { return run_scalar_power(left, right);                  }
+    else if constexpr (Operation == OPERATION_LN    ) { return log(right);                                     }
+    else if constexpr (Operation == OPERATION_LOG   ) { return log(right) / log(left);                         }
+    else if constexpr (Operation == OPERATION_TG    ) { return tan(right);                                     }
+    else if constexpr (Operation == OPERATION_CTG   ) { return scalar_constant<Scalar>(1) / tan(right);        }
+    else if constexpr (Operation == OPERATION_ARCSIN) { return asin(right);                                    }
+    else if constexpr (Operation == OPERATION_ARCCOS) { return acos(right);                                    }
+    else if constexpr (Operation == OPERATION_ARCTG ) { return atan(right);                                    }
+    else if constexpr (Operation == OPERATION_ARCCTG) { return scalar_constant<Scalar>(M_PI * 0.5) - atan(right); }
+    else if constexpr (Operation == OPERATION_SH    ) { return sinh(right);                                    }
+    else if constexpr (Operation == OPERATION_CH    ) { return cosh(right);                                    }
+    else if constexpr (Operation == OPERATION_TH    ) { return tanh(right);                                    }
+    else if constexpr (Operation == OPERATION_CTH   ) { return scalar_constant<Scalar>(1) / tanh(right);       }
+    else                                              { return scalar_constant<Scalar>(NAN);                   }
+}
+
+template <typename Scalar>
+inline Scalar run_scalar_operation(Scalar left, Scalar right, operation_t operation) {
+    #define _KERNEL_CASE(operation_code) case operation_code: return run_scalar_kernel<operation_code>(left, right);
+    switch(operation) {
+        _KERNEL_CASE(OPERATION_ADD   )
+        _KERNEL_CASE(OPERATION_SUB   )
+        _KERNEL_CASE(OPERATION_DIV   )
+        _KERNEL_CASE(OPERATION_MUL   )
+        _KERNEL_CASE(OPERATION_SIN   )
+        _KERNEL_CASE(OPERATION_COS   )
+        _KERNEL_CASE(OPERATION_POW   )
+        _KERNEL_CASE(OPERATION_LN    )
+        _KERNEL_CASE(OPERATION_LOG   )
+        _KERNEL_CASE(OPERATION_TG    )
+        _KERNEL_CASE(OPERATION_CTG   )
+        _KERNEL_CASE(OPERATION_ARCSIN)
+        _KERNEL_CASE(OPERATION_ARCCOS)
+        _KERNEL_CASE(OPERATION_ARCTG )
+        _KERNEL_CASE(OPERATION_ARCCTG)
+        _KERNEL_CASE(OPERATION_SH    )
+        _KERNEL_CASE(OPERATION_CH    )
+        _KERNEL_CASE(OPERATION_TH    )
+        _KERNEL_CASE(OPERATION_CTH   )
+        case OPERATION_UNKNOWN: {
+            return scalar_constant<Scalar>(NAN);
+        }
+        default: {
+            return scalar_constant<Scalar>(NAN);
+        }
+    }
+    #undef _KERNEL_CASE
+}
+
+/*=========================================================================================================*/
+/* Tree walker                                                                                             */
+/*=========================================================================================================*/
+
+template <typename Scalar>
+inline expression_error_t evaluate_scalar_node(expression_node_t *node,
+                                               const Scalar      *variables,
+                                               Scalar            *output) {
+    if(node == NULL) {
+        return EXPRESSION_NODE_NULL_POINTER;
+    }
+    if(node->type == NODE_TYPE_NUM) {
+        *output = scalar_constant<Scalar>(node->value.numeric_value);
+        return EXPRESSION_SUCCESS;
+    }
+    if(node->type == NODE_TYPE_VAR) {
+        *output = variables[node->value.variable_index];
+        return EXPRESSION_SUCCESS;
+    }
+    if(node->type == NODE_TYPE_OP) {
+        Scalar left  = scalar_constant<Scalar>(0);
+        Scalar right = scalar_constant<Scalar>(0);
+        if(node->left != NULL) {
+            _RETURN_IF_ERROR(evaluate_scalar_node(node->left, variables, &left));
+        }
+        if(node->right != NULL) {
+            _RETURN_IF_ERROR(evaluate_scalar_node(node->right, variables, &right));
+        }
+        *output = run_scalar_operation(left, right, node->value.operation);
+        return EXPRESSION_SUCCESS;
+    }
+    return EXPRESSION_UNKNOWN_NODE_TYPE;
+}
+
+//variables[i] is the value of variable with index i in variables list
+template <typename Scalar>
+inline expression_error_t expression_evaluate_scalar(expression_t *expression,
+                                                     const Scalar *variables,
+                                                     Scalar       *result) {
+    if(expression == NULL || variables == NULL || result == NULL) {
+        return EXPRESSION_NULL_POINTER;
+    }
+    return evaluate_scalar_node(expression->root, variables, result);
+}
+
+#endif
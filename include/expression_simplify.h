@@ -3,37 +3,14 @@
 
 #include "expression_types.h"
 
-expression_error_t expression_simplify   (expression_t       *expression,
-                                          latex_log_info_t   *log_info);
+expression_error_t expression_simplify       (expression_t            *expression,
+                                             latex_log_info_t        *log_info);
 
-expression_error_t simplify_neutrals_add (expression_t       *expression,
-                                          expression_node_t  *node,
-                                          expression_node_t **result,
-                                          latex_log_info_t   *log_info);
+expression_error_t expression_simplify_bound (expression_t            *expression,
+                                             const bound_variables_t *bound,
+                                             latex_log_info_t        *log_info);
 
-expression_error_t simplify_neutrals_sub (expression_t       *expression,
-                                          expression_node_t  *node,
-                                          expression_node_t **result,
-                                          latex_log_info_t   *log_info);
-
-expression_error_t simplify_neutrals_mul (expression_t       *expression,
-                                          expression_node_t  *node,
-                                          expression_node_t **result,
-                                          latex_log_info_t   *log_info);
-
-expression_error_t simplify_neutrals_div (expression_t       *expression,
-                                          expression_node_t  *node,
-                                          expression_node_t **result,
-                                          latex_log_info_t   *log_info);
-
-expression_error_t simplify_neutrals_pow (expression_t       *expression,
-                                          expression_node_t  *node,
-                                          expression_node_t **result,
-                                          latex_log_info_t   *log_info);
-
-expression_error_t simplify_neutrals_log (expression_t       *expression,
-                                         expression_node_t  *node,
-                                         expression_node_t **result,
-                                         latex_log_info_t   *log_info);
+expression_error_t expression_invalidate     (expression_t            *expression,
+                                             expression_node_t       *node);
 
 #endif
@@ -0,0 +1,608 @@
+#ifndef EXPRESSION_STATIC_H
+#define EXPRESSION_STATIC_H
+
+//Expressions known when program is built are parsed, simplified and differentiated by compiler:
+//    constexpr auto f  = static_function  <"x^2*sin(x)">;
+//    constexpr auto df = static_derivative<"x^2*sin(x)">;
+//    double value = f(1.5) + df(1.5);
+//Header needs only headers of this project, nothing is linked from it.
+
+#if __cplusplus < 202002L
+#error "expression_static.h needs C++20"
+#endif
+
+#include <stddef.h>
+#include <math.h>
+
+#include "expression_types.h"
+#include "operation_rules.h"
+
+/*=========================================================================================================*/
+
+static const size_t MaxStaticNodes         = 2048;
+static const size_t MaxStaticFunctionName  = 8;
+
+struct static_node_t {
+    node_type_t          type;
+    double               number;
+    operation_t          operation;
+    size_t               variable;
+    int                  left;
+    int                  right;
+};
+
+template <size_t Capacity>
+struct static_tree_t {
+    static_node_t        nodes[Capacity];
+    size_t               size;
+    int                  root;
+    char                 variables[MaxVarsNumber];
+    size_t               variables_number;
+    bool                 is_valid;
+};
+
+struct static_parser_t {
+    const char          *input;
+    size_t               position;
+};
+
+struct static_function_name_t {
+    const char           name[MaxStaticFunctionName];
+    operation_t          operation;
+};
+
+//Same names as in SupportedOperations, which can not be read by compiler because of function pointers
+static constexpr static_function_name_t StaticFunctionNames[] = {
+    {"sin"   , OPERATION_SIN   },
+    {"cos"   , OPERATION_COS   },
+    {"ln"    , OPERATION_LN    },
+    {"log"   , OPERATION_LOG   },
+    {"tg"    , OPERATION_TG    },
+    {"ctg"   , OPERATION_CTG   },
+    {"arcsin", OPERATION_ARCSIN},
+    {"arccos", OPERATION_ARCCOS},
+    {"arctg" , OPERATION_ARCTG },
+    {"arcctg", OPERATION_ARCCTG},
+    {"sh"    , OPERATION_SH    },
+    {"ch"    , OPERATION_CH    },
+    {"th"    , OPERATION_TH    },
+    {"cth"   , OPERATION_CTH   },
+};
+
+template <size_t Size>
+struct static_string_t {
+    char data[Size];
+
+    constexpr static_string_t(const char (&string)[Size]) : data() {
+        for(size_t index = 0; index < Size; index++) {
+            data[index] = string[index];
+        }
+    }
+};
+
+/*=========================================================================================================*/
+/* Tree                                                                                                    */
+/*=========================================================================================================*/
+
+template <typename Tree>
+constexpr int static_add_node(Tree        *tree,
+                              node_type_t  type,
+                              double       number,
+                              operation_t  operation,
+                              size_t       variable,
+                              int          left,
+                              int          right) {
+    if(tree->size == sizeof(tree->nodes) / sizeof(tree->nodes[0])) {
+        tree->is_valid = false;
+        return StaticNoNode;
+    }
+    tree->nodes[tree->size] = {type, number, operation, variable, left, right};
+    return (int)tree->size++;
+}
+
+template <typename Tree>
+constexpr int static_add_number(Tree *tree, double value) {
+    return static_add_node(tree, NODE_TYPE_NUM, value, OPERATION_UNKNOWN, 0, StaticNoNode, StaticNoNode);
+}
+
+template <typename Tree>
+constexpr bool static_is_number(const Tree *tree, int node, double value) {
+    //Same precision as is_equal
+    if(node == StaticNoNode || tree->nodes[node].type != NODE_TYPE_NUM) {
+        return false;
+    }
+    double difference = tree->nodes[node].number - value;
+    return difference < 10e-6 && difference > -10e-6;
+}
+
+template <typename Tree>
+constexpr bool static_depends(const Tree *tree, int node, size_t diff_variable) {
+    if(node == StaticNoNode) {
+        return false;
+    }
+    if(tree->nodes[node].type == NODE_TYPE_VAR) {
+        return tree->nodes[node].variable == diff_variable;
+    }
+    return static_depends(tree, tree->nodes[node].left , diff_variable) ||
+           static_depends(tree, tree->nodes[node].right, diff_variable);
+}
+
+/*=========================================================================================================*/
+/* Evaluation                                                                                              */
+/*=========================================================================================================*/
+
+//Same chain as run_integer_power
+constexpr double static_integer_power(double base, long power) {
+    switch(power) {
+        case -2: {
+            return 1 / (base * base);
+        }
+        case -1: {
+            return 1 / base;
+        }
+        case 2: {
+            return base * base;
+        }
+        case 3: {
+            return base * base * base;
+        }
+        default: {
+            break;
+        }
+    }
+    unsigned long rest   = (unsigned long)(power < 0 ? -power : power);
+    double        result = 1;
+    while(rest != 0) {
+        if(rest & 1) {
+            result *= base;
+        }
+        base *= base;
+        rest >>= 1;
+    }
+    return power < 0 ? 1 / result : result;
+}
+
+constexpr bool static_is_integer_power(double exponent) {
+    return exponent <= (double)MaxIntegerPower && exponent >= -(double)MaxIntegerPower &&
+           !(exponent - (double)(long)exponent < 0) && !(exponent - (double)(long)exponent > 0);
+}
+
+//Same choice as run_power
+inline double static_power(double base, double exponent) {
+    if(!static_is_integer_power(exponent)) {
+        return pow(base, exponent);
+    }
+    return static_integer_power(base, (long)exponent);
+}
+
+//Only operations which compiler can compute in constant expressions are folded
+constexpr bool static_fold_numbers(operation_t operation, double left, double right, double *value) {
+    switch(operation) {
+        case OPERATION_ADD: {
+            *value = left + right;
+            return true;
+        }
+        case OPERATION_SUB: {
+            *value = left - right;
+            return true;
+        }
+        case OPERATION_MUL: {
+            *value = left * right;
+            return true;
+        }
+        case OPERATION_DIV: {
+            if(!(right < 0) && !(right > 0)) {
+                return false;
+            }
+            *value = left / right;
+            return true;
+        }
+        case OPERATION_POW: {
+            if(!static_is_integer_power(right) || (!(left < 0) && !(left > 0) && right < 0)) {
+                return false;
+            }
+            *value = static_integer_power(left, (long)right);
+            return true;
+        }
+        case OPERATION_UNKNOWN:
+        case OPERATION_SIN:
+        case OPERATION_COS:
+        case OPERATION_LN:
+        case OPERATION_LOG:
+        case OPERATION_TG:
+        case OPERATION_CTG:
+        case OPERATION_ARCSIN:
+        case OPERATION_ARCCOS:
+        case OPERATION_ARCTG:
+        case OPERATION_ARCCTG:
+        case OPERATION_SH:
+        case OPERATION_CH:
+        case OPERATION_TH:
+        case OPERATION_CTH: {
+            return false;
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+//Node index is template parameter, so every node becomes its own inlined function and the whole
+//expression is compiled as one formula
+template <const auto &Tree, int Node>
+constexpr double static_evaluate(const double *variables) {
+    constexpr static_node_t node = Tree.nodes[Node];
+    if constexpr (node.type == NODE_TYPE_NUM) {
+        return node.number;
+    }
+    else if constexpr (node.type == NODE_TYPE_VAR) {
+        return variables[node.variable];
+    }
+    else if constexpr (node.operation == OPERATION_POW && Tree.nodes[node.right].type == NODE_TYPE_NUM &&
+                       static_is_integer_power(Tree.nodes[node.right].number)) {
+        return static_integer_power(static_evaluate<Tree, node.left>(variables), (long)Tree.nodes[node.right].number);
+    }
+    else {
+        double right = static_evaluate<Tree, node.right>(variables);
+        double left  = 0;
+        if constexpr (node.left != StaticNoNode) {
+            left = static_evaluate<Tree, node.left>(variables);
+        }
+        if constexpr (node.operation == OPERATION_ADD   ) { return left + right;               }
+        if constexpr (node.operation == OPERATION_SUB   ) { return left - right;               }
+        if constexpr (node.operation == OPERATION_MUL   ) { return left * right;               }
+        if constexpr (node.operation == OPERATION_DIV   ) { return left / right;               }
+        if constexpr (node.operation == OPERATION_POW   ) { return static_power(left, right);  }
+        if constexpr (node.operation == OPERATION_LOG   ) { return log(right) / log(left);     }
+        if constexpr (node.operation == OPERATION_SIN   ) { return sin(right);                 }
+        if constexpr (node.operation == OPERATION_COS   ) { return cos(right);                 }
+        if constexpr (node.operation == OPERATION_LN    ) { return log(right);                 }
+        if constexpr (node.operation == OPERATION_TG    ) { return tan(right);                 }
+        if constexpr (node.operation == OPERATION_CTG   ) { return 1 / tan(right);             }
+        if constexpr (node.operation == OPERATION_ARCSIN) { return asin(right);                }
+        if constexpr (node.operation == OPERATION_ARCCOS) { return acos(right);                }
+        if constexpr (node.operation == OPERATION_ARCTG ) { return atan(right);                }
+        if constexpr (node.operation == OPERATION_ARCCTG) { return M_PI * 0.5 - atan(right);   }
+        if constexpr (node.operation == OPERATION_SH    ) { return sinh(right);                }
+        if constexpr (node.operation == OPERATION_CH    ) { return cosh(right);                }
+        if constexpr (node.operation == OPERATION_TH    ) { return tanh(right);                }
+        if constexpr (node.operation == OPERATION_CTH   ) { return 1 / tanh(right);            }
+        return NAN;
+    }
+}
+
+/*=========================================================================================================*/
+/* Simplification and differentiation                                                                      */
+/*=========================================================================================================*/
+
+template <operation_t Operation, typename Tree>
+constexpr int static_build_operation(Tree *tree, int left, int right) {
+    bool is_binary = Operation == OPERATION_ADD || Operation == OPERATION_SUB || Operation == OPERATION_MUL ||
+                     Operation == OPERATION_DIV || Operation == OPERATION_POW || Operation == OPERATION_LOG;
+    if(right == StaticNoNode || (left == StaticNoNode && is_binary)) {
+        return StaticNoNode;
+    }
+
+    double       value = 0;
+    build_fold_t fold  = BUILD_FOLD_NONE;
+    if(tree->nodes[right].type == NODE_TYPE_NUM && (left == StaticNoNode || tree->nodes[left].type == NODE_TYPE_NUM) &&
+       static_fold_numbers(Operation, left == StaticNoNode ? 0 : tree->nodes[left].number, tree->nodes[right].number, &value)) {
+        fold = BUILD_FOLD_CONST;
+    }
+    if(fold == BUILD_FOLD_NONE) {
+        fold = neutral_rules<Operation>::type::match_static(tree, left, right, &value);
+    }
+    switch(fold) {
+        case BUILD_FOLD_NONE: {
+            return static_add_node(tree, NODE_TYPE_OP, 0, Operation, 0, left, right);
+        }
+        case BUILD_FOLD_CONST: {
+            return static_add_number(tree, value);
+        }
+        case BUILD_FOLD_LEFT: {
+            return left;
+        }
+        case BUILD_FOLD_RIGHT: {
+            return right;
+        }
+        default: {
+            return StaticNoNode;
+        }
+    }
+}
+
+#define STATIC_CASE(_operation, ...) case _operation: {return __VA_ARGS__;}
+
+template <typename Tree>
+constexpr int static_build_any_operation(Tree *tree, operation_t operation, int left, int right) {
+    switch(operation) {
+        STATIC_CASE(OPERATION_ADD   , static_build_operation<OPERATION_ADD   >(tree, left, right))
+        STATIC_CASE(OPERATION_SUB   , static_build_operation<OPERATION_SUB   >(tree, left, right))
+        STATIC_CASE(OPERATION_DIV   , static_build_operation<OPERATION_DIV   >(tree, left, right))
+        STATIC_CASE(OPERATION_MUL   , static_build_operation<OPERATION_MUL   >(tree, left, right))
+        STATIC_CASE(OPERATION_SIN   , static_build_operation<OPERATION_SIN   >(tree, left, right))
+        STATIC_CASE(OPERATION_COS   , static_build_operation<OPERATION_COS   >(tree, left, right))
+        STATIC_CASE(OPERATION_POW   , static_build_operation<OPERATION_POW   >(tree, left, right))
+        STATIC_CASE(OPERATION_LN    , static_build_operation<OPERATION_LN    >(tree, left, right))
+        STATIC_CASE(OPERATION_LOG   , static_build_operation<OPERATION_LOG   >(tree, left, right))
+        STATIC_CASE(OPERATION_TG    , static_build_operation<OPERATION_TG    >(tree, left, right))
+        STATIC_CASE(OPERATION_CTG   , static_build_operation<OPERATION_CTG   >(tree, left, right))
+        STATIC_CASE(OPERATION_ARCSIN, static_build_operation<OPERATION_ARCSIN>(tree, left, right))
+        STATIC_CASE(OPERATION_ARCCOS, static_build_operation<OPERATION_ARCCOS>(tree, left, right))
+        STATIC_CASE(OPERATION_ARCTG , static_build_operation<OPERATION_ARCTG >(tree, left, right))
+        STATIC_CASE(OPERATION_ARCCTG, static_build_operation<OPERATION_ARCCTG>(tree, left, right))
+        STATIC_CASE(OPERATION_SH    , static_build_operation<OPERATION_SH    >(tree, left, right))
+        STATIC_CASE(OPERATION_CH    , static_build_operation<OPERATION_CH    >(tree, left, right))
+        STATIC_CASE(OPERATION_TH    , static_build_operation<OPERATION_TH    >(tree, left, right))
+        STATIC_CASE(OPERATION_CTH   , static_build_operation<OPERATION_CTH   >(tree, left, right))
+        case OPERATION_UNKNOWN: {
+            return StaticNoNode;
+        }
+        default: {
+            return StaticNoNode;
+        }
+    }
+}
+
+template <typename Tree>
+constexpr int static_differentiate_node(Tree *tree, int node, size_t diff_variable) {
+    if(node == StaticNoNode) {
+        return StaticNoNode;
+    }
+    if(tree->nodes[node].type == NODE_TYPE_NUM) {
+        return static_add_number(tree, 0);
+    }
+    if(tree->nodes[node].type == NODE_TYPE_VAR) {
+        return static_add_number(tree, tree->nodes[node].variable == diff_variable ? 1 : 0);
+    }
+    rule_static_context_t<Tree> context = {tree, node, diff_variable};
+    switch(tree->nodes[node].operation) {
+        STATIC_CASE(OPERATION_ADD   , diff_rule<OPERATION_ADD   >::build_static(&context))
+        STATIC_CASE(OPERATION_SUB   , diff_rule<OPERATION_SUB   >::build_static(&context))
+        STATIC_CASE(OPERATION_DIV   , diff_rule<OPERATION_DIV   >::build_static(&context))
+        STATIC_CASE(OPERATION_MUL   , diff_rule<OPERATION_MUL   >::build_static(&context))
+        STATIC_CASE(OPERATION_SIN   , diff_rule<OPERATION_SIN   >::build_static(&context))
+        STATIC_CASE(OPERATION_COS   , diff_rule<OPERATION_COS   >::build_static(&context))
+        STATIC_CASE(OPERATION_POW   , diff_rule<OPERATION_POW   >::build_static(&context))
+        STATIC_CASE(OPERATION_LN    , diff_rule<OPERATION_LN    >::build_static(&context))
+        STATIC_CASE(OPERATION_LOG   , diff_rule<OPERATION_LOG   >::build_static(&context))
+        STATIC_CASE(OPERATION_TG    , diff_rule<OPERATION_TG    >::build_static(&context))
+        STATIC_CASE(OPERATION_CTG   , diff_rule<OPERATION_CTG   >::build_static(&context))
+        STATIC_CASE(OPERATION_ARCSIN, diff_rule<OPERATION_ARCSIN>::build_static(&context))
+        STATIC_CASE(OPERATION_ARCCOS, diff_rule<OPERATION_ARCCOS>::build_static(&context))
+        STATIC_CASE(OPERATION_ARCTG , diff_rule<OPERATION_ARCTG >::build_static(&context))
+        STATIC_CASE(OPERATION_ARCCTG, diff_rule<OPERATION_ARCCTG>::build_static(&context))
+        STATIC_CASE(OPERATION_SH    , diff_rule<OPERATION_SH    >::build_static(&context))
+        STATIC_CASE(OPERATION_CH    , diff_rule<OPERATION_CH    >::build_static(&context))
+        STATIC_CASE(OPERATION_TH    , diff_rule<OPERATION_TH    >::build_static(&context))
+        STATIC_CASE(OPERATION_CTH   , diff_rule<OPERATION_CTH   >::build_static(&context))
+        case OPERATION_UNKNOWN: {
+            return StaticNoNode;
+        }
+        default: {
+            return StaticNoNode;
+        }
+    }
+}
+
+#undef STATIC_CASE
+
+//Bottom-up pass with constant folding and neutral elements, as the builders do during differentiation
+template <typename Tree>
+constexpr int static_simplify_node(Tree *tree, int node) {
+    if(node == StaticNoNode || tree->nodes[node].type != NODE_TYPE_OP) {
+        return node;
+    }
+    int left  = static_simplify_node(tree, tree->nodes[node].left );
+    int right = static_simplify_node(tree, tree->nodes[node].right);
+    return static_build_any_operation(tree, tree->nodes[node].operation, left, right);
+}
+
+/*=========================================================================================================*/
+/* Parser, same grammar as string_parser.cpp                                                               */
+/*=========================================================================================================*/
+
+constexpr bool static_is_digit(char symbol) {
+    return symbol >= '0' && symbol <= '9';
+}
+
+constexpr bool static_is_alpha(char symbol) {
+    return (symbol >= 'a' && symbol <= 'z') || (symbol >= 'A' && symbol <= 'Z');
+}
+
+template <typename Tree>
+constexpr int static_get_expr(Tree *tree, static_parser_t *parser);
+
+template <typename Tree>
+constexpr int static_get_variable(Tree *tree, char name) {
+    size_t index = 0;
+    while(index < tree->variables_number && tree->variables[index] != name) {
+        index++;
+    }
+    if(index == MaxVarsNumber) {
+        tree->is_valid = false;
+        return StaticNoNode;
+    }
+    if(index == tree->variables_number) {
+        tree->variables[tree->variables_number++] = name;
+    }
+    return static_add_node(tree, NODE_TYPE_VAR, 0, OPERATION_UNKNOWN, index, StaticNoNode, StaticNoNode);
+}
+
+template <typename Tree>
+constexpr int static_get_num(Tree *tree, static_parser_t *parser) {
+    double multiplier = 1;
+    double result     = 0;
+    double power      = 0.1;
+    if(parser->input[parser->position] == '-') {
+        multiplier = -1;
+        parser->position++;
+    }
+    while(static_is_digit(parser->input[parser->position])) {
+        result = 10 * result + (parser->input[parser->position] - '0');
+        parser->position++;
+    }
+    if(parser->input[parser->position] != '.') {
+        return static_add_number(tree, result);
+    }
+    parser->position++;
+    while(static_is_digit(parser->input[parser->position])) {
+        result += power * (parser->input[parser->position] - '0');
+        parser->position++;
+        power *= 0.1;
+    }
+    return static_add_number(tree, result * multiplier);
+}
+
+template <typename Tree>
+constexpr int static_get_func(Tree *tree, static_parser_t *parser) {
+    size_t start = parser->position;
+    while(static_is_alpha(parser->input[parser->position])) {
+        parser->position++;
+    }
+    operation_t operation = OPERATION_UNKNOWN;
+    for(const static_function_name_t &function : StaticFunctionNames) {
+        size_t index = 0;
+        while(start + index < parser->position && function.name[index] == parser->input[start + index]) {
+            index++;
+        }
+        if(start + index == parser->position && function.name[index] == '\0') {
+            operation = function.operation;
+        }
+    }
+    if(operation == OPERATION_UNKNOWN || parser->input[parser->position] != '(') {
+        tree->is_valid = false;
+        return StaticNoNode;
+    }
+    parser->position++;
+    int argument = static_get_expr(tree, parser);
+    if(parser->input[parser->position] != ')') {
+        tree->is_valid = false;
+        return StaticNoNode;
+    }
+    parser->position++;
+    return static_add_node(tree, NODE_TYPE_OP, 0, operation, 0, StaticNoNode, argument);
+}
+
+template <typename Tree>
+constexpr int static_getP(Tree *tree, static_parser_t *parser) {
+    const char *symbols = parser->input + parser->position;
+    if(symbols[0] == '(') {
+        parser->position++;
+        int result = static_get_expr(tree, parser);
+        if(parser->input[parser->position] != ')') {
+            tree->is_valid = false;
+            return StaticNoNode;
+        }
+        parser->position++;
+        return result;
+    }
+    if(static_is_digit(symbols[0]) || (symbols[0] == '-' && static_is_digit(symbols[1]))) {
+        return static_get_num(tree, parser);
+    }
+    if(static_is_alpha(symbols[0]) && !static_is_alpha(symbols[1])) {
+        parser->position++;
+        return static_get_variable(tree, symbols[0]);
+    }
+    if(symbols[0] == '-' && static_is_alpha(symbols[1]) && !static_is_alpha(symbols[2])) {
+        parser->position += 2;
+        int minus_one = static_add_number(tree, -1);
+        return static_add_node(tree, NODE_TYPE_OP, 0, OPERATION_MUL, 0, minus_one, static_get_variable(tree, symbols[1]));
+    }
+    if(static_is_alpha(symbols[0]) && static_is_alpha(symbols[1])) {
+        return static_get_func(tree, parser);
+    }
+    tree->is_valid = false;
+    return StaticNoNode;
+}
+
+template <typename Tree>
+constexpr int static_get_pow(Tree *tree, static_parser_t *parser) {
+    int result = static_getP(tree, parser);
+    while(parser->input[parser->position] == '^') {
+        parser->position++;
+        int right = static_getP(tree, parser);
+        result = static_add_node(tree, NODE_TYPE_OP, 0, OPERATION_POW, 0, result, right);
+    }
+    return result;
+}
+
+template <typename Tree>
+constexpr int static_get_mul(Tree *tree, static_parser_t *parser) {
+    int result = static_get_pow(tree, parser);
+    while(parser->input[parser->position] == '*' || parser->input[parser->position] == '/') {
+        operation_t operation = parser->input[parser->position] == '*' ? OPERATION_MUL : OPERATION_DIV;
+        parser->position++;
+        int right = static_get_pow(tree, parser);
+        result = static_add_node(tree, NODE_TYPE_OP, 0, operation, 0, result, right);
+    }
+    return result;
+}
+
+template <typename Tree>
+constexpr int static_get_expr(Tree *tree, static_parser_t *parser) {
+    int result = static_get_mul(tree, parser);
+    while(parser->input[parser->position] == '+' || parser->input[parser->position] == '-') {
+        operation_t operation = parser->input[parser->position] == '+' ? OPERATION_ADD : OPERATION_SUB;
+        parser->position++;
+        int right = static_get_mul(tree, parser);
+        result = static_add_node(tree, NODE_TYPE_OP, 0, operation, 0, result, right);
+    }
+    return result;
+}
+
+/*=========================================================================================================*/
+/* Interface                                                                                               */
+/*=========================================================================================================*/
+
+template <size_t Capacity = MaxStaticNodes>
+constexpr static_tree_t<Capacity> static_read(const char *input) {
+    static_tree_t<Capacity> tree   = {};
+    static_parser_t         parser = {input, 0};
+    tree.is_valid = true;
+    int root = static_get_expr(&tree, &parser);
+    if(input[parser.position] != '\0' || root == StaticNoNode) {
+        tree.is_valid = false;
+        return tree;
+    }
+    tree.root = static_simplify_node(&tree, root);
+    return tree;
+}
+
+//Derivative is kept in the same tree, so unchanged subtrees of function are shared with it.
+//Rules fold constants and neutral elements while building, so result is not simplified again.
+template <size_t Capacity>
+constexpr static_tree_t<Capacity> static_differentiate(static_tree_t<Capacity> tree) {
+    tree.root = static_differentiate_node(&tree, tree.root, 0);
+    if(tree.root == StaticNoNode) {
+        tree.is_valid = false;
+    }
+    return tree;
+}
+
+template <static_string_t Source>
+struct static_expression_t {
+    static constexpr static_tree_t<MaxStaticNodes> function   = static_read(Source.data);
+    static constexpr static_tree_t<MaxStaticNodes> derivative = static_differentiate(function);
+    static_assert(function.is_valid,   "Expression can not be read or is too big");
+    static_assert(derivative.is_valid, "Derivative is too big");
+};
+
+template <const auto &Tree>
+struct static_function_t {
+    template <typename... Arguments>
+    constexpr double operator()(Arguments... arguments) const {
+        static_assert(sizeof...(Arguments) == Tree.variables_number,
+                      "Values are given in order in which variables first appear in expression");
+        const double variables[sizeof...(Arguments) + 1] = {(double)arguments...};
+        return static_evaluate<Tree, Tree.root>(variables);
+    }
+};
+
+template <static_string_t Source>
+inline constexpr static_function_t<static_expression_t<Source>::function> static_function = {};
+
+template <static_string_t Source>
+inline constexpr static_function_t<static_expression_t<Source>::derivative> static_derivative = {};
+
+#endif
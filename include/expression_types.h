@@ -2,6 +2,7 @@
 #define EXPRESSION_TYPES_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 static const size_t MaxVarsNumber = 10;
 static const size_t MaxSubstitutionsNumber = 100;
@@ -37,6 +38,29 @@ enum expression_error_t {
     EXPRESSION_NODES_STORAGE_NULL                = 26,
     EXPRESSION_VARIABLES_LIST_NULL               = 27,
     EXPRESSION_INVALID_DUMP_FILENAME             = 28,
+    EXPRESSION_MEMO_ALLOCATION_ERROR             = 29,
+    EXPRESSION_PARALLEL_ALLOCATION_ERROR         = 30,
+    EXPRESSION_NODE_NOT_FOUND                    = 31,
+    EXPRESSION_NORMALIZE_ALLOCATION_ERROR        = 32,
+    EXPRESSION_CSE_ALLOCATION_ERROR              = 33,
+    EXPRESSION_EGRAPH_ALLOCATION_ERROR           = 34,
+    EXPRESSION_REWRITE_RULE_ERROR                = 35,
+    EXPRESSION_REWRITE_ALLOCATION_ERROR          = 36,
+    EXPRESSION_DEADLINE_EXCEEDED                 = 37,
+    EXPRESSION_NODES_LIMIT_EXCEEDED              = 38,
+    EXPRESSION_CANCELLED                         = 39,
+    EXPRESSION_BYTECODE_ALLOCATION_ERROR         = 40,
+    EXPRESSION_BATCH_ALLOCATION_ERROR            = 41,
+    EXPRESSION_BATCH_INPUT_NULL                  = 42,
+    EXPRESSION_NATIVE_SOURCE_ERROR               = 43,
+    EXPRESSION_NATIVE_COMPILATION_ERROR          = 44,
+    EXPRESSION_NATIVE_LOADING_ERROR              = 45,
+    EXPRESSION_EMIT_ALLOCATION_ERROR             = 46,
+    EXPRESSION_GRID_ALLOCATION_ERROR             = 47,
+    EXPRESSION_GRID_INVALID                      = 48,
+    EXPRESSION_PLOT_ALLOCATION_ERROR             = 49,
+    EXPRESSION_PLOT_INVALID_SETTINGS             = 50,
+    EXPRESSION_INCREMENTAL_ALLOCATION_ERROR      = 51,
 };
 
 #define _RETURN_IF_ERROR(...) {/*function call*/    \
@@ -87,6 +111,24 @@ struct variable_t {
     double               value;
 };
 
+//Value with derivative by one direction, arithmetic on them is forward differentiation
+struct dual_t {
+    double               value;
+    double               derivative;
+};
+
+//Bounds which contain every value of expression for variables inside bounds of variables
+struct interval_t {
+    double               lower;
+    double               upper;
+};
+
+//Variable i is bound to values[i] if bit i of mask is set
+struct bound_variables_t {
+    size_t               mask;
+    double               values[MaxVarsNumber];
+};
+
 struct parser_info_t {
     char *input;
     size_t position;
@@ -112,6 +154,8 @@ struct expression_node_t {
     bool                 is_free;
     char                 substitution_name[MaxSubstitutionNameSize];
     bool                 is_substitution;
+    size_t               hash;
+    bool                 is_simplified;
 };
 
 struct nodes_storage_t {
@@ -124,11 +168,311 @@ struct nodes_storage_t {
     expression_node_t   *free_tail;
 };
 
+struct diff_memo_entry_t {
+    expression_node_t   *source;
+    expression_node_t   *result;
+    size_t               uses;
+};
+
+struct diff_memo_t {
+    diff_memo_entry_t   *entries;
+    size_t               capacity;
+};
+
+struct diff_parallel_root_t {
+    expression_node_t   *source;
+    expression_node_t   *result;
+    bool                 is_used;
+};
+
+struct diff_parallel_t {
+    diff_parallel_root_t *roots;
+    size_t                roots_number;
+    size_t               *batches;
+    size_t                batches_number;
+    size_t                next_batch;
+    size_t               *index;
+    size_t                index_capacity;
+    size_t                grain;
+    size_t                pending_size;
+    size_t                nodes_number;
+};
+
+struct normalize_item_t {
+    expression_node_t   *node;
+    double               value;
+    bool                 is_normalized;
+};
+
+struct normalize_list_t {
+    normalize_item_t    *items;
+    size_t               size;
+    size_t               capacity;
+};
+
+struct cse_temporary_t {
+    expression_node_t   *node;
+    size_t               left;
+    size_t               right;
+    size_t               uses;
+    size_t               tree_size;
+};
+
+struct cse_program_t {
+    cse_temporary_t     *temporaries;
+    size_t               size;
+    size_t              *table;
+    size_t               table_capacity;
+    size_t              *occurrences;
+    size_t               occurrences_number;
+    double              *values;
+    size_t               result;
+};
+
+//Temporaries depending on variable i are dependents[dependents_start[i]] ... dependents[dependents_start[i + 1] - 1]
+struct incremental_evaluator_t {
+    cse_program_t        program;
+    size_t              *masks;
+    size_t              *dependents;
+    size_t               dependents_start[MaxVarsNumber + 1];
+    double               variables[MaxVarsNumber];
+    size_t               changed_mask;
+    size_t               recomputed;
+};
+
+struct egraph_node_t {
+    node_type_t          type;
+    node_value_t         value;
+    size_t               left;
+    size_t               right;
+    size_t               eclass;
+    bool                 is_duplicate;
+};
+
+struct egraph_class_t {
+    size_t               parent;
+    bool                 is_constant;
+    double               constant;
+    double               cost;
+    size_t               best;
+};
+
+typedef double (*egraph_cost_t)(egraph_node_t *node);
+
+struct egraph_limits_t {
+    size_t               max_nodes;
+    size_t               max_iterations;
+    double               max_seconds;
+    size_t               max_matches;
+    size_t               rule_matches;
+    size_t               rule_ban;
+};
+
+struct egraph_rule_t {
+    expression_node_t   *pattern;
+    expression_node_t   *result;
+    variables_list_t     variables;
+    size_t               times_banned;
+    size_t               banned_until;
+};
+
+struct egraph_match_t {
+    size_t               rule;
+    size_t               eclass;
+    size_t               bindings[MaxVarsNumber];
+};
+
+struct egraph_t {
+    egraph_node_t       *nodes;
+    size_t               nodes_size;
+    size_t               nodes_capacity;
+    egraph_class_t      *classes;
+    size_t               classes_size;
+    size_t               classes_capacity;
+    size_t              *table;
+    size_t               table_capacity;
+    size_t              *class_start;
+    size_t              *class_nodes;
+    egraph_match_t      *matches;
+    size_t               matches_size;
+    size_t               matches_capacity;
+    egraph_rule_t       *rules;
+    size_t               rules_number;
+    nodes_storage_t      rules_storage;
+    egraph_limits_t      limits;
+    double               deadline;
+    size_t               steps;
+    size_t               rule_matches_end;
+    size_t               banned_rules;
+    bool                 is_rule_stopped;
+    bool                 is_search_stopped;
+    bool                 is_timeout;
+};
+
+struct rewrite_symbol_t {
+    node_type_t          type;
+    node_value_t         value;
+};
+
+struct rewrite_edge_t {
+    rewrite_symbol_t     symbol;
+    size_t               target;
+    size_t               next;
+};
+
+struct rewrite_state_t {
+    size_t               first_edge;
+    size_t               first_rule;
+};
+
+struct rewrite_rule_t {
+    expression_node_t   *pattern;
+    expression_node_t   *result;
+    size_t               next;
+};
+
+struct rewrite_choice_t {
+    size_t               rule;
+    double               flops;
+};
+
+struct rewriter_t {
+    rewrite_state_t     *states;
+    size_t               states_size;
+    size_t               states_capacity;
+    rewrite_edge_t      *edges;
+    size_t               edges_size;
+    size_t               edges_capacity;
+    rewrite_rule_t      *rules;
+    size_t               rules_size;
+    size_t               rules_capacity;
+    nodes_storage_t      patterns_storage;
+    variables_list_t     variables;
+};
+
+//Codes of operations are the same as in operation_t, the rest are specialized forms of them
+enum bytecode_opcode_t {
+    BYTECODE_RETURN      = OPERATION_UNKNOWN,
+    BYTECODE_ADD         = OPERATION_ADD,
+    BYTECODE_SUB         = OPERATION_SUB,
+    BYTECODE_DIV         = OPERATION_DIV,
+    BYTECODE_MUL         = OPERATION_MUL,
+    BYTECODE_SIN         = OPERATION_SIN,
+    BYTECODE_COS         = OPERATION_COS,
+    BYTECODE_POW         = OPERATION_POW,
+    BYTECODE_LN          = OPERATION_LN,
+    BYTECODE_LOG         = OPERATION_LOG,
+    BYTECODE_TG          = OPERATION_TG,
+    BYTECODE_CTG         = OPERATION_CTG,
+    BYTECODE_ARCSIN      = OPERATION_ARCSIN,
+    BYTECODE_ARCCOS      = OPERATION_ARCCOS,
+    BYTECODE_ARCTG       = OPERATION_ARCTG,
+    BYTECODE_ARCCTG      = OPERATION_ARCCTG,
+    BYTECODE_SH          = OPERATION_SH,
+    BYTECODE_CH          = OPERATION_CH,
+    BYTECODE_TH          = OPERATION_TH,
+    BYTECODE_CTH         = OPERATION_CTH,
+    BYTECODE_SQUARE      = 20,
+    BYTECODE_CUBE        = 21,
+    BYTECODE_RECIPROCAL  = 22,
+    BYTECODE_POWER_INT   = 23,
+};
+
+struct bytecode_instruction_t {
+    uint32_t             opcode;
+    uint32_t             left;
+    uint32_t             right;
+};
+
+struct bytecode_t {
+    bytecode_instruction_t *code;
+    size_t                  code_size;
+    double                 *registers;
+    size_t                  registers_size;
+    size_t                  temporaries_start;
+    size_t                  variables_mask;
+    size_t                  result;
+};
+
+typedef double (*native_function_t)       (const double        *variables);
+typedef void   (*native_batch_function_t) (const double *const *inputs,
+                                           size_t               points_number,
+                                           double              *outputs);
+
+struct native_code_t {
+    void                    *library;
+    native_function_t        function;
+    native_batch_function_t  batch_function;
+    size_t                   variables_mask;
+    size_t                   key;
+    bool                     is_cached;
+};
+
+enum grid_format_t {
+    GRID_FORMAT_CSV   ,
+    GRID_FORMAT_BINARY,
+};
+
+//Axis is regular from start to end, or consists of given points if they are not NULL
+struct grid_axis_t {
+    double               start;
+    double               end;
+    size_t               points_number;
+    const double        *points;
+};
+
+struct grid_t {
+    grid_axis_t          axes[MaxVarsNumber];
+    size_t               axes_number;
+};
+
+struct plot_settings_t {
+    double               start;
+    double               end;
+    size_t               initial_intervals;
+    double               tolerance;
+    size_t               max_depth;
+    size_t               max_points;
+};
+
+//Polyline is interrupted before the point if is_break is set
+struct plot_point_t {
+    double               x;
+    double               value;
+    bool                 is_break;
+};
+
+struct plot_t {
+    plot_point_t        *points;
+    size_t               size;
+    size_t               capacity;
+    size_t               evaluations;
+    bool                 is_broken;
+};
+
+struct expression_cost_t {
+    size_t               nodes;
+    double               flops;
+    double               latency;
+};
+
+struct expression_budget_t {
+    double               deadline;
+    size_t               max_nodes;
+    bool                 is_cancelled;
+    size_t               checks_number;
+    expression_error_t   status;
+};
+
 struct expression_t {
     expression_node_t   *root;
     variables_list_t    *variables_list;
     nodes_storage_t      nodes_storage;
     expression_dump_t    dump_info;
+    diff_memo_t         *diff_memo;
+    diff_parallel_t     *diff_parallel;
+    rewriter_t          *rewriter;
+    expression_budget_t *budget;
 };
 
 struct latex_log_info_t {
@@ -146,17 +490,11 @@ struct operation_prototype_t {
     const char          *name;
     operation_t          code;
     const char          *latex_function;
-    expression_error_t (*neutrals_simplifier)(expression_t *,
-                                              expression_node_t *,
-                                              expression_node_t **,
-                                              latex_log_info_t *);
-    expression_error_t (*latex_logger)       (latex_log_info_t *,
-                                              expression_node_t *);
-    expression_node_t *(*diff_func)          (expression_t *,
-                                              expression_node_t *,
-                                              latex_log_info_t *,
-                                              size_t);
+    expression_error_t (*latex_logger)(latex_log_info_t *,
+                                       expression_node_t *);
     size_t               priority;
+    double               flops;
+    double               latency;
 };
 
 #endif
@@ -3,6 +3,8 @@
 
 #include "expression_types.h"
 
+static const long MaxIntegerPower = 64;
+
 expression_error_t nodes_storage_remove      (nodes_storage_t    *storage,
                                               expression_node_t  *node);
 
@@ -13,6 +15,9 @@ expression_error_t nodes_storage_new_node    (nodes_storage_t    *storage,
 
 expression_error_t nodes_storage_dtor        (nodes_storage_t    *storage);
 
+expression_error_t nodes_storage_merge       (nodes_storage_t    *storage,
+                                              nodes_storage_t    *other);
+
 expression_error_t expression_delete_subtree (expression_t       *expression,
                                               expression_node_t  *node);
 
@@ -35,6 +40,12 @@ double             run_operation             (double              left,
                                               double              right,
                                               operation_t         operation);
 
+double             run_power                 (double              base,
+                                              double              exponent);
+
+double             run_integer_power         (double              base,
+                                              long                power);
+
 bool               is_leaf                   (expression_node_t  *node);
 
 bool               is_node_equal             (expression_node_t  *node,
@@ -48,4 +59,11 @@ size_t             find_tree_size            (expression_node_t  *node);
 size_t             count_variables           (expression_node_t *node,
                                               size_t             diff_variable);
 
+size_t             node_hash_update          (expression_node_t *node);
+
+size_t             subtree_hash_update       (expression_node_t *node);
+
+bool               is_subtree_equal          (expression_node_t *first,
+                                              expression_node_t *second);
+
 #endif
@@ -0,0 +1,150 @@
+#ifndef OPERATION_RULES_H
+#define OPERATION_RULES_H
+
+#include "rules_dsl.h"
+
+/*=========================================================================================================*/
+/* Neutral elements of operations                                                                          */
+/*=========================================================================================================*/
+
+template <> struct neutral_rules<OPERATION_ADD> {
+    using type = neutral_rules_list<neutral_rule<RULE_SIDE_RIGHT, 0, BUILD_FOLD_LEFT    >,
+                                    neutral_rule<RULE_SIDE_LEFT , 0, BUILD_FOLD_RIGHT   >>;
+};
+
+template <> struct neutral_rules<OPERATION_SUB> {
+    using type = neutral_rules_list<neutral_rule<RULE_SIDE_RIGHT, 0, BUILD_FOLD_LEFT    >>;
+};
+
+template <> struct neutral_rules<OPERATION_MUL> {
+    using type = neutral_rules_list<neutral_rule<RULE_SIDE_LEFT , 0, BUILD_FOLD_CONST, 0>,
+                                    neutral_rule<RULE_SIDE_RIGHT, 0, BUILD_FOLD_CONST, 0>,
+                                    neutral_rule<RULE_SIDE_RIGHT, 1, BUILD_FOLD_LEFT    >,
+                                    neutral_rule<RULE_SIDE_LEFT , 1, BUILD_FOLD_RIGHT   >>;
+};
+
+template <> struct neutral_rules<OPERATION_DIV> {
+    using type = neutral_rules_list<neutral_rule<RULE_SIDE_RIGHT, 1, BUILD_FOLD_LEFT    >,
+                                    neutral_rule<RULE_SIDE_LEFT , 0, BUILD_FOLD_CONST, 0>>;
+};
+
+template <> struct neutral_rules<OPERATION_POW> {
+    using type = neutral_rules_list<neutral_rule<RULE_SIDE_LEFT , 0, BUILD_FOLD_CONST, 0>,
+                                    neutral_rule<RULE_SIDE_LEFT , 1, BUILD_FOLD_CONST, 1>,
+                                    neutral_rule<RULE_SIDE_RIGHT, 1, BUILD_FOLD_LEFT    >,
+                                    neutral_rule<RULE_SIDE_RIGHT, 0, BUILD_FOLD_CONST, 1>>;
+};
+
+template <> struct neutral_rules<OPERATION_LN > {
+    using type = neutral_rules_list<neutral_rule<RULE_SIDE_RIGHT, 1, BUILD_FOLD_CONST, 0>>;
+};
+
+template <> struct neutral_rules<OPERATION_LOG> {
+    using type = neutral_rules_list<neutral_rule<RULE_SIDE_RIGHT, 1, BUILD_FOLD_CONST, 0>>;
+};
+
+/*=========================================================================================================*/
+/* Derivatives of operations                                                                               */
+/*=========================================================================================================*/
+
+using _DL = rule_diff_left;
+using _DR = rule_diff_right;
+using _CL = rule_copy_left;
+using _CR = rule_copy_right;
+
+template <> struct diff_rule<OPERATION_ADD   > : rule_add<_DL, _DR> {};
+
+template <> struct diff_rule<OPERATION_SUB   > : rule_sub<_DL, _DR> {};
+
+template <> struct diff_rule<OPERATION_MUL   > : rule_add<rule_mul<_DL, _CR>, rule_mul<_CL, _DR>> {};
+
+template <> struct diff_rule<OPERATION_DIV   > : rule_div<rule_sub<rule_mul<_DL, _CR>, rule_mul<_CL, _DR>>, rule_pow<_CR, rule_const<2>>> {};
+
+template <> struct diff_rule<OPERATION_SIN   > : rule_mul<rule_cos<_CR>, _DR> {};
+
+template <> struct diff_rule<OPERATION_COS   > : rule_mul<rule_const<-1>, rule_mul<rule_sin<_CR>, _DR>> {};
+
+template <> struct diff_rule<OPERATION_POW   > : rule_if<rule_depends_left,
+                                                         rule_if<rule_depends_right,
+                                                                 rule_mul<rule_add<rule_mul<_DR, rule_ln<_CL>>,
+                                                                                   rule_mul<_CR, rule_div<_DL, _CL>>>,
+                                                                          rule_pow<_CL, _CR>>,
+                                                                 rule_mul<_DL, rule_mul<_CR, rule_pow<_CL, rule_sub<_CR, rule_const<1>>>>>>,
+                                                         rule_if<rule_depends_right,
+                                                                 rule_mul<rule_mul<rule_ln<_CL>, rule_pow<_CL, _CR>>, _DR>,
+                                                                 rule_const<0>>> {};
+
+template <> struct diff_rule<OPERATION_LN    > : rule_div<_DR, _CR> {};
+
+template <> struct diff_rule<OPERATION_LOG   > : rule_if<rule_depends_left,
+                                                         rule_if<rule_depends_right,
+                                                                 rule_div<rule_sub<rule_mul<rule_div<_DR, _CR>, rule_ln<_CL>>,
+                                                                                   rule_mul<rule_div<_DL, _CL>, rule_ln<_CR>>>,
+                                                                          rule_pow<rule_ln<_CL>, rule_const<2>>>,
+                                                                 rule_mul<rule_const<-1>,
+                                                                          rule_div<rule_mul<_DL, rule_ln<_CR>>,
+                                                                                   rule_mul<_CL, rule_pow<rule_ln<_CL>, rule_const<2>>>>>>,
+                                                         rule_if<rule_depends_right,
+                                                                 rule_div<_DR, rule_mul<_CR, rule_ln<_CL>>>,
+                                                                 rule_const<0>>> {};
+
+template <> struct diff_rule<OPERATION_TG    > : rule_div<_DR, rule_pow<rule_cos<_CR>, rule_const<2>>> {};
+
+template <> struct diff_rule<OPERATION_CTG   > : rule_mul<rule_const<-1>, rule_div<_DR, rule_pow<rule_sin<_CR>, rule_const<2>>>> {};
+
+template <> struct diff_rule<OPERATION_ARCSIN> : rule_div<_DR, rule_pow<rule_sub<rule_const<1>, rule_pow<_CR, rule_const<2>>>, rule_const<1, 2>>> {};
+
+template <> struct diff_rule<OPERATION_ARCCOS> : rule_div<rule_mul<rule_const<-1>, _DR>, rule_pow<rule_sub<rule_const<1>, rule_pow<_CR, rule_const<2>>>, rule_const<1, 2>>> {};
+
+template <> struct diff_rule<OPERATION_ARCTG > : rule_div<_DR, rule_add<rule_const<1>, rule_pow<_CR, rule_const<2>>>> {};
+
+template <> struct diff_rule<OPERATION_ARCCTG> : rule_div<rule_mul<rule_const<-1>, _DR>, rule_add<rule_const<1>, rule_pow<_CR, rule_const<2>>>> {};
+
+template <> struct diff_rule<OPERATION_SH    > : rule_mul<rule_ch<_CR>, _DR> {};
+
+template <> struct diff_rule<OPERATION_CH    > : rule_mul<rule_sh<_CR>, _DR> {};
+
+template <> struct diff_rule<OPERATION_TH    > : rule_div<_DR, rule_pow<rule_ch<_CR>, rule_const<2>>> {};
+
+template <> struct diff_rule<OPERATION_CTH   > : rule_div<rule_mul<rule_const<-1>, _DR>, rule_pow<rule_sh<_CR>, rule_const<2>>> {};
+
+/*=========================================================================================================*/
+
+#define NEUTRAL_CASE(_operation) case _operation: {return neutral_rules<_operation>::type::match(left, right, output);}
+
+inline build_fold_t neutral_fold(operation_t        operation,
+                                 expression_node_t *left,
+                                 expression_node_t *right,
+                                 double            *output) {
+    switch(operation) {
+        NEUTRAL_CASE(OPERATION_ADD   )
+        NEUTRAL_CASE(OPERATION_SUB   )
+        NEUTRAL_CASE(OPERATION_DIV   )
+        NEUTRAL_CASE(OPERATION_MUL   )
+        NEUTRAL_CASE(OPERATION_SIN   )
+        NEUTRAL_CASE(OPERATION_COS   )
+        NEUTRAL_CASE(OPERATION_POW   )
+        NEUTRAL_CASE(OPERATION_LN    )
+        NEUTRAL_CASE(OPERATION_LOG   )
+        NEUTRAL_CASE(OPERATION_TG    )
+        NEUTRAL_CASE(OPERATION_CTG   )
+        NEUTRAL_CASE(OPERATION_ARCSIN)
+        NEUTRAL_CASE(OPERATION_ARCCOS)
+        NEUTRAL_CASE(OPERATION_ARCTG )
+        NEUTRAL_CASE(OPERATION_ARCCTG)
+        NEUTRAL_CASE(OPERATION_SH    )
+        NEUTRAL_CASE(OPERATION_CH    )
+        NEUTRAL_CASE(OPERATION_TH    )
+        NEUTRAL_CASE(OPERATION_CTH   )
+        case OPERATION_UNKNOWN: {
+            return BUILD_FOLD_NONE;
+        }
+        default: {
+            return BUILD_FOLD_NONE;
+        }
+    }
+}
+
+#undef NEUTRAL_CASE
+
+#endif
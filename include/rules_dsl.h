@@ -0,0 +1,396 @@
+#ifndef RULES_DSL_H
+#define RULES_DSL_H
+
+#include <math.h>
+
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "expression_builders.h"
+#include "diff_rules.h"
+
+/*=========================================================================================================*/
+/* Compile time trees (expression_static.h) are built by the same rules. Nodes of such tree are indices,   */
+/* functions working with them are defined with the tree.                                                  */
+/*=========================================================================================================*/
+
+static const int StaticNoNode = -1;
+
+template <typename Tree>
+struct rule_static_context_t {
+    Tree                *tree;
+    int                  node;
+    size_t               diff_variable;
+};
+
+template <typename Tree>
+constexpr int  static_add_number        (Tree *tree, double value);
+
+template <typename Tree>
+constexpr bool static_is_number         (const Tree *tree, int node, double value);
+
+template <typename Tree>
+constexpr bool static_depends           (const Tree *tree, int node, size_t diff_variable);
+
+template <typename Tree>
+constexpr int  static_differentiate_node(Tree *tree, int node, size_t diff_variable);
+
+template <operation_t Operation, typename Tree>
+constexpr int  static_build_operation   (Tree *tree, int left, int right);
+
+/*=========================================================================================================*/
+/* Neutral rules. Rule says that if operand on the given side is equal to Value, operation is folded.     */
+/*=========================================================================================================*/
+
+enum rule_side_t {
+    RULE_SIDE_LEFT ,
+    RULE_SIDE_RIGHT,
+};
+
+struct neutral_static_t {
+    build_fold_t fold;
+    int          result;
+};
+
+template <rule_side_t Side, int Value, build_fold_t Fold, int Result = 0>
+struct neutral_rule {
+    static constexpr rule_side_t  side   = Side;
+    static constexpr int          value  = Value;
+    static constexpr build_fold_t fold   = Fold;
+    static constexpr int          result = Result;
+
+    static inline build_fold_t match(expression_node_t *left, expression_node_t *right, double *output) {
+        expression_node_t *operand = Side == RULE_SIDE_LEFT ? left : right;
+        if(operand == NULL || !is_node_equal(operand, Value)) {
+            return BUILD_FOLD_NONE;
+        }
+        *output = Result;
+        return Fold;
+    }
+
+    template <typename Tree>
+    static constexpr build_fold_t match_static(const Tree *tree, int left, int right, double *output) {
+        int operand = Side == RULE_SIDE_LEFT ? left : right;
+        if(operand == StaticNoNode || !static_is_number(tree, operand, Value)) {
+            return BUILD_FOLD_NONE;
+        }
+        *output = Result;
+        return Fold;
+    }
+};
+
+template <typename... Rules>
+struct neutral_rules_list {
+    //Rules are checked in order of declaration, first matched rule wins
+    static inline build_fold_t match(expression_node_t *left, expression_node_t *right, double *output) {
+        //Operations without neutral elements have empty list of rules
+        (void)left;
+        (void)right;
+        (void)output;
+        build_fold_t fold = BUILD_FOLD_NONE;
+        (void)((fold = Rules::match(left, right, output), fold != BUILD_FOLD_NONE) || ...);
+        return fold;
+    }
+
+    template <typename Tree>
+    static constexpr build_fold_t match_static(const Tree *tree, int left, int right, double *output) {
+        (void)tree;
+        (void)left;
+        (void)right;
+        (void)output;
+        build_fold_t fold = BUILD_FOLD_NONE;
+        (void)((fold = Rules::match_static(tree, left, right, output), fold != BUILD_FOLD_NONE) || ...);
+        return fold;
+    }
+
+    //Same lookup for operand which is known at compile time to be constant Numerator / Denominator
+    template <rule_side_t Side, int Numerator, int Denominator>
+    static constexpr neutral_static_t find() {
+        neutral_static_t found = {BUILD_FOLD_NONE, 0};
+        (void)((Rules::side == Side && Numerator == Rules::value * Denominator ?
+                    (found = {Rules::fold, Rules::result}, true) : false) || ...);
+        return found;
+    }
+};
+
+template <operation_t Operation>
+struct neutral_rules {
+    using type = neutral_rules_list<>;
+};
+
+/*=========================================================================================================*/
+/* Derivative rules. Every term of rule is a type with static build function, which is inlined into the   */
+/* rule of operation, so building derivative does not go through function pointers.                       */
+/*=========================================================================================================*/
+
+struct rule_context_t {
+    expression_t      *derivative;
+    expression_node_t *node;
+    latex_log_info_t  *log_info;
+    size_t             diff_variable;
+};
+
+template <int Numerator, int Denominator = 1>
+struct rule_const {
+    static constexpr bool   is_const    = true;
+    static constexpr bool   may_vanish  = Numerator == 0;
+    static constexpr int    numerator   = Numerator;
+    static constexpr int    denominator = Denominator;
+    static constexpr double value       = (double)Numerator / (double)Denominator;
+
+    static inline expression_node_t *build(rule_context_t *context) {
+        return new_node(context->derivative, NODE_TYPE_NUM, {.numeric_value = value}, NULL, NULL);
+    }
+
+    template <typename Tree>
+    static constexpr int build_static(rule_static_context_t<Tree> *context) {
+        return static_add_number(context->tree, value);
+    }
+};
+
+struct rule_none {
+    static constexpr bool is_const   = false;
+    static constexpr bool may_vanish = false;
+
+    static inline expression_node_t *build(rule_context_t */*context*/) {
+        return NULL;
+    }
+
+    template <typename Tree>
+    static constexpr int build_static(rule_static_context_t<Tree> */*context*/) {
+        return StaticNoNode;
+    }
+};
+
+struct rule_copy_left {
+    static constexpr bool is_const   = false;
+    static constexpr bool may_vanish = false;
+
+    static inline expression_node_t *build(rule_context_t *context) {
+        return copy_node(context->derivative, context->node->left);
+    }
+
+    //Nodes of compile time tree are never changed, so operand is shared instead of copied
+    template <typename Tree>
+    static constexpr int build_static(rule_static_context_t<Tree> *context) {
+        return context->tree->nodes[context->node].left;
+    }
+};
+
+struct rule_copy_right {
+    static constexpr bool is_const   = false;
+    static constexpr bool may_vanish = false;
+
+    static inline expression_node_t *build(rule_context_t *context) {
+        return copy_node(context->derivative, context->node->right);
+    }
+
+    template <typename Tree>
+    static constexpr int build_static(rule_static_context_t<Tree> *context) {
+        return context->tree->nodes[context->node].right;
+    }
+};
+
+struct rule_diff_left {
+    static constexpr bool is_const   = false;
+    static constexpr bool may_vanish = true;
+
+    static inline expression_node_t *build(rule_context_t *context) {
+        return differentiate_node(context->derivative, context->node->left, context->diff_variable, context->log_info);
+    }
+
+    template <typename Tree>
+    static constexpr int build_static(rule_static_context_t<Tree> *context) {
+        return static_differentiate_node(context->tree, context->tree->nodes[context->node].left, context->diff_variable);
+    }
+};
+
+struct rule_diff_right {
+    static constexpr bool is_const   = false;
+    static constexpr bool may_vanish = true;
+
+    static inline expression_node_t *build(rule_context_t *context) {
+        return differentiate_node(context->derivative, context->node->right, context->diff_variable, context->log_info);
+    }
+
+    template <typename Tree>
+    static constexpr int build_static(rule_static_context_t<Tree> *context) {
+        return static_differentiate_node(context->tree, context->tree->nodes[context->node].right, context->diff_variable);
+    }
+};
+
+/*=========================================================================================================*/
+
+struct rule_depends_left {
+    static inline bool check(rule_context_t *context) {
+        return count_variables(context->node->left, context->diff_variable) != 0;
+    }
+
+    template <typename Tree>
+    static constexpr bool check_static(rule_static_context_t<Tree> *context) {
+        return static_depends(context->tree, context->tree->nodes[context->node].left, context->diff_variable);
+    }
+};
+
+struct rule_depends_right {
+    static inline bool check(rule_context_t *context) {
+        return count_variables(context->node->right, context->diff_variable) != 0;
+    }
+
+    template <typename Tree>
+    static constexpr bool check_static(rule_static_context_t<Tree> *context) {
+        return static_depends(context->tree, context->tree->nodes[context->node].right, context->diff_variable);
+    }
+};
+
+template <typename Condition, typename Then, typename Else>
+struct rule_if {
+    static constexpr bool is_const   = false;
+    static constexpr bool may_vanish = Then::may_vanish || Else::may_vanish;
+
+    static inline expression_node_t *build(rule_context_t *context) {
+        if(Condition::check(context)) {
+            return Then::build(context);
+        }
+        return Else::build(context);
+    }
+
+    template <typename Tree>
+    static constexpr int build_static(rule_static_context_t<Tree> *context) {
+        if(Condition::check_static(context)) {
+            return Then::build_static(context);
+        }
+        return Else::build_static(context);
+    }
+};
+
+/*=========================================================================================================*/
+
+template <operation_t Operation>
+inline expression_node_t *rule_build_operation(rule_context_t    *context,
+                                               expression_node_t *left,
+                                               expression_node_t *right) {
+    if(right == NULL || (left == NULL && is_binary_operation(Operation))) {
+        return NULL;
+    }
+
+    double value = NAN;
+    build_fold_t fold = BUILD_FOLD_NONE;
+    if(right->type == NODE_TYPE_NUM && (left == NULL || left->type == NODE_TYPE_NUM)) {
+        value = run_operation(left == NULL ? 0 : left->value.numeric_value, right->value.numeric_value, Operation);
+        fold  = isnan(value) ? BUILD_FOLD_NONE : BUILD_FOLD_CONST;
+    }
+    if(fold == BUILD_FOLD_NONE) {
+        fold = neutral_rules<Operation>::type::match(left, right, &value);
+    }
+    return build_apply_fold(context->derivative, fold, Operation, left, right, value, context->log_info);
+}
+
+/*=========================================================================================================*/
+
+template <operation_t Operation, typename Operand, rule_side_t Side>
+constexpr neutral_static_t rule_static_fold() {
+    if constexpr (Operand::is_const) {
+        return neutral_rules<Operation>::type::template find<Side, Operand::numerator, Operand::denominator>();
+    }
+    else {
+        return {BUILD_FOLD_NONE, 0};
+    }
+}
+
+template <operation_t Operation, typename Left, typename Right>
+struct rule_op {
+    static constexpr bool is_const = false;
+    static constexpr bool vanishes_with_left  = Operation == OPERATION_MUL || Operation == OPERATION_DIV;
+    static constexpr bool vanishes_with_right = Operation == OPERATION_MUL;
+    static constexpr bool may_vanish = (vanishes_with_left  && Left::may_vanish ) ||
+                                       (vanishes_with_right && Right::may_vanish) ||
+                                       ((Operation == OPERATION_ADD || Operation == OPERATION_SUB) &&
+                                        Left::may_vanish && Right::may_vanish);
+
+    static constexpr neutral_static_t left_fold  = rule_static_fold<Operation, Left , RULE_SIDE_LEFT >();
+    static constexpr neutral_static_t right_fold = rule_static_fold<Operation, Right, RULE_SIDE_RIGHT>();
+    static constexpr neutral_static_t fold       = left_fold.fold != BUILD_FOLD_NONE ? left_fold : right_fold;
+
+    static inline expression_node_t *build(rule_context_t *context) {
+        //Neutral element written in the rule itself is folded at compile time
+        if constexpr (fold.fold == BUILD_FOLD_LEFT) {
+            return Left::build(context);
+        }
+        else if constexpr (fold.fold == BUILD_FOLD_RIGHT) {
+            return Right::build(context);
+        }
+        else if constexpr (fold.fold == BUILD_FOLD_CONST) {
+            return new_node(context->derivative, NODE_TYPE_NUM, {.numeric_value = (double)fold.result}, NULL, NULL);
+        }
+        //Operand which can vanish is built first, other operand is not built at all if it did
+        else if constexpr (vanishes_with_right && Right::may_vanish && !Left::may_vanish) {
+            expression_node_t *right = Right::build(context);
+            if(right == NULL || is_node_equal(right, 0)) {
+                return right;
+            }
+            return rule_build_operation<Operation>(context, Left::build(context), right);
+        }
+        else if constexpr (vanishes_with_left && Left::may_vanish) {
+            expression_node_t *left = Left::build(context);
+            if(left == NULL || is_node_equal(left, 0)) {
+                return left;
+            }
+            return rule_build_operation<Operation>(context, left, Right::build(context));
+        }
+        else {
+            expression_node_t *left = Left::build(context);
+            return rule_build_operation<Operation>(context, left, Right::build(context));
+        }
+    }
+
+    //Same steps as build, but on compile time tree
+    template <typename Tree>
+    static constexpr int build_static(rule_static_context_t<Tree> *context) {
+        if constexpr (fold.fold == BUILD_FOLD_LEFT) {
+            return Left::build_static(context);
+        }
+        else if constexpr (fold.fold == BUILD_FOLD_RIGHT) {
+            return Right::build_static(context);
+        }
+        else if constexpr (fold.fold == BUILD_FOLD_CONST) {
+            return static_add_number(context->tree, (double)fold.result);
+        }
+        else if constexpr (vanishes_with_right && Right::may_vanish && !Left::may_vanish) {
+            int right = Right::build_static(context);
+            if(right == StaticNoNode || static_is_number(context->tree, right, 0)) {
+                return right;
+            }
+            return static_build_operation<Operation>(context->tree, Left::build_static(context), right);
+        }
+        else if constexpr (vanishes_with_left && Left::may_vanish) {
+            int left = Left::build_static(context);
+            if(left == StaticNoNode || static_is_number(context->tree, left, 0)) {
+                return left;
+            }
+            return static_build_operation<Operation>(context->tree, left, Right::build_static(context));
+        }
+        else {
+            int left = Left::build_static(context);
+            return static_build_operation<Operation>(context->tree, left, Right::build_static(context));
+        }
+    }
+};
+
+/*=========================================================================================================*/
+
+template <typename Left, typename Right> using rule_add = rule_op<OPERATION_ADD, Left, Right>;
+template <typename Left, typename Right> using rule_sub = rule_op<OPERATION_SUB, Left, Right>;
+template <typename Left, typename Right> using rule_mul = rule_op<OPERATION_MUL, Left, Right>;
+template <typename Left, typename Right> using rule_div = rule_op<OPERATION_DIV, Left, Right>;
+template <typename Left, typename Right> using rule_pow = rule_op<OPERATION_POW, Left, Right>;
+template <typename Left, typename Right> using rule_log = rule_op<OPERATION_LOG, Left, Right>;
+template <typename Argument>             using rule_sin = rule_op<OPERATION_SIN, rule_none, Argument>;
+template <typename Argument>             using rule_cos = rule_op<OPERATION_COS, rule_none, Argument>;
+template <typename Argument>             using rule_ln  = rule_op<OPERATION_LN , rule_none, Argument>;
+template <typename Argument>             using rule_sh  = rule_op<OPERATION_SH , rule_none, Argument>;
+template <typename Argument>             using rule_ch  = rule_op<OPERATION_CH , rule_none, Argument>;
+
+template <operation_t Operation>
+struct diff_rule;
+
+#endif
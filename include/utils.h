@@ -8,6 +8,8 @@ size_t file_size        (FILE   *file);
 bool is_equal           (double  first,
                          double  second);
 
+bool is_integer         (double  value);
+
 size_t get_random_index (size_t  size);
 
 #endif
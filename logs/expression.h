@@ -0,0 +1,66 @@
+//Generated by matan_killer, do not edit
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+namespace expression {
+
+constexpr inline double integer_power(double base, long power) {
+    switch(power) {
+        case -2: return 1 / (base * base);
+        case -1: return 1 / base;
+        case  2: return base * base;
+        case  3: return base * base * base;
+        default: break;
+    }
+    unsigned long rest   = (unsigned long)(power < 0 ? -power : power);
+    double        result = 1;
+    while(rest != 0) {
+        if(rest & 1) {
+            result *= base;
+        }
+        base *= base;
+        rest >>= 1;
+    }
+    return power < 0 ? 1 / result : result;
+}
+
+inline double power(double base, double exponent) {
+    if(std::fabs(exponent) > 64.0 || std::fpclassify(exponent - std::rint(exponent)) != FP_ZERO) {
+        return std::pow(base, exponent);
+    }
+    return integer_power(base, (long)exponent);
+}
+
+inline double f(double f, double x, double y) {
+    return ((std::sin(f) * x) + power(f, y));
+}
+
+inline void f_batch(const double *__restrict in_f, const double *__restrict in_x, const double *__restrict in_y, double *__restrict result, std::size_t size) {
+    for(std::size_t point = 0; point < size; point++) {
+        result[point] = f(in_f[point], in_x[point], in_y[point]);
+    }
+}
+
+inline double f_d1(double f, double x, double y) {
+    return ((x * std::cos(f)) + (y * power(f, (y - 1.0))));
+}
+
+inline void f_d1_batch(const double *__restrict in_f, const double *__restrict in_x, const double *__restrict in_y, double *__restrict result, std::size_t size) {
+    for(std::size_t point = 0; point < size; point++) {
+        result[point] = f_d1(in_f[point], in_x[point], in_y[point]);
+    }
+}
+
+inline double f_d2(double f, double x, double y) {
+    return (((-1.0) * (x * std::sin(f))) + ((y * (y - 1.0)) * power(f, (y - 2.0))));
+}
+
+inline void f_d2_batch(const double *__restrict in_f, const double *__restrict in_x, const double *__restrict in_y, double *__restrict result, std::size_t size) {
+    for(std::size_t point = 0; point < size; point++) {
+        result[point] = f_d2(in_f[point], in_x[point], in_y[point]);
+    }
+}
+
+}
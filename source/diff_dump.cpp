@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 #include <time.h>
 
 #include "utils.h"
@@ -49,6 +50,20 @@ static const size_t SimplifyNeutralsPhrasesSize = sizeof(SimplifyNeutralsPhrases
 
 /*=========================================================================================================*/
 
+static const char *SimplifyNormalizePhrases[] = {
+    "Приводя подобные слагаемые:",
+    "Собирая одинаковые множители:"};
+static const size_t SimplifyNormalizePhrasesSize = sizeof(SimplifyNormalizePhrases) / sizeof(SimplifyNormalizePhrases[0]);
+
+/*=========================================================================================================*/
+
+static const char *SimplifySaturatePhrases[] = {
+    "Перебирая все равносильные записи:",
+    "Заметим, что выражение можно записать короче:"};
+static const size_t SimplifySaturatePhrasesSize = sizeof(SimplifySaturatePhrases) / sizeof(SimplifySaturatePhrases[0]);
+
+/*=========================================================================================================*/
+
 static const char *WritingResultPhrases[] = {
     "Подводя итог:",
     "Несмотря на все сложности нам удалось найти ответ на эту задачу:"};
@@ -114,6 +129,9 @@ static expression_error_t latex_log_write_substitutions         (latex_log_info_
 static expression_error_t latex_log_check_substitutions         (latex_log_info_t  *log_info,
                                                                  expression_node_t *node);
 
+static bool               latex_is_substitution_pending         (latex_log_info_t  *log_info,
+                                                                 expression_node_t *node);
+
 /*=========================================================================================================*/
 
 expression_error_t technical_dump_ctor(expression_t *expression,
@@ -143,7 +161,9 @@ expression_error_t technical_dump_ctor(expression_t *expression,
 expression_error_t technical_dump_dtor(expression_t *expression) {
     _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER);
 
-    fclose(expression->dump_info.technical_file);
+    if(expression->dump_info.technical_file != NULL) {
+        fclose(expression->dump_info.technical_file);
+    }
     expression->dump_info.technical_file = NULL;
     expression->dump_info.technical_filename = NULL;
     expression->dump_info.technical_number = 0;
@@ -158,6 +178,10 @@ expression_error_t technical_dump(expression_t      *expression,
     _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER       );
     _C_ASSERT(format     != NULL, return EXPRESSION_INVALID_DUMP_FORMAT);
 
+    if(expression->dump_info.technical_file == NULL) {
+        return EXPRESSION_SUCCESS;
+    }
+
     char dot_filename[256] = {};
     sprintf(dot_filename,
             "logs/dot/%s%04lx.dot",
@@ -374,9 +398,12 @@ expression_error_t latex_log_ctor(latex_log_info_t *log_info,
 expression_error_t latex_log_write(latex_log_info_t  *log_info,
                                    log_action_t       action,
                                    expression_node_t *node, ...) {
-    _C_ASSERT(log_info != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
     _C_ASSERT(node     != NULL, return EXPRESSION_NODE_NULL_POINTER    );
 
+    if(log_info == NULL) {
+        return EXPRESSION_SUCCESS;
+    }
+
     if(action == TAILOR_NEW_DIFF) {
         va_list args;
         va_start(args, node);
@@ -437,7 +464,10 @@ expression_error_t latex_write_subtree(latex_log_info_t  *log_info,
     _C_ASSERT(node     != NULL, return EXPRESSION_NODE_NULL_POINTER    );
 
     if(node->is_substitution) {
-        log_info->substitution_to_write[log_info->to_write_number++] = node;
+        //Copies of common subexpression share the name and are defined once
+        if(!latex_is_substitution_pending(log_info, node)) {
+            log_info->substitution_to_write[log_info->to_write_number++] = node;
+        }
         fprintf(log_info->file, "{%s}", node->substitution_name);
         return EXPRESSION_SUCCESS;
     }
@@ -575,6 +605,16 @@ const char *get_action_phrase(log_action_t action) {
             phrases_array_size = SimplifyNeutralsPhrasesSize;
             break;
         }
+        case SIMPLIFICATION_NORMALIZE: {
+            phrases_array = SimplifyNormalizePhrases;
+            phrases_array_size = SimplifyNormalizePhrasesSize;
+            break;
+        }
+        case SIMPLIFICATION_SATURATE: {
+            phrases_array = SimplifySaturatePhrases;
+            phrases_array_size = SimplifySaturatePhrasesSize;
+            break;
+        }
         case WRITING_RESULT: {
             phrases_array = WritingResultPhrases;
             phrases_array_size = WritingResultPhrasesSize;
@@ -650,7 +690,6 @@ expression_error_t latex_log_write_substitutions(latex_log_info_t *log_info) {
     for(size_t i = 0; i < log_info->to_write_number; i++) {
         fprintf(log_info->file, "\\[%s = ", log_info->substitution_to_write[i]->substitution_name);
         expression_node_t *node = log_info->substitution_to_write[i];
-        log_info->substitution_to_write[i] = NULL;
         _RETURN_IF_ERROR(SupportedOperations[node->value.operation].latex_logger(log_info, node));
         fprintf(log_info->file, "\\]\n");
     }
@@ -659,3 +698,13 @@ expression_error_t latex_log_write_substitutions(latex_log_info_t *log_info) {
     return EXPRESSION_SUCCESS;
 }
 
+/*=========================================================================================================*/
+
+bool latex_is_substitution_pending(latex_log_info_t *log_info, expression_node_t *node) {
+    for(size_t i = 0; i < log_info->to_write_number; i++) {
+        if(strcmp(log_info->substitution_to_write[i]->substitution_name, node->substitution_name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "diff_memo.h"
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "colors.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static size_t             count_operations   (expression_node_t *node);
+
+static expression_error_t diff_memo_insert   (diff_memo_t       *memo,
+                                              expression_node_t *node);
+
+static diff_memo_entry_t *diff_memo_probe    (diff_memo_t       *memo,
+                                              expression_node_t *node);
+
+/*=========================================================================================================*/
+
+expression_error_t diff_memo_ctor(diff_memo_t *memo, expression_node_t *root) {
+    _C_ASSERT(memo != NULL, return EXPRESSION_NULL_POINTER);
+
+    size_t operations_number = count_operations(root);
+    memo->capacity = 1;
+    while(memo->capacity < 2 * operations_number) {
+        memo->capacity *= 2;
+    }
+    memo->entries = (diff_memo_entry_t *)calloc(memo->capacity, sizeof(memo->entries[0]));
+    if(memo->entries == NULL) {
+        print_error("Error while allocating differentiation memo.\n");
+        return EXPRESSION_MEMO_ALLOCATION_ERROR;
+    }
+
+    _RETURN_IF_ERROR(diff_memo_insert(memo, root));
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+diff_memo_entry_t *diff_memo_find(diff_memo_t *memo, expression_node_t *node) {
+    if(memo == NULL || node == NULL || node->type != NODE_TYPE_OP) {
+        return NULL;
+    }
+
+    diff_memo_entry_t *entry = diff_memo_probe(memo, node);
+    //Subtrees met only once are differentiated once anyway and are not worth a copy in memo
+    if(entry->source == NULL || entry->uses < 2) {
+        return NULL;
+    }
+    return entry;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t diff_memo_dtor(diff_memo_t *memo, expression_t *derivative) {
+    _C_ASSERT(memo       != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(derivative != NULL, return EXPRESSION_NULL_POINTER);
+
+    for(size_t i = 0; i < memo->capacity; i++) {
+        _RETURN_IF_ERROR(expression_delete_subtree(derivative, memo->entries[i].result));
+    }
+    free(memo->entries);
+    memo->entries  = NULL;
+    memo->capacity = 0;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+size_t count_operations(expression_node_t *node) {
+    if(node == NULL || node->type != NODE_TYPE_OP) {
+        return 0;
+    }
+    return 1 + count_operations(node->left) + count_operations(node->right);
+}
+
+/*=========================================================================================================*/
+
+expression_error_t diff_memo_insert(diff_memo_t *memo, expression_node_t *node) {
+    _C_ASSERT(memo != NULL, return EXPRESSION_NULL_POINTER);
+
+    if(node == NULL || node->type != NODE_TYPE_OP) {
+        return EXPRESSION_SUCCESS;
+    }
+
+    diff_memo_entry_t *entry = diff_memo_probe(memo, node);
+    if(entry->source == NULL) {
+        entry->source = node;
+    }
+    entry->uses++;
+
+    _RETURN_IF_ERROR(diff_memo_insert(memo, node->left ));
+    _RETURN_IF_ERROR(diff_memo_insert(memo, node->right));
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+diff_memo_entry_t *diff_memo_probe(diff_memo_t *memo, expression_node_t *node) {
+    _C_ASSERT(memo != NULL, return NULL);
+    _C_ASSERT(node != NULL, return NULL);
+
+    size_t mask  = memo->capacity - 1;
+    size_t index = node->hash & mask;
+    while(memo->entries[index].source != NULL &&
+          !is_subtree_equal(memo->entries[index].source, node)) {
+        index = (index + 1) & mask;
+    }
+    return memo->entries + index;
+}
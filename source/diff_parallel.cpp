@@ -0,0 +1,307 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "diff_parallel.h"
+#include "diff_rules.h"
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "expression_budget.h"
+#include "colors.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static const size_t ParallelMinTaskSize    = 1024;
+static const size_t ParallelTasksPerThread = 8;
+static const size_t SplitHasTasks          = SIZE_MAX;
+
+/*=========================================================================================================*/
+
+struct diff_parallel_worker_t {
+    pthread_t            thread;
+    bool                 is_started;
+    diff_parallel_t     *parallel;
+    expression_t         segment;
+    size_t               diff_variable;
+    expression_error_t   error;
+};
+
+/*=========================================================================================================*/
+
+static size_t             subtree_size          (expression_node_t      *node);
+
+static size_t             diff_parallel_split   (diff_parallel_t        *parallel,
+                                                 expression_node_t      *node);
+
+static void               diff_parallel_schedule(diff_parallel_t        *parallel,
+                                                 expression_node_t      *node,
+                                                 size_t                  size);
+
+static void               diff_parallel_close   (diff_parallel_t        *parallel);
+
+static size_t             diff_parallel_probe   (diff_parallel_t        *parallel,
+                                                 expression_node_t      *node);
+
+static void              *diff_parallel_worker  (void                   *argument);
+
+/*=========================================================================================================*/
+
+expression_error_t diff_parallel_ctor(diff_parallel_t   *parallel,
+                                      expression_node_t *root,
+                                      size_t             threads_number) {
+    _C_ASSERT(parallel != NULL, return EXPRESSION_NULL_POINTER);
+
+    size_t tree_size = subtree_size(root);
+    if(threads_number < 2 || tree_size < 2 * ParallelMinTaskSize) {
+        return EXPRESSION_SUCCESS;
+    }
+
+    parallel->grain = tree_size / (threads_number * ParallelTasksPerThread);
+    if(parallel->grain < ParallelMinTaskSize) {
+        parallel->grain = ParallelMinTaskSize;
+    }
+
+    parallel->roots   = (diff_parallel_root_t *)calloc(tree_size,     sizeof(parallel->roots[0]  ));
+    parallel->batches = (size_t               *)calloc(tree_size + 1, sizeof(parallel->batches[0]));
+    if(parallel->roots == NULL || parallel->batches == NULL) {
+        print_error("Error while allocating parallel differentiation tasks.\n");
+        return EXPRESSION_PARALLEL_ALLOCATION_ERROR;
+    }
+
+    if(diff_parallel_split(parallel, root) != SplitHasTasks) {
+        parallel->roots_number   = 0;
+        parallel->batches_number = 0;
+        return EXPRESSION_SUCCESS;
+    }
+    diff_parallel_close(parallel);
+
+    parallel->index_capacity = 1;
+    while(parallel->index_capacity < 2 * parallel->roots_number) {
+        parallel->index_capacity *= 2;
+    }
+    parallel->index = (size_t *)calloc(parallel->index_capacity, sizeof(parallel->index[0]));
+    if(parallel->index == NULL) {
+        print_error("Error while allocating parallel differentiation index.\n");
+        return EXPRESSION_PARALLEL_ALLOCATION_ERROR;
+    }
+    for(size_t root_index = 0; root_index < parallel->roots_number; root_index++) {
+        parallel->index[diff_parallel_probe(parallel, parallel->roots[root_index].source)] = root_index + 1;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t diff_parallel_run(diff_parallel_t *parallel,
+                                     expression_t    *derivative,
+                                     size_t           diff_variable,
+                                     size_t           threads_number) {
+    _C_ASSERT(parallel   != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(derivative != NULL, return EXPRESSION_NULL_POINTER);
+
+    if(parallel->batches_number == 0) {
+        return EXPRESSION_SUCCESS;
+    }
+
+    diff_parallel_worker_t *workers = (diff_parallel_worker_t *)calloc(threads_number, sizeof(workers[0]));
+    if(workers == NULL) {
+        print_error("Error while allocating parallel differentiation workers.\n");
+        return EXPRESSION_PARALLEL_ALLOCATION_ERROR;
+    }
+
+    //Workers share budget of derivative, node limit is checked for nodes of derivative and all segments
+    expression_error_t error_code = EXPRESSION_SUCCESS;
+    parallel->nodes_number = derivative->nodes_storage.size;
+    for(size_t worker = 0; worker < threads_number; worker++) {
+        workers[worker].parallel                 = parallel;
+        workers[worker].diff_variable            = diff_variable;
+        workers[worker].segment.variables_list   = derivative->variables_list;
+        workers[worker].segment.budget           = derivative->budget;
+        workers[worker].error                    = nodes_storage_ctor(&workers[worker].segment.nodes_storage);
+    }
+
+    //Batches are taken from shared counter, so if thread was not created its work is done by others
+    for(size_t worker = 1; worker < threads_number; worker++) {
+        workers[worker].is_started = pthread_create(&workers[worker].thread,
+                                                    NULL,
+                                                    diff_parallel_worker,
+                                                    workers + worker) == 0;
+    }
+    diff_parallel_worker(workers);
+    for(size_t worker = 1; worker < threads_number; worker++) {
+        if(workers[worker].is_started) {
+            pthread_join(workers[worker].thread, NULL);
+        }
+    }
+
+    for(size_t worker = 0; worker < threads_number; worker++) {
+        if(error_code == EXPRESSION_SUCCESS) {
+            error_code = workers[worker].error;
+        }
+        if(workers[worker].segment.nodes_storage.containers == NULL) {
+            continue;
+        }
+        expression_error_t merge_error = nodes_storage_merge(&derivative->nodes_storage,
+                                                             &workers[worker].segment.nodes_storage);
+        if(error_code == EXPRESSION_SUCCESS) {
+            error_code = merge_error;
+        }
+    }
+
+    free(workers);
+    return error_code;
+}
+
+/*=========================================================================================================*/
+
+expression_node_t *diff_parallel_take(diff_parallel_t *parallel, expression_node_t *node) {
+    if(parallel == NULL || parallel->index == NULL) {
+        return NULL;
+    }
+
+    size_t root_index = parallel->index[diff_parallel_probe(parallel, node)];
+    if(root_index == 0) {
+        return NULL;
+    }
+    parallel->roots[root_index - 1].is_used = true;
+    return parallel->roots[root_index - 1].result;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t diff_parallel_dtor(diff_parallel_t *parallel, expression_t *derivative) {
+    _C_ASSERT(parallel   != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(derivative != NULL, return EXPRESSION_NULL_POINTER);
+
+    for(size_t root_index = 0; root_index < parallel->roots_number; root_index++) {
+        if(!parallel->roots[root_index].is_used) {
+            _RETURN_IF_ERROR(expression_delete_subtree(derivative, parallel->roots[root_index].result));
+        }
+    }
+    free(parallel->roots);
+    free(parallel->batches);
+    free(parallel->index);
+    if(memset(parallel, 0, sizeof(*parallel)) != parallel) {
+        return EXPRESSION_SETTING_TO_ZERO_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+size_t subtree_size(expression_node_t *node) {
+    if(node == NULL) {
+        return 0;
+    }
+    return 1 + subtree_size(node->left) + subtree_size(node->right);
+}
+
+/*=========================================================================================================*/
+
+size_t diff_parallel_split(diff_parallel_t *parallel, expression_node_t *node) {
+    _C_ASSERT(parallel != NULL, return 0);
+
+    if(node == NULL) {
+        return 0;
+    }
+    if(node->type != NODE_TYPE_OP) {
+        return 1;
+    }
+
+    size_t left  = diff_parallel_split(parallel, node->left );
+    size_t right = diff_parallel_split(parallel, node->right);
+    //Node above scheduled subtree is differentiated after tasks, so its other operand becomes a task
+    if(left == SplitHasTasks || right == SplitHasTasks) {
+        if(left != SplitHasTasks) {
+            diff_parallel_schedule(parallel, node->left, left);
+        }
+        if(right != SplitHasTasks) {
+            diff_parallel_schedule(parallel, node->right, right);
+        }
+        return SplitHasTasks;
+    }
+
+    size_t size = 1 + left + right;
+    if(size >= parallel->grain) {
+        diff_parallel_schedule(parallel, node, size);
+        return SplitHasTasks;
+    }
+    return size;
+}
+
+/*=========================================================================================================*/
+
+void diff_parallel_schedule(diff_parallel_t *parallel, expression_node_t *node, size_t size) {
+    _C_ASSERT(parallel != NULL, return);
+
+    //Leaves are cheaper to differentiate in place than to look up
+    if(size < 2) {
+        return;
+    }
+    parallel->roots[parallel->roots_number++].source = node;
+    parallel->pending_size += size;
+    if(parallel->pending_size >= parallel->grain) {
+        diff_parallel_close(parallel);
+    }
+}
+
+/*=========================================================================================================*/
+
+void diff_parallel_close(diff_parallel_t *parallel) {
+    _C_ASSERT(parallel != NULL, return);
+
+    if(parallel->pending_size == 0) {
+        return;
+    }
+    parallel->batches[++parallel->batches_number] = parallel->roots_number;
+    parallel->pending_size = 0;
+}
+
+/*=========================================================================================================*/
+
+size_t diff_parallel_probe(diff_parallel_t *parallel, expression_node_t *node) {
+    _C_ASSERT(parallel != NULL, return 0);
+
+    size_t mask  = parallel->index_capacity - 1;
+    size_t index = ((size_t)(uintptr_t)node / sizeof(expression_node_t)) & mask;
+    while(parallel->index[index] != 0 &&
+          parallel->roots[parallel->index[index] - 1].source != node) {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+/*=========================================================================================================*/
+
+void *diff_parallel_worker(void *argument) {
+    _C_ASSERT(argument != NULL, return NULL);
+
+    diff_parallel_worker_t *worker   = (diff_parallel_worker_t *)argument;
+    diff_parallel_t        *parallel = worker->parallel;
+    while(worker->error == EXPRESSION_SUCCESS) {
+        size_t batch = __atomic_fetch_add(&parallel->next_batch, 1, __ATOMIC_RELAXED);
+        if(batch >= parallel->batches_number) {
+            break;
+        }
+        for(size_t root_index = parallel->batches[batch]; root_index < parallel->batches[batch + 1]; root_index++) {
+            diff_parallel_root_t *root         = parallel->roots + root_index;
+            size_t                segment_size = worker->segment.nodes_storage.size;
+            root->result = differentiate_node(&worker->segment, root->source, worker->diff_variable, NULL);
+            size_t added = worker->segment.nodes_storage.size > segment_size ?
+                           worker->segment.nodes_storage.size - segment_size : 0;
+            size_t nodes_number = __atomic_add_fetch(&parallel->nodes_number, added, __ATOMIC_RELAXED);
+            //Expired budget tells why differentiation has stopped
+            worker->error = expression_budget_check(worker->segment.budget, nodes_number);
+            if(worker->error == EXPRESSION_SUCCESS && root->result == NULL) {
+                worker->error = EXPRESSION_DIFFERENTIATING_ERROR;
+            }
+            if(worker->error != EXPRESSION_SUCCESS) {
+                break;
+            }
+        }
+    }
+    return NULL;
+}
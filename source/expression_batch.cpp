@@ -0,0 +1,404 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "expression_batch.h"
+#include "expression_bytecode.h"
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "expression_scalar.h"
+#include "colors.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+//One register holds a whole AVX-512 register or two AVX2 ones: 8 doubles or 16 floats
+static const size_t BatchBytes = 64;
+
+template <typename Scalar>
+struct batch_vector {
+    typedef Scalar type __attribute__((vector_size(BatchBytes)));
+    typedef Scalar half __attribute__((vector_size(BatchBytes / 2)));
+    static const size_t width = BatchBytes / sizeof(Scalar);
+};
+
+enum batch_target_t {
+    BATCH_TARGET_DEFAULT = 0,
+    BATCH_TARGET_AVX2    = 1,
+    BATCH_TARGET_AVX512  = 2,
+};
+
+/*=========================================================================================================*/
+
+//Vector variants of libm functions from glibc libmvec: _ZGVd work on AVX2 halves of register,
+//_ZGVe on whole AVX-512 register. Their error is a few ulp, so results are close to scalar but not equal.
+typedef batch_vector<double>::type batch_double_t;
+typedef batch_vector<double>::half batch_double_half_t;
+typedef batch_vector<float >::type batch_float_t;
+typedef batch_vector<float >::half batch_float_half_t;
+
+#define _DECLARE_LIBMVEC(arguments, name)                                                                     \
+    batch_double_half_t _ZGVdN4##arguments##_##name    (_LIBMVEC_ARGUMENTS_##arguments(batch_double_half_t)); \
+    batch_double_t      _ZGVeN8##arguments##_##name    (_LIBMVEC_ARGUMENTS_##arguments(batch_double_t     )); \
+    batch_float_half_t  _ZGVdN8##arguments##_##name##f (_LIBMVEC_ARGUMENTS_##arguments(batch_float_half_t )); \
+    batch_float_t       _ZGVeN16##arguments##_##name##f(_LIBMVEC_ARGUMENTS_##arguments(batch_float_t      ));
+#define _LIBMVEC_ARGUMENTS_v(type)  type
+#define _LIBMVEC_ARGUMENTS_vv(type) type, type
+
+extern "C" {
+    _DECLARE_LIBMVEC(v , sin )
+    _DECLARE_LIBMVEC(v , cos )
+    _DECLARE_LIBMVEC(v , tan )
+    _DECLARE_LIBMVEC(v , log )
+    _DECLARE_LIBMVEC(v , asin)
+    _DECLARE_LIBMVEC(v , acos)
+    _DECLARE_LIBMVEC(v , atan)
+    _DECLARE_LIBMVEC(v , sinh)
+    _DECLARE_LIBMVEC(v , cosh)
+    _DECLARE_LIBMVEC(v , tanh)
+    _DECLARE_LIBMVEC(vv, pow )
+}
+
+template <operation_t Operation, typename Scalar>
+struct batch_libmvec {};
+
+#define _BATCH_LIBMVEC(operation, arguments, name)                      \
+    template <> struct batch_libmvec<operation, double> {               \
+        static constexpr auto avx2   = _ZGVdN4##arguments##_##name;     \
+        static constexpr auto avx512 = _ZGVeN8##arguments##_##name;     \
+    };                                                                  \
+    template <> struct batch_libmvec<operation, float> {                \
+        static constexpr auto avx2   = _ZGVdN8##arguments##_##name##f;  \
+        static constexpr auto avx512 = _ZGVeN16##arguments##_##name##f; \
+    };
+
+_BATCH_LIBMVEC(OPERATION_SIN   , v , sin )
+_BATCH_LIBMVEC(OPERATION_COS   , v , cos )
+_BATCH_LIBMVEC(OPERATION_TG    , v , tan )
+_BATCH_LIBMVEC(OPERATION_LN    , v , log )
+_BATCH_LIBMVEC(OPERATION_ARCSIN, v , asin)
+_BATCH_LIBMVEC(OPERATION_ARCCOS, v , acos)
+_BATCH_LIBMVEC(OPERATION_ARCTG , v , atan)
+_BATCH_LIBMVEC(OPERATION_SH    , v , sinh)
+_BATCH_LIBMVEC(OPERATION_CH    , v , cosh)
+_BATCH_LIBMVEC(OPERATION_TH    , v , tanh)
+_BATCH_LIBMVEC(OPERATION_POW   , vv, pow )
+
+#undef _BATCH_LIBMVEC
+#undef _DECLARE_LIBMVEC
+#undef _LIBMVEC_ARGUMENTS_v
+#undef _LIBMVEC_ARGUMENTS_vv
+
+/*=========================================================================================================*/
+
+template <typename Scalar>
+static void batch_load_block    (const bytecode_t                          *bytecode,
+                                 typename batch_vector<Scalar>::type       *registers,
+                                 const Scalar *const                       *inputs,
+                                 size_t                                     first_point,
+                                 size_t                                     points_number);
+
+template <typename Scalar>
+static void batch_run_block     (const bytecode_t                          *bytecode,
+                                 typename batch_vector<Scalar>::type       *registers);
+
+template <typename Vector>
+static void batch_integer_power (Vector                                    *target,
+                                 const Vector                              *base,
+                                 long                                       power);
+
+template <operation_t Operation, typename Scalar>
+static void batch_apply         (typename batch_vector<Scalar>::type       *target,
+                                 const typename batch_vector<Scalar>::type *left,
+                                 const typename batch_vector<Scalar>::type *right);
+
+template <operation_t Operation, typename Scalar>
+__attribute__((target("avx2")))
+static void batch_apply_avx2    (typename batch_vector<Scalar>::type       *target,
+                                 const typename batch_vector<Scalar>::type *left,
+                                 const typename batch_vector<Scalar>::type *right);
+
+template <operation_t Operation, typename Scalar>
+__attribute__((target("avx512f")))
+static void batch_apply_avx512  (typename batch_vector<Scalar>::type       *target,
+                                 const typename batch_vector<Scalar>::type *left,
+                                 const typename batch_vector<Scalar>::type *right);
+
+static batch_target_t batch_target(void);
+
+/*=========================================================================================================*/
+
+expression_error_t expression_evaluate_batch(expression_t        *expression,
+                                             const double *const *inputs,
+                                             size_t               points_number,
+                                             double              *outputs) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(inputs     != NULL, return EXPRESSION_BATCH_INPUT_NULL   );
+    _C_ASSERT(outputs    != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    bytecode_t bytecode = {};
+    _RETURN_IF_ERROR(bytecode_ctor(&bytecode, expression));
+    expression_error_t error_code = bytecode_evaluate_batch(&bytecode, inputs, points_number, outputs);
+    _RETURN_IF_ERROR(bytecode_dtor(&bytecode));
+    return error_code;
+}
+
+/*=========================================================================================================*/
+
+//inputs[index] is the array of values of variable with this index in variables list,
+//it can be NULL for variables which are not used in expression
+template <typename Scalar>
+expression_error_t bytecode_evaluate_batch(const bytecode_t    *bytecode,
+                                           const Scalar *const *inputs,
+                                           size_t               points_number,
+                                           Scalar              *outputs) {
+    _C_ASSERT(bytecode != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(inputs   != NULL, return EXPRESSION_BATCH_INPUT_NULL   );
+    _C_ASSERT(outputs  != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    typedef typename batch_vector<Scalar>::type vector_t;
+    const size_t BatchWidth = batch_vector<Scalar>::width;
+
+    for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+        if(((bytecode->variables_mask >> variable) & 1) && inputs[variable] == NULL) {
+            print_error("Values of variable %lu are not given for batch evaluation.\n", variable);
+            return EXPRESSION_BATCH_INPUT_NULL;
+        }
+    }
+
+    size_t    size      = bytecode->registers_size * sizeof(vector_t);
+    vector_t *registers = (vector_t *)aligned_alloc(sizeof(vector_t), size);
+    if(registers == NULL) {
+        print_error("Error while allocating batch registers.\n");
+        return EXPRESSION_BATCH_ALLOCATION_ERROR;
+    }
+    //Constants are the same in all blocks, so they are broadcasted once
+    for(size_t index = 0; index < bytecode->registers_size; index++) {
+        for(size_t lane = 0; lane < BatchWidth; lane++) {
+            registers[index][lane] = (Scalar)bytecode->registers[index];
+        }
+    }
+
+    for(size_t first_point = 0; first_point < points_number; first_point += BatchWidth) {
+        batch_load_block<Scalar>(bytecode, registers, inputs, first_point, points_number);
+        batch_run_block <Scalar>(bytecode, registers);
+        size_t lanes = points_number - first_point < BatchWidth ? points_number - first_point : BatchWidth;
+        for(size_t lane = 0; lane < lanes; lane++) {
+            outputs[first_point + lane] = registers[bytecode->result][lane];
+        }
+    }
+    free(registers);
+    return EXPRESSION_SUCCESS;
+}
+
+template expression_error_t bytecode_evaluate_batch(const bytecode_t    *bytecode,
+                                                    const double *const *inputs,
+                                                    size_t               points_number,
+                                                    double              *outputs);
+
+template expression_error_t bytecode_evaluate_batch(const bytecode_t    *bytecode,
+                                                    const float  *const *inputs,
+                                                    size_t               points_number,
+                                                    float               *outputs);
+
+/*=========================================================================================================*/
+
+template <typename Scalar>
+void batch_load_block(const bytecode_t                    *bytecode,
+                      typename batch_vector<Scalar>::type *registers,
+                      const Scalar *const                 *inputs,
+                      size_t                               first_point,
+                      size_t                               points_number) {
+    const size_t BatchWidth = batch_vector<Scalar>::width;
+    size_t lanes = points_number - first_point < BatchWidth ? points_number - first_point : BatchWidth;
+    for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+        if(((bytecode->variables_mask >> variable) & 1) == 0) {
+            continue;
+        }
+        if(lanes == BatchWidth) {
+            memcpy(registers + variable, inputs[variable] + first_point, sizeof(registers[0]));
+            continue;
+        }
+        //Unused lanes of the last block repeat its first point, so they do not raise extra exceptions
+        for(size_t lane = 0; lane < BatchWidth; lane++) {
+            registers[variable][lane] = inputs[variable][first_point + (lane < lanes ? lane : 0)];
+        }
+    }
+}
+
+/*=========================================================================================================*/
+
+//Arithmetic is done on whole vectors, elementary functions go through batch_apply
+template <typename Scalar>
+__attribute__((target_clones("avx512f", "avx2", "default")))
+void batch_run_block(const bytecode_t *bytecode, typename batch_vector<Scalar>::type *registers) {
+    typename batch_vector<Scalar>::type *target = registers + bytecode->temporaries_start;
+
+    #define _LEFT  registers[instruction->left ]
+    #define _RIGHT registers[instruction->right]
+    #define _APPLY(operation) batch_apply<operation, Scalar>(target, &_LEFT, &_RIGHT); break
+
+    for(const bytecode_instruction_t *instruction = bytecode->code;
+        instruction->opcode != BYTECODE_RETURN;
+        instruction++, target++) {
+        switch((bytecode_opcode_t)instruction->opcode) {
+            case BYTECODE_ADD:        *target = _LEFT + _RIGHT;                             break;
+            case BYTECODE_SUB:        *target = _LEFT - _RIGHT;                             break;
+            case BYTECODE_DIV:        *target = _LEFT / _RIGHT;                             break;
+            case BYTECODE_MUL:        *target = _LEFT * _RIGHT;                             break;
+            case BYTECODE_SQUARE:     *target = _LEFT * _LEFT;                              break;
+            case BYTECODE_CUBE:       *target = _LEFT * _LEFT * _LEFT;                      break;
+            case BYTECODE_RECIPROCAL: *target = 1 / _LEFT;                                  break;
+            case BYTECODE_POWER_INT:  batch_integer_power(target, &_LEFT, (int32_t)instruction->right); break;
+            case BYTECODE_SIN:        _APPLY(OPERATION_SIN   );
+            case BYTECODE_COS:        _APPLY(OPERATION_COS   );
+            case BYTECODE_POW:        _APPLY(OPERATION_POW   );
+            case BYTECODE_LN:         _APPLY(OPERATION_LN    );
+            case BYTECODE_LOG:        _APPLY(OPERATION_LOG   );
+            case BYTECODE_TG:         _APPLY(OPERATION_TG    );
+            case BYTECODE_CTG:        _APPLY(OPERATION_CTG   );
+            case BYTECODE_ARCSIN:     _APPLY(OPERATION_ARCSIN);
+            case BYTECODE_ARCCOS:     _APPLY(OPERATION_ARCCOS);
+            case BYTECODE_ARCTG:      _APPLY(OPERATION_ARCTG );
+            case BYTECODE_ARCCTG:     _APPLY(OPERATION_ARCCTG);
+            case BYTECODE_SH:         _APPLY(OPERATION_SH    );
+            case BYTECODE_CH:         _APPLY(OPERATION_CH    );
+            case BYTECODE_TH:         _APPLY(OPERATION_TH    );
+            case BYTECODE_CTH:        _APPLY(OPERATION_CTH   );
+            case BYTECODE_RETURN:     return;
+            default:                  return;
+        }
+    }
+
+    #undef _APPLY
+    #undef _LEFT
+    #undef _RIGHT
+}
+
+/*=========================================================================================================*/
+
+//Without AVX2 functions from libm are called for each lane with the same kernels as in scalar evaluation,
+//otherwise vector functions from libmvec are called, functions missing there are expressed through others
+template <operation_t Operation, typename Scalar>
+void batch_apply(typename batch_vector<Scalar>::type       *target,
+                 const typename batch_vector<Scalar>::type *left,
+                 const typename batch_vector<Scalar>::type *right) {
+    batch_target_t cpu_target = batch_target();
+    if(cpu_target == BATCH_TARGET_DEFAULT) {
+        for(size_t lane = 0; lane < batch_vector<Scalar>::width; lane++) {
+            (*target)[lane] = run_scalar_kernel<Operation, Scalar>((*left)[lane], (*right)[lane]);
+        }
+    }
+    else if constexpr (Operation == OPERATION_LOG) {
+        typename batch_vector<Scalar>::type base = {};
+        batch_apply<OPERATION_LN, Scalar>(&base , left , left );
+        batch_apply<OPERATION_LN, Scalar>(target, right, right);
+        *target /= base;
+    }
+    else if constexpr (Operation == OPERATION_CTG) {
+        batch_apply<OPERATION_TG, Scalar>(target, left, right);
+        *target = 1 / *target;
+    }
+    else if constexpr (Operation == OPERATION_ARCCTG) {
+        batch_apply<OPERATION_ARCTG, Scalar>(target, left, right);
+        *target = (Scalar)(M_PI * 0.5) - *target;
+    }
+    else if constexpr (Operation == OPERATION_CTH) {
+        batch_apply<OPERATION_TH, Scalar>(target, left, right);
+        *target = 1 / *target;
+    }
+    else if(cpu_target == BATCH_TARGET_AVX512) {
+        batch_apply_avx512<Operation, Scalar>(target, left, right);
+    }
+    else {
+        batch_apply_avx2<Operation, Scalar>(target, left, right);
+    }
+}
+
+/*=========================================================================================================*/
+
+template <operation_t Operation, typename Scalar>
+__attribute__((target("avx2")))
+void batch_apply_avx2(typename batch_vector<Scalar>::type       *target,
+                      const typename batch_vector<Scalar>::type *left,
+                      const typename batch_vector<Scalar>::type *right) {
+    typename batch_vector<Scalar>::half left_halves [2] = {};
+    typename batch_vector<Scalar>::half right_halves[2] = {};
+    memcpy(left_halves , left , sizeof(left_halves ));
+    memcpy(right_halves, right, sizeof(right_halves));
+    for(size_t part = 0; part < 2; part++) {
+        if constexpr (Operation == OPERATION_POW) {
+            right_halves[part] = batch_libmvec<Operation, Scalar>::avx2(left_halves[part], right_halves[part]);
+        }
+        else {
+            right_halves[part] = batch_libmvec<Operation, Scalar>::avx2(right_halves[part]);
+        }
+    }
+    memcpy(target, right_halves, sizeof(right_halves));
+}
+
+/*=========================================================================================================*/
+
+template <operation_t Operation, typename Scalar>
+__attribute__((target("avx512f")))
+void batch_apply_avx512(typename batch_vector<Scalar>::type       *target,
+                        const typename batch_vector<Scalar>::type *left,
+                        const typename batch_vector<Scalar>::type *right) {
+    if constexpr (Operation == OPERATION_POW) {
+        *target = batch_libmvec<Operation, Scalar>::avx512(*left, *right);
+    }
+    else {
+        *target = batch_libmvec<Operation, Scalar>::avx512(*right);
+    }
+}
+
+/*=========================================================================================================*/
+
+//Same check as in resolver of target_clones, it is done once
+batch_target_t batch_target(void) {
+    static const batch_target_t cpu_target = __builtin_cpu_supports("avx512f") ? BATCH_TARGET_AVX512 :
+                                             __builtin_cpu_supports("avx2"   ) ? BATCH_TARGET_AVX2   :
+                                                                                 BATCH_TARGET_DEFAULT;
+    return cpu_target;
+}
+
+/*=========================================================================================================*/
+
+//Same multiplication chain as run_scalar_integer_power, done for all lanes at once
+template <typename Vector>
+__attribute__((target_clones("avx512f", "avx2", "default")))
+void batch_integer_power(Vector *target, const Vector *base, long power) {
+    Vector square = *base * *base;
+    switch(power) {
+        case -2: {
+            *target = 1 / square;
+            return;
+        }
+        case -1: {
+            *target = 1 / *base;
+            return;
+        }
+        case 2: {
+            *target = square;
+            return;
+        }
+        case 3: {
+            *target = square * *base;
+            return;
+        }
+        default: {
+            break;
+        }
+    }
+    unsigned long rest          = (unsigned long)labs(power);
+    Vector        power_of_base = *base;
+    Vector        result        = power_of_base * 0 + 1;
+    while(rest != 0) {
+        if(rest & 1) {
+            result *= power_of_base;
+        }
+        power_of_base *= power_of_base;
+        rest >>= 1;
+    }
+    *target = power < 0 ? 1 / result : result;
+}
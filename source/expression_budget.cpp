@@ -0,0 +1,85 @@
+#include <string.h>
+#include <time.h>
+
+#include "expression_budget.h"
+#include "expression_types.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static const size_t BudgetClockPeriod = 64;
+
+/*=========================================================================================================*/
+
+static double budget_seconds (void);
+
+/*=========================================================================================================*/
+
+expression_error_t expression_budget_ctor(expression_budget_t *budget,
+                                          double               seconds,
+                                          size_t               max_nodes) {
+    _C_ASSERT(budget != NULL, return EXPRESSION_NULL_POINTER);
+
+    //Zero seconds or zero nodes mean that there is no such limit
+    if(memset(budget, 0, sizeof(*budget)) != budget) {
+        return EXPRESSION_MEMSET_ERROR;
+    }
+    if(seconds > 0) {
+        budget->deadline = budget_seconds() + seconds;
+    }
+    budget->max_nodes = max_nodes;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t expression_budget_cancel(expression_budget_t *budget) {
+    _C_ASSERT(budget != NULL, return EXPRESSION_NULL_POINTER);
+
+    //Only this flag may be changed from other thread while expression is processed
+    __atomic_store_n(&budget->is_cancelled, true, __ATOMIC_RELAXED);
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t expression_budget_check(expression_budget_t *budget,
+                                           size_t               nodes_number) {
+    if(budget == NULL) {
+        return EXPRESSION_SUCCESS;
+    }
+    //Workers of parallel differentiation check one budget, so its counters and status are atomic.
+    //Expired budget stays expired, so every traversal stops at its next check
+    expression_error_t status = __atomic_load_n(&budget->status, __ATOMIC_RELAXED);
+    if(status != EXPRESSION_SUCCESS) {
+        return status;
+    }
+
+    if(__atomic_load_n(&budget->is_cancelled, __ATOMIC_RELAXED)) {
+        status = EXPRESSION_CANCELLED;
+    }
+    else if(budget->max_nodes != 0 && nodes_number > budget->max_nodes) {
+        status = EXPRESSION_NODES_LIMIT_EXCEEDED;
+    }
+    //Clock is read only on some checks, because checks are made for every node
+    else if(budget->deadline > 0 &&
+            __atomic_fetch_add(&budget->checks_number, 1, __ATOMIC_RELAXED) % BudgetClockPeriod == 0 &&
+            budget_seconds() > budget->deadline) {
+        status = EXPRESSION_DEADLINE_EXCEEDED;
+    }
+    if(status == EXPRESSION_SUCCESS) {
+        return EXPRESSION_SUCCESS;
+    }
+    //The first reason found by any thread is kept
+    expression_error_t expected = EXPRESSION_SUCCESS;
+    __atomic_compare_exchange_n(&budget->status, &expected, status, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    return __atomic_load_n(&budget->status, __ATOMIC_RELAXED);
+}
+
+/*=========================================================================================================*/
+
+double budget_seconds(void) {
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <math.h>
+
+#include "expression_builders.h"
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "operation_rules.h"
+#include "diff_dump.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static build_fold_t       build_find_fold (operation_t        operation,
+                                           expression_node_t *left,
+                                           expression_node_t *right,
+                                           double            *value);
+
+static expression_error_t build_log_fold  (latex_log_info_t  *log_info,
+                                           log_action_t       action,
+                                           operation_t        operation,
+                                           expression_node_t *left,
+                                           expression_node_t *right);
+
+/*=========================================================================================================*/
+
+bool is_binary_operation(operation_t operation) {
+    switch(operation) {
+        case OPERATION_ADD:
+        case OPERATION_SUB:
+        case OPERATION_DIV:
+        case OPERATION_MUL:
+        case OPERATION_POW:
+        case OPERATION_LOG: {
+            return true;
+        }
+        case OPERATION_UNKNOWN:
+        case OPERATION_SIN:
+        case OPERATION_COS:
+        case OPERATION_LN:
+        case OPERATION_TG:
+        case OPERATION_CTG:
+        case OPERATION_ARCSIN:
+        case OPERATION_ARCCOS:
+        case OPERATION_ARCTG:
+        case OPERATION_ARCCTG:
+        case OPERATION_SH:
+        case OPERATION_CH:
+        case OPERATION_TH:
+        case OPERATION_CTH: {
+            return false;
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+/*=========================================================================================================*/
+
+expression_node_t *build_operation(expression_t      *expression,
+                                   operation_t        operation,
+                                   expression_node_t *left,
+                                   expression_node_t *right,
+                                   latex_log_info_t  *log_info) {
+    _C_ASSERT(expression != NULL, return NULL);
+
+    if(right == NULL || (left == NULL && is_binary_operation(operation))) {
+        return NULL;
+    }
+
+    double value = NAN;
+    build_fold_t fold = build_find_fold(operation, left, right, &value);
+    return build_apply_fold(expression, fold, operation, left, right, value, log_info);
+}
+
+/*=========================================================================================================*/
+
+expression_node_t *build_apply_fold(expression_t      *expression,
+                                    build_fold_t       fold,
+                                    operation_t        operation,
+                                    expression_node_t *left,
+                                    expression_node_t *right,
+                                    double             value,
+                                    latex_log_info_t  *log_info) {
+    _C_ASSERT(expression != NULL, return NULL);
+    _C_ASSERT(right      != NULL, return NULL);
+
+    switch(fold) {
+        case BUILD_FOLD_NONE: {
+            //Only neutral rules are checked here, so node is left for full simplification
+            return new_node(expression, NODE_TYPE_OP, {.operation = operation}, left, right);
+        }
+        case BUILD_FOLD_CONST: {
+            if(build_log_fold(log_info, SIMPLIFICATION_EVALUATE, operation, left, right) != EXPRESSION_SUCCESS ||
+               expression_delete_subtree(expression, left)                               != EXPRESSION_SUCCESS ||
+               set_node_to_const(expression, right, value)                               != EXPRESSION_SUCCESS) {
+                return NULL;
+            }
+            if(log_info != NULL) {
+                latex_log_write(log_info, DIFF_RESULT, right);
+            }
+            return right;
+        }
+        case BUILD_FOLD_LEFT: {
+            if(build_log_fold(log_info, SIMPLIFICATION_NEUTRALS, operation, left, right) != EXPRESSION_SUCCESS ||
+               expression_delete_subtree(expression, right)                              != EXPRESSION_SUCCESS) {
+                return NULL;
+            }
+            if(log_info != NULL) {
+                latex_log_write(log_info, DIFF_RESULT, left);
+            }
+            return left;
+        }
+        case BUILD_FOLD_RIGHT: {
+            if(build_log_fold(log_info, SIMPLIFICATION_NEUTRALS, operation, left, right) != EXPRESSION_SUCCESS ||
+               expression_delete_subtree(expression, left)                               != EXPRESSION_SUCCESS) {
+                return NULL;
+            }
+            if(log_info != NULL) {
+                latex_log_write(log_info, DIFF_RESULT, right);
+            }
+            return right;
+        }
+        default: {
+            return NULL;
+        }
+    }
+}
+
+/*=========================================================================================================*/
+
+build_fold_t build_find_fold(operation_t        operation,
+                             expression_node_t *left,
+                             expression_node_t *right,
+                             double            *value) {
+    _C_ASSERT(right != NULL, return BUILD_FOLD_NONE);
+    _C_ASSERT(value != NULL, return BUILD_FOLD_NONE);
+
+    if(right->type == NODE_TYPE_NUM && (left == NULL || left->type == NODE_TYPE_NUM)) {
+        double left_value = left == NULL ? 0 : left->value.numeric_value;
+        *value = run_operation(left_value, right->value.numeric_value, operation);
+        if(!isnan(*value)) {
+            return BUILD_FOLD_CONST;
+        }
+    }
+
+    //Neutral elements are described in operation_rules.h
+    return neutral_fold(operation, left, right, value);
+}
+
+/*=========================================================================================================*/
+
+expression_error_t build_log_fold(latex_log_info_t  *log_info,
+                                  log_action_t       action,
+                                  operation_t        operation,
+                                  expression_node_t *left,
+                                  expression_node_t *right) {
+    if(log_info == NULL) {
+        return EXPRESSION_SUCCESS;
+    }
+
+    //Folded node is never allocated, so it is written to log from stack
+    expression_node_t unfolded = {};
+    unfolded.type            = NODE_TYPE_OP;
+    unfolded.value.operation = operation;
+    unfolded.left            = left;
+    unfolded.right           = right;
+    return latex_log_write(log_info, action, &unfolded);
+}
@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "expression_bytecode.h"
+#include "expression_types.h"
+#include "expression_cse.h"
+#include "expression_utils.h"
+#include "expression_scalar.h"
+#include "variable_list.h"
+#include "utils.h"
+#include "colors.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static expression_error_t bytecode_lower      (bytecode_t             *bytecode,
+                                               cse_program_t          *program);
+
+static void               bytecode_specialize (cse_program_t          *program,
+                                               cse_temporary_t        *temporary,
+                                               bytecode_instruction_t *instruction);
+
+template <typename Scalar>
+static Scalar             bytecode_power_int  (Scalar                  base,
+                                               long                    power);
+
+/*=========================================================================================================*/
+
+expression_error_t bytecode_ctor(bytecode_t *bytecode, expression_t *expression) {
+    _C_ASSERT(bytecode         != NULL, return EXPRESSION_NULL_POINTER     );
+    _C_ASSERT(expression       != NULL, return EXPRESSION_NULL_POINTER     );
+    _C_ASSERT(expression->root != NULL, return EXPRESSION_NODE_NULL_POINTER);
+
+    //Equal subtrees are merged first, so each of them is computed once
+    cse_program_t program = {};
+    _RETURN_IF_ERROR(cse_program_ctor(&program, expression->root));
+    expression_error_t error_code = bytecode_lower(bytecode, &program);
+    _RETURN_IF_ERROR(cse_program_dtor(&program));
+    if(error_code != EXPRESSION_SUCCESS) {
+        bytecode_dtor(bytecode);
+    }
+    return error_code;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t bytecode_evaluate(bytecode_t       *bytecode,
+                                     variables_list_t *variables_list,
+                                     double           *result) {
+    _C_ASSERT(bytecode       != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(variables_list != NULL, return EXPRESSION_VARIABLES_LIST_NULL);
+    _C_ASSERT(result         != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+        if((bytecode->variables_mask >> variable) & 1) {
+            _RETURN_IF_ERROR(variables_list_get_value(variables_list, variable, bytecode->registers + variable));
+        }
+    }
+    *result = bytecode_run(bytecode, bytecode->registers);
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+double bytecode_run(const bytecode_t *bytecode, double *registers) {
+    return bytecode_run_scalar(bytecode, registers);
+}
+
+/*=========================================================================================================*/
+
+//Registers are variables (first MaxVarsNumber), then constants, then results of instructions in order.
+//Each instruction jumps straight to the next one, so there is no loop, bound or error check.
+template <typename Scalar>
+Scalar bytecode_run_scalar(const bytecode_t *bytecode, Scalar *registers) {
+    static const void *const Handlers[] = {
+        &&handle_return, &&handle_add   , &&handle_sub   , &&handle_div   , &&handle_mul   ,
+        &&handle_sin   , &&handle_cos   , &&handle_pow   , &&handle_ln    , &&handle_log   ,
+        &&handle_tg    , &&handle_ctg   , &&handle_arcsin, &&handle_arccos, &&handle_arctg ,
+        &&handle_arcctg, &&handle_sh    , &&handle_ch    , &&handle_th    , &&handle_cth   ,
+        &&handle_square, &&handle_cube  , &&handle_reciprocal, &&handle_power_int,
+    };
+    static_assert(sizeof(Handlers) / sizeof(Handlers[0]) == BYTECODE_POWER_INT + 1);
+
+    const bytecode_instruction_t *instruction = bytecode->code;
+    Scalar                       *target      = registers + bytecode->temporaries_start;
+
+    #define _LEFT  registers[instruction->left ]
+    #define _RIGHT registers[instruction->right]
+    #define _WRITE_AND_DISPATCH(...) {                \
+        *target++ = (__VA_ARGS__);                    \
+        instruction++;                                \
+        goto *Handlers[instruction->opcode];          \
+    }
+    #define _KERNEL(operation) _WRITE_AND_DISPATCH(run_scalar_kernel<operation>(_LEFT, _RIGHT))
+
+    goto *Handlers[instruction->opcode];
+    handle_add:         _KERNEL(OPERATION_ADD   );
+    handle_sub:         _KERNEL(OPERATION_SUB   );
+    handle_div:         _KERNEL(OPERATION_DIV   );
+    handle_mul:         _KERNEL(OPERATION_MUL   );
+    handle_sin:         _KERNEL(OPERATION_SIN   );
+    handle_cos:         _KERNEL(OPERATION_COS   );
+    handle_pow:         _KERNEL(OPERATION_POW   );
+    handle_ln:          _KERNEL(OPERATION_LN    );
+    handle_log:         _KERNEL(OPERATION_LOG   );
+    handle_tg:          _KERNEL(OPERATION_TG    );
+    handle_ctg:         _KERNEL(OPERATION_CTG   );
+    handle_arcsin:      _KERNEL(OPERATION_ARCSIN);
+    handle_arccos:      _KERNEL(OPERATION_ARCCOS);
+    handle_arctg:       _KERNEL(OPERATION_ARCTG );
+    handle_arcctg:      _KERNEL(OPERATION_ARCCTG);
+    handle_sh:          _KERNEL(OPERATION_SH    );
+    handle_ch:          _KERNEL(OPERATION_CH    );
+    handle_th:          _KERNEL(OPERATION_TH    );
+    handle_cth:         _KERNEL(OPERATION_CTH   );
+    handle_square:      _WRITE_AND_DISPATCH(run_scalar_integer_power(_LEFT, 2)  );
+    handle_cube:        _WRITE_AND_DISPATCH(run_scalar_integer_power(_LEFT, 3)  );
+    handle_reciprocal:  _WRITE_AND_DISPATCH(run_scalar_integer_power(_LEFT, -1) );
+    handle_power_int:   _WRITE_AND_DISPATCH(bytecode_power_int(_LEFT, (int32_t)instruction->right));
+    handle_return:
+    return registers[bytecode->result];
+
+    #undef _LEFT
+    #undef _RIGHT
+    #undef _WRITE_AND_DISPATCH
+    #undef _KERNEL
+}
+
+/*=========================================================================================================*/
+
+//Exponent is known only at run time, inlined loop makes every handler of the interpreter slower
+template <typename Scalar>
+__attribute__((noinline))
+Scalar bytecode_power_int(Scalar base, long power) {
+    return run_scalar_integer_power(base, power);
+}
+
+/*=========================================================================================================*/
+
+//Registers of other scalar type get the same constants, variables are set by caller
+template <typename Scalar>
+void bytecode_load_constants(const bytecode_t *bytecode, Scalar *registers) {
+    for(size_t index = MaxVarsNumber; index < bytecode->temporaries_start; index++) {
+        registers[index] = scalar_constant<Scalar>(bytecode->registers[index]);
+    }
+}
+
+/*=========================================================================================================*/
+
+#define _INSTANTIATE_SCALAR(Scalar)                                                         \
+    template Scalar bytecode_run_scalar     (const bytecode_t *bytecode, Scalar *registers); \
+    template void   bytecode_load_constants (const bytecode_t *bytecode, Scalar *registers);
+
+_INSTANTIATE_SCALAR(float      )
+_INSTANTIATE_SCALAR(double     )
+_INSTANTIATE_SCALAR(long double)
+_INSTANTIATE_SCALAR(dual_t     )
+_INSTANTIATE_SCALAR(interval_t )
+
+#undef _INSTANTIATE_SCALAR
+
+/*=========================================================================================================*/
+
+expression_error_t bytecode_dtor(bytecode_t *bytecode) {
+    _C_ASSERT(bytecode != NULL, return EXPRESSION_NULL_POINTER);
+
+    free(bytecode->code);
+    free(bytecode->registers);
+    if(memset(bytecode, 0, sizeof(*bytecode)) != bytecode) {
+        return EXPRESSION_MEMSET_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t bytecode_lower(bytecode_t *bytecode, cse_program_t *program) {
+    _C_ASSERT(bytecode != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(program  != NULL, return EXPRESSION_NULL_POINTER);
+
+    size_t constants_number  = 0;
+    size_t operations_number = 0;
+    for(size_t index = 0; index < program->size; index++) {
+        if(program->temporaries[index].node->type == NODE_TYPE_NUM) {
+            constants_number++;
+        }
+        else if(program->temporaries[index].node->type == NODE_TYPE_OP) {
+            operations_number++;
+        }
+    }
+
+    bytecode->temporaries_start = MaxVarsNumber + constants_number;
+    bytecode->registers_size    = bytecode->temporaries_start + operations_number;
+    bytecode->code_size         = operations_number + 1;
+    bytecode->registers         = (double                 *)calloc(bytecode->registers_size, sizeof(bytecode->registers[0]));
+    bytecode->code              = (bytecode_instruction_t *)calloc(bytecode->code_size,      sizeof(bytecode->code[0]     ));
+    size_t *slots               = (size_t                 *)calloc(program->size,            sizeof(slots[0]              ));
+    if(bytecode->registers == NULL || bytecode->code == NULL || slots == NULL) {
+        free(slots);
+        print_error("Error while allocating bytecode.\n");
+        return EXPRESSION_BYTECODE_ALLOCATION_ERROR;
+    }
+
+    //Temporaries are in post-order, so operands already have registers when instruction is written
+    size_t constant    = MaxVarsNumber;
+    size_t instruction = 0;
+    for(size_t index = 0; index < program->size; index++) {
+        cse_temporary_t *temporary = program->temporaries + index;
+        switch(temporary->node->type) {
+            case NODE_TYPE_NUM: {
+                bytecode->registers[constant] = temporary->node->value.numeric_value;
+                slots[index] = constant++;
+                break;
+            }
+            case NODE_TYPE_VAR: {
+                slots[index] = temporary->node->value.variable_index;
+                bytecode->variables_mask |= (size_t)1 << slots[index];
+                break;
+            }
+            case NODE_TYPE_OP: {
+                bytecode_instruction_t *current = bytecode->code + instruction;
+                current->opcode = (uint32_t)temporary->node->value.operation;
+                current->left   = temporary->left == CseNoOperand ? 0 : (uint32_t)slots[temporary->left];
+                current->right  = (uint32_t)slots[temporary->right];
+                bytecode_specialize(program, temporary, current);
+                slots[index] = bytecode->temporaries_start + instruction++;
+                break;
+            }
+            default: {
+                free(slots);
+                return EXPRESSION_UNKNOWN_NODE_TYPE;
+            }
+        }
+    }
+    bytecode->code[instruction] = {.opcode = BYTECODE_RETURN, .left = 0, .right = 0};
+    bytecode->result            = slots[program->result];
+    free(slots);
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+void bytecode_specialize(cse_program_t          *program,
+                         cse_temporary_t        *temporary,
+                         bytecode_instruction_t *instruction) {
+    if(instruction->opcode == BYTECODE_MUL && temporary->left == temporary->right) {
+        instruction->opcode = BYTECODE_SQUARE;
+        return;
+    }
+    if(instruction->opcode != BYTECODE_POW) {
+        return;
+    }
+    expression_node_t *exponent = program->temporaries[temporary->right].node;
+    if(exponent->type != NODE_TYPE_NUM || !is_integer(exponent->value.numeric_value) ||
+       fabs(exponent->value.numeric_value) > (double)MaxIntegerPower) {
+        return;
+    }
+    long power = (long)exponent->value.numeric_value;
+    switch(power) {
+        case 2: {
+            instruction->opcode = BYTECODE_SQUARE;
+            break;
+        }
+        case 3: {
+            instruction->opcode = BYTECODE_CUBE;
+            break;
+        }
+        case -1: {
+            instruction->opcode = BYTECODE_RECIPROCAL;
+            break;
+        }
+        default: {
+            //Exponent is stored in place of its register
+            instruction->opcode = BYTECODE_POWER_INT;
+            instruction->right  = (uint32_t)(int32_t)power;
+            break;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include "expression_cost.h"
+#include "expression_types.h"
+#include "matan_killer.h"
+#include "expression_utils.h"
+#include "utils.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static const size_t OperationsNumber = sizeof(SupportedOperations) / sizeof(SupportedOperations[0]);
+
+/*=========================================================================================================*/
+
+static bool               integer_power_cost       (expression_node_t *node,
+                                                    expression_cost_t *cost);
+
+/*=========================================================================================================*/
+
+expression_error_t expression_estimate_cost(expression_t      *expression,
+                                            expression_cost_t *cost) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(cost       != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    *cost = subtree_estimate_cost(expression->root);
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_cost_t subtree_estimate_cost(expression_node_t *node) {
+    if(node == NULL) {
+        return {};
+    }
+
+    expression_cost_t left  = subtree_estimate_cost(node->left );
+    expression_cost_t right = subtree_estimate_cost(node->right);
+    expression_cost_t cost  = {.nodes   = left.nodes + right.nodes + 1,
+                               .flops   = left.flops + right.flops,
+                               .latency = left.latency > right.latency ? left.latency : right.latency};
+    //Operands do not depend on each other, so only the slowest one is on the critical path
+    if(integer_power_cost(node, &cost)) {
+        return cost;
+    }
+    if(node->type == NODE_TYPE_OP && (size_t)node->value.operation < OperationsNumber) {
+        cost.flops   += SupportedOperations[node->value.operation].flops;
+        cost.latency += SupportedOperations[node->value.operation].latency;
+    }
+    return cost;
+}
+
+/*=========================================================================================================*/
+
+double operation_flops(operation_t operation) {
+    if((size_t)operation >= OperationsNumber) {
+        return 0;
+    }
+    return SupportedOperations[operation].flops;
+}
+
+/*=========================================================================================================*/
+
+bool is_square_power_cheaper(expression_node_t *base) {
+    //u * u evaluates u twice, while u ^ 2 evaluates it once and multiplies the result by itself
+    return subtree_estimate_cost(base).flops > 0;
+}
+
+/*=========================================================================================================*/
+
+//Small integer powers are evaluated as multiplication chains in run_scalar_integer_power and bytecode,
+//so they cost multiplications and not the power function
+bool integer_power_cost(expression_node_t *node, expression_cost_t *cost) {
+    if(node->type != NODE_TYPE_OP || node->value.operation != OPERATION_POW ||
+       node->right == NULL || node->right->type != NODE_TYPE_NUM) {
+        return false;
+    }
+    double exponent = node->right->value.numeric_value;
+    if(!is_integer(exponent) || fabs(exponent) > (double)MaxIntegerPower) {
+        return false;
+    }
+
+    //Same chains as in run_scalar_integer_power: small exponents are written out, others are squarings
+    long   power           = (long)exponent;
+    double multiplications = 0;
+    if(power == -2 || power == -1 || power == 2 || power == 3) {
+        multiplications = (double)(labs(power) - 1);
+    }
+    else {
+        //Every bit squares the base, every set bit multiplies the result
+        for(unsigned long rest = (unsigned long)labs(power); rest != 0; rest >>= 1) {
+            multiplications += (double)(1 + (rest & 1));
+        }
+    }
+    cost->flops   += multiplications * SupportedOperations[OPERATION_MUL].flops;
+    cost->latency += multiplications * SupportedOperations[OPERATION_MUL].latency;
+    if(power < 0) {
+        cost->flops   += SupportedOperations[OPERATION_DIV].flops;
+        cost->latency += SupportedOperations[OPERATION_DIV].latency;
+    }
+    return true;
+}
@@ -0,0 +1,243 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "expression_cse.h"
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "variable_list.h"
+#include "colors.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static const size_t MinCommonSubtreeSize = 5;
+
+/*=========================================================================================================*/
+
+static size_t             cse_count_nodes  (expression_node_t *node);
+
+static expression_error_t cse_program_add  (cse_program_t     *program,
+                                            expression_node_t *node,
+                                            size_t            *index);
+
+static expression_error_t cse_mark_node    (cse_program_t     *program,
+                                            expression_node_t *node,
+                                            latex_log_info_t  *log_info,
+                                            size_t            *position);
+
+static bool               cse_is_same_node (expression_node_t *first,
+                                            expression_node_t *second);
+
+/*=========================================================================================================*/
+
+expression_error_t cse_program_ctor(cse_program_t *program, expression_node_t *root) {
+    _C_ASSERT(program != NULL, return EXPRESSION_NULL_POINTER     );
+    _C_ASSERT(root    != NULL, return EXPRESSION_NODE_NULL_POINTER);
+
+    size_t nodes_number = cse_count_nodes(root);
+    program->table_capacity = 1;
+    while(program->table_capacity < 2 * nodes_number) {
+        program->table_capacity *= 2;
+    }
+    program->temporaries = (cse_temporary_t *)calloc(nodes_number,            sizeof(program->temporaries[0]));
+    program->table       = (size_t          *)calloc(program->table_capacity, sizeof(program->table[0]      ));
+    program->occurrences = (size_t          *)calloc(nodes_number,            sizeof(program->occurrences[0]));
+    program->values      = (double          *)calloc(nodes_number,            sizeof(program->values[0]     ));
+    if(program->temporaries == NULL || program->table  == NULL ||
+       program->occurrences == NULL || program->values == NULL) {
+        cse_program_dtor(program);
+        print_error("Error while allocating common subexpressions program.\n");
+        return EXPRESSION_CSE_ALLOCATION_ERROR;
+    }
+
+    _RETURN_IF_ERROR(cse_program_add(program, root, &program->result));
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t cse_program_evaluate(cse_program_t    *program,
+                                        variables_list_t *variables_list,
+                                        double           *result) {
+    _C_ASSERT(program        != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(variables_list != NULL, return EXPRESSION_VARIABLES_LIST_NULL);
+    _C_ASSERT(result         != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    //Temporaries are stored in post-order, so operands are always evaluated before their users
+    for(size_t index = 0; index < program->size; index++) {
+        cse_temporary_t *temporary = program->temporaries + index;
+        switch(temporary->node->type) {
+            case NODE_TYPE_NUM: {
+                program->values[index] = temporary->node->value.numeric_value;
+                break;
+            }
+            case NODE_TYPE_VAR: {
+                _RETURN_IF_ERROR(variables_list_get_value(variables_list,
+                                                          temporary->node->value.variable_index,
+                                                          program->values + index));
+                break;
+            }
+            case NODE_TYPE_OP: {
+                double left = temporary->left == CseNoOperand ? 0 : program->values[temporary->left];
+                program->values[index] = run_operation(left,
+                                                       program->values[temporary->right],
+                                                       temporary->node->value.operation);
+                break;
+            }
+            default: {
+                return EXPRESSION_UNKNOWN_NODE_TYPE;
+            }
+        }
+    }
+    *result = program->values[program->result];
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t cse_program_mark_substitutions(cse_program_t     *program,
+                                                  expression_node_t *root,
+                                                  latex_log_info_t  *log_info) {
+    _C_ASSERT(program  != NULL, return EXPRESSION_NULL_POINTER         );
+    _C_ASSERT(root     != NULL, return EXPRESSION_NODE_NULL_POINTER    );
+    _C_ASSERT(log_info != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
+
+    size_t position = 0;
+    _RETURN_IF_ERROR(cse_mark_node(program, root, log_info, &position));
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t cse_program_dtor(cse_program_t *program) {
+    _C_ASSERT(program != NULL, return EXPRESSION_NULL_POINTER);
+
+    free(program->temporaries);
+    free(program->table);
+    free(program->occurrences);
+    free(program->values);
+    if(memset(program, 0, sizeof(*program)) != program) {
+        return EXPRESSION_MEMSET_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+size_t cse_count_nodes(expression_node_t *node) {
+    if(node == NULL) {
+        return 0;
+    }
+    return 1 + cse_count_nodes(node->left) + cse_count_nodes(node->right);
+}
+
+/*=========================================================================================================*/
+
+expression_error_t cse_program_add(cse_program_t     *program,
+                                   expression_node_t *node,
+                                   size_t            *index) {
+    _C_ASSERT(program != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(node    != NULL, return EXPRESSION_NODE_NULL_POINTER  );
+    _C_ASSERT(index   != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    size_t left  = CseNoOperand;
+    size_t right = CseNoOperand;
+    if(node->left != NULL) {
+        _RETURN_IF_ERROR(cse_program_add(program, node->left , &left ));
+    }
+    if(node->right != NULL) {
+        _RETURN_IF_ERROR(cse_program_add(program, node->right, &right));
+    }
+
+    //Operands are already replaced with their temporaries, so node is compared without walking subtrees
+    size_t mask = program->table_capacity - 1;
+    size_t slot = node->hash & mask;
+    while(program->table[slot] != 0) {
+        cse_temporary_t *temporary = program->temporaries + program->table[slot] - 1;
+        if(temporary->left == left && temporary->right == right && cse_is_same_node(temporary->node, node)) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    if(program->table[slot] == 0) {
+        size_t tree_size = 1;
+        if(left != CseNoOperand) {
+            tree_size += program->temporaries[left].tree_size;
+        }
+        if(right != CseNoOperand) {
+            tree_size += program->temporaries[right].tree_size;
+        }
+        program->temporaries[program->size] = {node, left, right, 0, tree_size};
+        program->table[slot] = ++program->size;
+    }
+
+    *index = program->table[slot] - 1;
+    program->temporaries[*index].uses++;
+    program->occurrences[program->occurrences_number++] = *index;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t cse_mark_node(cse_program_t     *program,
+                                 expression_node_t *node,
+                                 latex_log_info_t  *log_info,
+                                 size_t            *position) {
+    _C_ASSERT(program  != NULL, return EXPRESSION_NULL_POINTER         );
+    _C_ASSERT(node     != NULL, return EXPRESSION_NODE_NULL_POINTER    );
+    _C_ASSERT(log_info != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
+    _C_ASSERT(position != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
+
+    if(node->left != NULL) {
+        _RETURN_IF_ERROR(cse_mark_node(program, node->left , log_info, position));
+    }
+    if(node->right != NULL) {
+        _RETURN_IF_ERROR(cse_mark_node(program, node->right, log_info, position));
+    }
+    //Tree was changed after program was built
+    if(*position >= program->occurrences_number) {
+        return EXPRESSION_NODE_NOT_FOUND;
+    }
+
+    cse_temporary_t *temporary = program->temporaries + program->occurrences[(*position)++];
+    if(node->type != NODE_TYPE_OP || temporary->uses < 2 || temporary->tree_size < MinCommonSubtreeSize) {
+        return EXPRESSION_SUCCESS;
+    }
+
+    //First occurrence is met first in post-order, it gives the name to all other copies
+    expression_node_t *first = temporary->node;
+    if(!first->is_substitution) {
+        first->is_substitution = true;
+        sprintf(first->substitution_name, "I_{%lu}", log_info->substitutions_number++);
+    }
+    if(node != first) {
+        node->is_substitution = true;
+        strcpy(node->substitution_name, first->substitution_name);
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+bool cse_is_same_node(expression_node_t *first, expression_node_t *second) {
+    if(first->type != second->type) {
+        return false;
+    }
+    switch(first->type) {
+        case NODE_TYPE_NUM: {
+            return memcmp(&first->value.numeric_value,
+                          &second->value.numeric_value,
+                          sizeof(first->value.numeric_value)) == 0;
+        }
+        case NODE_TYPE_VAR: {
+            return first->value.variable_index == second->value.variable_index;
+        }
+        case NODE_TYPE_OP: {
+            return first->value.operation == second->value.operation;
+        }
+        default: {
+            return false;
+        }
+    }
+}
@@ -0,0 +1,942 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "expression_egraph.h"
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "expression_budget.h"
+#include "expression_cost.h"
+#include "expression_builders.h"
+#include "expression_scalar.h"
+#include "operation_rules.h"
+#include "string_parser.h"
+#include "variable_list.h"
+#include "diff_dump.h"
+#include "colors.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static const size_t EgraphNoClass          = (size_t)-1;
+static const size_t EgraphMaxPatternSize   = 32;
+static const size_t EgraphMinCapacity      = 64;
+static const size_t EgraphMaxRuleLength    = 64;
+//Clock is read once per this number of search steps, reading it on every step is slower than matching
+static const size_t EgraphClockPeriod      = 1024;
+//Extracted tree is evaluated at these points and compared with input, variable i is shifted by i * step
+static const double EgraphCheckPoints[]    = {0.3, 0.7, 1.9};
+static const double EgraphCheckStep        = 0.13;
+static const double EgraphCheckPrecision   = 1e-6;
+
+//Rules are written in the same syntax as user input, every letter is a pattern variable
+static const char *EgraphRules[][2] = {
+    {"a+b"              , "b+a"        },
+    {"a*b"              , "b*a"        },
+    {"(a+b)+c"          , "a+(b+c)"    },
+    {"(a*b)*c"          , "a*(b*c)"    },
+    {"(a+b)-c"          , "a+(b-c)"    },
+    {"(a-b)+b"          , "a"          },
+    {"(a+b)-b"          , "a"          },
+    {"a-a"              , "0"          },
+    {"a/a"              , "1"          },
+    {"a+a"              , "2*a"        },
+    {"a*a"              , "a^2"        },
+    {"a*a^b"            , "a^(b+1)"    },
+    {"a^b*a^c"          , "a^(b+c)"    },
+    {"a*b+a*c"          , "a*(b+c)"    },
+    {"a*b-a*c"          , "a*(b-c)"    },
+    {"a+a*b"            , "a*(1+b)"    },
+    {"a*(b/c)"          , "(a*b)/c"    },
+    {"(a*b)/c"          , "a*(b/c)"    },
+    {"(a/b)/c"          , "a/(b*c)"    },
+    {"sin(a)^2+cos(a)^2", "1"          },
+    {"ch(a)^2-sh(a)^2"  , "1"          },
+};
+static const size_t EgraphRulesNumber = sizeof(EgraphRules) / sizeof(EgraphRules[0]);
+
+/*=========================================================================================================*/
+
+struct egraph_pending_t {
+    expression_node_t *pattern;
+    size_t             eclass;
+};
+
+/*=========================================================================================================*/
+
+static expression_error_t egraph_ctor          (egraph_t              *egraph);
+
+static expression_error_t egraph_dtor          (egraph_t              *egraph);
+
+static expression_error_t egraph_run           (egraph_t              *egraph,
+                                                expression_t          *expression,
+                                                egraph_cost_t          cost,
+                                                const egraph_limits_t *limits);
+
+static expression_error_t egraph_add_tree      (egraph_t              *egraph,
+                                                expression_node_t     *node,
+                                                size_t                *eclass);
+
+static expression_error_t egraph_add           (egraph_t              *egraph,
+                                                node_type_t            type,
+                                                node_value_t           value,
+                                                size_t                 left,
+                                                size_t                 right,
+                                                size_t                *eclass);
+
+static expression_error_t egraph_add_constant  (egraph_t              *egraph,
+                                                double                 value,
+                                                size_t                *eclass);
+
+static size_t             egraph_find          (egraph_t              *egraph,
+                                                size_t                 eclass);
+
+static bool               egraph_union         (egraph_t              *egraph,
+                                                size_t                 first,
+                                                size_t                 second);
+
+static expression_error_t egraph_rebuild       (egraph_t              *egraph);
+
+static expression_error_t egraph_fold_node     (egraph_t              *egraph,
+                                                size_t                 index,
+                                                bool                  *is_changed);
+
+static expression_error_t egraph_index         (egraph_t              *egraph);
+
+static expression_error_t egraph_search        (egraph_t              *egraph,
+                                                size_t                 iteration);
+
+static expression_error_t egraph_match         (egraph_t              *egraph,
+                                                egraph_pending_t      *pending,
+                                                size_t                 depth,
+                                                size_t                *bindings,
+                                                size_t                 rule,
+                                                size_t                 eclass);
+
+static expression_error_t egraph_instantiate   (egraph_t              *egraph,
+                                                expression_node_t     *pattern,
+                                                size_t                *bindings,
+                                                size_t                *eclass);
+
+static void               egraph_extract       (egraph_t              *egraph,
+                                                egraph_cost_t          cost);
+
+static expression_node_t *egraph_build         (egraph_t              *egraph,
+                                                expression_t          *expression,
+                                                size_t                 eclass);
+
+static expression_error_t egraph_table_insert  (egraph_t              *egraph,
+                                                size_t                 index,
+                                                size_t                *found);
+
+static expression_error_t egraph_table_resize  (egraph_t              *egraph);
+
+static size_t             egraph_hash          (egraph_node_t         *node);
+
+static bool               egraph_is_same_node  (egraph_node_t         *first,
+                                                egraph_node_t         *second);
+
+static bool               egraph_is_same_const (double                 first,
+                                                double                 second);
+
+static bool               egraph_is_same_value (expression_node_t     *input,
+                                                expression_node_t     *result);
+
+static bool               egraph_is_timeout    (egraph_t              *egraph);
+
+static double             egraph_seconds       (void);
+
+/*=========================================================================================================*/
+
+expression_error_t expression_saturate(expression_t          *expression,
+                                       egraph_cost_t          cost,
+                                       const egraph_limits_t *limits,
+                                       latex_log_info_t      *log_info) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(cost       != NULL, return EXPRESSION_NULL_POINTER);
+
+    if(expression->root == NULL) {
+        return EXPRESSION_SUCCESS;
+    }
+    if(limits == NULL) {
+        limits = &EgraphDefaultLimits;
+    }
+
+    _LATEX_LOG_WRITE(log_info, SIMPLIFICATION_SATURATE, expression->root);
+    egraph_t egraph = {};
+    expression_error_t error_code = egraph_ctor(&egraph);
+    if(error_code == EXPRESSION_SUCCESS) {
+        error_code = egraph_run(&egraph, expression, cost, limits);
+    }
+    _RETURN_IF_ERROR(egraph_dtor(&egraph));
+    _RETURN_IF_ERROR(error_code);
+    _LATEX_LOG_WRITE(log_info, DIFF_RESULT, expression->root);
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+double egraph_cost_nodes(egraph_node_t */*node*/) {
+    return 1;
+}
+
+/*=========================================================================================================*/
+
+double egraph_cost_flops(egraph_node_t *node) {
+    _C_ASSERT(node != NULL, return 0);
+
+    if(node->type != NODE_TYPE_OP) {
+        return 0;
+    }
+    return operation_flops(node->value.operation);
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_ctor(egraph_t *egraph) {
+    _C_ASSERT(egraph != NULL, return EXPRESSION_NULL_POINTER);
+
+    egraph->nodes_capacity   = EgraphMinCapacity;
+    egraph->classes_capacity = EgraphMinCapacity;
+    egraph->table_capacity   = 2 * EgraphMinCapacity;
+    egraph->nodes   = (egraph_node_t  *)calloc(egraph->nodes_capacity  , sizeof(egraph->nodes[0]  ));
+    egraph->classes = (egraph_class_t *)calloc(egraph->classes_capacity, sizeof(egraph->classes[0]));
+    egraph->table   = (size_t         *)calloc(egraph->table_capacity  , sizeof(egraph->table[0]  ));
+    egraph->rules   = (egraph_rule_t  *)calloc(EgraphRulesNumber       , sizeof(egraph->rules[0]  ));
+    if(egraph->nodes == NULL || egraph->classes == NULL || egraph->table == NULL || egraph->rules == NULL) {
+        print_error("Error while allocating e-graph.\n");
+        return EXPRESSION_EGRAPH_ALLOCATION_ERROR;
+    }
+
+    //Patterns of all rules share one nodes storage, which lives as long as e-graph
+    expression_t rules_expression = {};
+    _RETURN_IF_ERROR(nodes_storage_ctor(&rules_expression.nodes_storage));
+    egraph->rules_storage = rules_expression.nodes_storage;
+    for(size_t rule = 0; rule < EgraphRulesNumber; rule++) {
+        egraph_rule_t *egraph_rule = egraph->rules + rule;
+        _RETURN_IF_ERROR(variables_list_ctor(&egraph_rule->variables));
+        rules_expression.variables_list = &egraph_rule->variables;
+        for(size_t side = 0; side < 2; side++) {
+            char rule_string[EgraphMaxRuleLength] = {};
+            strncpy(rule_string, EgraphRules[rule][side], EgraphMaxRuleLength - 1);
+            parser_info_t parser_info = {.input = rule_string, .position = 0};
+            expression_error_t error_code = read_expression(&rules_expression, &parser_info);
+            egraph->rules_storage = rules_expression.nodes_storage;
+            _RETURN_IF_ERROR(error_code);
+            if(side == 0) {
+                egraph_rule->pattern = rules_expression.root;
+            }
+            else {
+                egraph_rule->result = rules_expression.root;
+            }
+        }
+        egraph->rules_number++;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_dtor(egraph_t *egraph) {
+    _C_ASSERT(egraph != NULL, return EXPRESSION_NULL_POINTER);
+
+    _RETURN_IF_ERROR(nodes_storage_dtor(&egraph->rules_storage));
+    free(egraph->nodes);
+    free(egraph->classes);
+    free(egraph->table);
+    free(egraph->class_start);
+    free(egraph->class_nodes);
+    free(egraph->matches);
+    free(egraph->rules);
+    if(memset(egraph, 0, sizeof(*egraph)) != egraph) {
+        return EXPRESSION_MEMSET_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_run(egraph_t              *egraph,
+                              expression_t          *expression,
+                              egraph_cost_t          cost,
+                              const egraph_limits_t *limits) {
+    _C_ASSERT(egraph     != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(limits     != NULL, return EXPRESSION_NULL_POINTER);
+
+    egraph->limits   = *limits;
+    egraph->deadline = egraph_seconds() + limits->max_seconds;
+    size_t root = 0;
+    _RETURN_IF_ERROR(egraph_add_tree(egraph, expression->root, &root));
+    _RETURN_IF_ERROR(egraph_rebuild(egraph));
+
+    //Time and matches are checked inside search, so one iteration can not run far over the limits
+    for(size_t iteration = 0; iteration < limits->max_iterations; iteration++) {
+        size_t nodes_size   = egraph->nodes_size;
+        size_t classes_size = egraph->classes_size;
+        _RETURN_IF_ERROR(egraph_index(egraph));
+        _RETURN_IF_ERROR(egraph_search(egraph, iteration));
+
+        bool is_changed = false;
+        for(size_t index = 0; index < egraph->matches_size && egraph->nodes_size < limits->max_nodes; index++) {
+            if(egraph_is_timeout(egraph)) {
+                break;
+            }
+            egraph_match_t *match  = egraph->matches + index;
+            size_t          result = 0;
+            _RETURN_IF_ERROR(egraph_instantiate(egraph, egraph->rules[match->rule].result, match->bindings, &result));
+            is_changed = egraph_union(egraph, match->eclass, result) || is_changed;
+        }
+        _RETURN_IF_ERROR(egraph_rebuild(egraph));
+
+        //Saturation: no rule adds anything new to e-graph and no rule waits for the end of its ban
+        if(!is_changed && nodes_size == egraph->nodes_size && classes_size == egraph->classes_size &&
+           egraph->banned_rules == 0) {
+            break;
+        }
+        //Stopped search means that time or matches are over, cheapest tree found so far is extracted
+        if(egraph->is_search_stopped || egraph->nodes_size >= limits->max_nodes || egraph_seconds() > egraph->deadline) {
+            break;
+        }
+        if(expression_budget_check(expression->budget, expression->nodes_storage.size) != EXPRESSION_SUCCESS) {
+            break;
+        }
+    }
+
+    egraph_extract(egraph, cost);
+    expression_node_t *result = egraph_build(egraph, expression, egraph_find(egraph, root));
+    if(result == NULL) {
+        return EXPRESSION_EGRAPH_ALLOCATION_ERROR;
+    }
+    //Wrong rule or fold must not change the value silently, input is kept then
+    if(!egraph_is_same_value(expression->root, result)) {
+        print_error("E-graph result differs from input in value, input is kept.\n");
+        _RETURN_IF_ERROR(expression_delete_subtree(expression, result));
+        return expression_budget_check(expression->budget, expression->nodes_storage.size);
+    }
+    _RETURN_IF_ERROR(expression_delete_subtree(expression, expression->root));
+    expression->root = result;
+    //Cheapest tree found before budget was over is still written to expression
+    return expression_budget_check(expression->budget, expression->nodes_storage.size);
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_add_tree(egraph_t          *egraph,
+                                   expression_node_t *node,
+                                   size_t            *eclass) {
+    _C_ASSERT(egraph != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(node   != NULL, return EXPRESSION_NODE_NULL_POINTER  );
+    _C_ASSERT(eclass != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    size_t left  = EgraphNoClass;
+    size_t right = EgraphNoClass;
+    if(node->left != NULL) {
+        _RETURN_IF_ERROR(egraph_add_tree(egraph, node->left , &left ));
+    }
+    if(node->right != NULL) {
+        _RETURN_IF_ERROR(egraph_add_tree(egraph, node->right, &right));
+    }
+    return egraph_add(egraph, node->type, node->value, left, right, eclass);
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_add(egraph_t     *egraph,
+                              node_type_t   type,
+                              node_value_t  value,
+                              size_t        left,
+                              size_t        right,
+                              size_t       *eclass) {
+    _C_ASSERT(egraph != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(eclass != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    if(egraph->nodes_size == egraph->nodes_capacity) {
+        egraph_node_t *new_nodes = (egraph_node_t *)realloc(egraph->nodes,
+                                                            2 * egraph->nodes_capacity * sizeof(egraph->nodes[0]));
+        if(new_nodes == NULL) {
+            print_error("Error while reallocating e-graph nodes.\n");
+            return EXPRESSION_EGRAPH_ALLOCATION_ERROR;
+        }
+        egraph->nodes           = new_nodes;
+        egraph->nodes_capacity *= 2;
+    }
+    if(egraph->classes_size == egraph->classes_capacity) {
+        egraph_class_t *new_classes = (egraph_class_t *)realloc(egraph->classes,
+                                                                2 * egraph->classes_capacity * sizeof(egraph->classes[0]));
+        if(new_classes == NULL) {
+            print_error("Error while reallocating e-graph classes.\n");
+            return EXPRESSION_EGRAPH_ALLOCATION_ERROR;
+        }
+        egraph->classes           = new_classes;
+        egraph->classes_capacity *= 2;
+    }
+    if(2 * (egraph->nodes_size + 1) > egraph->table_capacity) {
+        _RETURN_IF_ERROR(egraph_table_resize(egraph));
+    }
+
+    //Node is written after the last one and becomes real only if there is no equal node in e-graph
+    egraph_node_t *node = egraph->nodes + egraph->nodes_size;
+    *node = {.type         = type,
+             .value        = value,
+             .left         = left  == EgraphNoClass ? left  : egraph_find(egraph, left ),
+             .right        = right == EgraphNoClass ? right : egraph_find(egraph, right),
+             .eclass       = egraph->classes_size,
+             .is_duplicate = false};
+    size_t found = EgraphNoClass;
+    _RETURN_IF_ERROR(egraph_table_insert(egraph, egraph->nodes_size, &found));
+    if(found != EgraphNoClass) {
+        *eclass = egraph_find(egraph, egraph->nodes[found].eclass);
+        return EXPRESSION_SUCCESS;
+    }
+
+    *eclass = egraph->classes_size;
+    egraph->classes[egraph->classes_size++] = {.parent      = *eclass,
+                                               .is_constant = type == NODE_TYPE_NUM,
+                                               .constant    = type == NODE_TYPE_NUM ? value.numeric_value : 0,
+                                               .cost        = INFINITY,
+                                               .best        = egraph->nodes_size};
+    egraph->nodes_size++;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_add_constant(egraph_t *egraph, double value, size_t *eclass) {
+    return egraph_add(egraph, NODE_TYPE_NUM, {.numeric_value = value}, EgraphNoClass, EgraphNoClass, eclass);
+}
+
+/*=========================================================================================================*/
+
+size_t egraph_find(egraph_t *egraph, size_t eclass) {
+    while(egraph->classes[eclass].parent != eclass) {
+        egraph->classes[eclass].parent = egraph->classes[egraph->classes[eclass].parent].parent;
+        eclass = egraph->classes[eclass].parent;
+    }
+    return eclass;
+}
+
+/*=========================================================================================================*/
+
+bool egraph_union(egraph_t *egraph, size_t first, size_t second) {
+    first  = egraph_find(egraph, first );
+    second = egraph_find(egraph, second);
+    if(first == second) {
+        return false;
+    }
+    //Constants which differ only by rounding in different chains of rules are not equal
+    if(egraph->classes[first].is_constant && egraph->classes[second].is_constant &&
+       !egraph_is_same_const(egraph->classes[first].constant, egraph->classes[second].constant)) {
+        return false;
+    }
+    if(second < first) {
+        size_t temporary = first;
+        first  = second;
+        second = temporary;
+    }
+    egraph->classes[second].parent = first;
+    if(!egraph->classes[first].is_constant && egraph->classes[second].is_constant) {
+        egraph->classes[first].is_constant = true;
+        egraph->classes[first].constant    = egraph->classes[second].constant;
+    }
+    return true;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_rebuild(egraph_t *egraph) {
+    _C_ASSERT(egraph != NULL, return EXPRESSION_NULL_POINTER);
+
+    //Congruence closure: nodes equal after canonization of operands are merged until nothing changes
+    bool is_changed = true;
+    while(is_changed) {
+        is_changed = false;
+        memset(egraph->table, 0, egraph->table_capacity * sizeof(egraph->table[0]));
+        for(size_t index = 0; index < egraph->nodes_size; index++) {
+            egraph_node_t *node = egraph->nodes + index;
+            if(node->left != EgraphNoClass) {
+                node->left = egraph_find(egraph, node->left);
+            }
+            if(node->right != EgraphNoClass) {
+                node->right = egraph_find(egraph, node->right);
+            }
+            size_t found = EgraphNoClass;
+            _RETURN_IF_ERROR(egraph_table_insert(egraph, index, &found));
+            node->is_duplicate = found != EgraphNoClass;
+            if(found != EgraphNoClass) {
+                is_changed = egraph_union(egraph, egraph->nodes[found].eclass, node->eclass) || is_changed;
+            }
+        }
+        for(size_t index = 0; index < egraph->nodes_size; index++) {
+            if(!egraph->nodes[index].is_duplicate && egraph->nodes[index].type == NODE_TYPE_OP) {
+                _RETURN_IF_ERROR(egraph_fold_node(egraph, index, &is_changed));
+            }
+        }
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_fold_node(egraph_t *egraph,
+                                    size_t    index,
+                                    bool     *is_changed) {
+    _C_ASSERT(egraph     != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(is_changed != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    egraph_node_t   node   = egraph->nodes[index];
+    size_t          eclass = egraph_find(egraph, node.eclass);
+    egraph_class_t *left   = node.left == EgraphNoClass ? NULL : egraph->classes + egraph_find(egraph, node.left);
+    egraph_class_t *right  = egraph->classes + egraph_find(egraph, node.right);
+    if(egraph->classes[eclass].is_constant || (!right->is_constant && (left == NULL || !left->is_constant))) {
+        return EXPRESSION_SUCCESS;
+    }
+
+    double value = NAN;
+    build_fold_t fold = BUILD_FOLD_NONE;
+    if(right->is_constant && (left == NULL || left->is_constant)) {
+        value = run_operation(left == NULL ? 0 : left->constant, right->constant, node.value.operation);
+        fold  = isnan(value) ? BUILD_FOLD_NONE : BUILD_FOLD_CONST;
+    }
+
+    //Operands are shown to the neutral rules as plain nodes: number for exact 0 or 1, operation otherwise.
+    //Neutral rules compare with tolerance, and rules reassociate constants to values like 3^-11,
+    //which must not be taken for zero
+    bool is_left_neutral  = left != NULL && left->is_constant &&
+                            (egraph_is_same_const(left->constant, 0) || egraph_is_same_const(left->constant, 1));
+    bool is_right_neutral = right->is_constant &&
+                            (egraph_is_same_const(right->constant, 0) || egraph_is_same_const(right->constant, 1));
+    expression_node_t left_node  = {};
+    expression_node_t right_node = {};
+    left_node .type = is_left_neutral  ? NODE_TYPE_NUM : NODE_TYPE_OP;
+    right_node.type = is_right_neutral ? NODE_TYPE_NUM : NODE_TYPE_OP;
+    left_node .value.numeric_value = is_left_neutral  ? left->constant  : 0;
+    right_node.value.numeric_value = is_right_neutral ? right->constant : 0;
+    if(fold == BUILD_FOLD_NONE) {
+        fold = neutral_fold(node.value.operation, left == NULL ? NULL : &left_node, &right_node, &value);
+    }
+
+    size_t folded = 0;
+    switch(fold) {
+        case BUILD_FOLD_CONST: {
+            _RETURN_IF_ERROR(egraph_add_constant(egraph, value, &folded));
+            break;
+        }
+        case BUILD_FOLD_LEFT: {
+            folded = node.left;
+            break;
+        }
+        case BUILD_FOLD_RIGHT: {
+            folded = node.right;
+            break;
+        }
+        case BUILD_FOLD_NONE: {
+            return EXPRESSION_SUCCESS;
+        }
+        default: {
+            return EXPRESSION_SUCCESS;
+        }
+    }
+    *is_changed = egraph_union(egraph, eclass, folded) || *is_changed;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_index(egraph_t *egraph) {
+    _C_ASSERT(egraph != NULL, return EXPRESSION_NULL_POINTER);
+
+    //Nodes are grouped by class with counting sort, class_start[i]..class_start[i + 1] are nodes of class i
+    free(egraph->class_start);
+    free(egraph->class_nodes);
+    egraph->class_start = (size_t *)calloc(egraph->classes_size + 1, sizeof(egraph->class_start[0]));
+    egraph->class_nodes = (size_t *)calloc(egraph->nodes_size + 1  , sizeof(egraph->class_nodes[0]));
+    if(egraph->class_start == NULL || egraph->class_nodes == NULL) {
+        print_error("Error while allocating e-graph index.\n");
+        return EXPRESSION_EGRAPH_ALLOCATION_ERROR;
+    }
+
+    for(size_t index = 0; index < egraph->nodes_size; index++) {
+        egraph->nodes[index].eclass = egraph_find(egraph, egraph->nodes[index].eclass);
+        if(!egraph->nodes[index].is_duplicate) {
+            egraph->class_start[egraph->nodes[index].eclass + 1]++;
+        }
+    }
+    for(size_t eclass = 0; eclass < egraph->classes_size; eclass++) {
+        egraph->class_start[eclass + 1] += egraph->class_start[eclass];
+    }
+    for(size_t index = 0; index < egraph->nodes_size; index++) {
+        if(!egraph->nodes[index].is_duplicate) {
+            size_t eclass = egraph->nodes[index].eclass;
+            egraph->class_nodes[egraph->class_start[eclass]++] = index;
+        }
+    }
+    for(size_t eclass = egraph->classes_size; eclass > 0; eclass--) {
+        egraph->class_start[eclass] = egraph->class_start[eclass - 1];
+    }
+    egraph->class_start[0] = 0;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_search(egraph_t *egraph, size_t iteration) {
+    _C_ASSERT(egraph != NULL, return EXPRESSION_NULL_POINTER);
+
+    egraph->matches_size      = 0;
+    egraph->banned_rules      = 0;
+    egraph->is_search_stopped = false;
+    for(size_t rule = 0; rule < egraph->rules_number && !egraph->is_search_stopped; rule++) {
+        egraph_rule_t *egraph_rule = egraph->rules + rule;
+        if(egraph_rule->banned_until > iteration) {
+            egraph->banned_rules++;
+            continue;
+        }
+
+        //Backoff: rule with too many matches is banned, its limit and ban grow twice with every ban
+        size_t rule_start = egraph->matches_size;
+        egraph->rule_matches_end = rule_start + (egraph->limits.rule_matches << egraph_rule->times_banned);
+        egraph->is_rule_stopped  = false;
+        for(size_t eclass = 0; eclass < egraph->classes_size && !egraph->is_rule_stopped; eclass++) {
+            if(egraph->classes[eclass].parent != eclass) {
+                continue;
+            }
+            egraph_pending_t pending[EgraphMaxPatternSize] = {{egraph_rule->pattern, eclass}};
+            size_t bindings[MaxVarsNumber] = {};
+            for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+                bindings[variable] = EgraphNoClass;
+            }
+            _RETURN_IF_ERROR(egraph_match(egraph, pending, 1, bindings, rule, eclass));
+        }
+        if(egraph->is_rule_stopped && !egraph->is_search_stopped) {
+            egraph->matches_size       = rule_start;
+            egraph_rule->banned_until  = iteration + 1 + (egraph->limits.rule_ban << egraph_rule->times_banned);
+            egraph_rule->times_banned++;
+            egraph->banned_rules++;
+        }
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_match(egraph_t         *egraph,
+                                egraph_pending_t *pending,
+                                size_t            depth,
+                                size_t           *bindings,
+                                size_t            rule,
+                                size_t            eclass) {
+    _C_ASSERT(egraph   != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(pending  != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(bindings != NULL, return EXPRESSION_NULL_POINTER);
+
+    if(egraph->is_rule_stopped) {
+        return EXPRESSION_SUCCESS;
+    }
+    if(egraph_is_timeout(egraph)) {
+        egraph->is_search_stopped = true;
+        egraph->is_rule_stopped   = true;
+        return EXPRESSION_SUCCESS;
+    }
+
+    //All parts of pattern are matched, bindings are saved to be applied after search
+    if(depth == 0) {
+        if(egraph->matches_size == egraph->rule_matches_end || egraph->matches_size == egraph->limits.max_matches) {
+            egraph->is_search_stopped = egraph->matches_size == egraph->limits.max_matches;
+            egraph->is_rule_stopped   = true;
+            return EXPRESSION_SUCCESS;
+        }
+        if(egraph->matches_size == egraph->matches_capacity) {
+            size_t new_capacity = egraph->matches_capacity == 0 ? EgraphMinCapacity : 2 * egraph->matches_capacity;
+            egraph_match_t *new_matches = (egraph_match_t *)realloc(egraph->matches,
+                                                                    new_capacity * sizeof(egraph->matches[0]));
+            if(new_matches == NULL) {
+                print_error("Error while reallocating e-graph matches.\n");
+                return EXPRESSION_EGRAPH_ALLOCATION_ERROR;
+            }
+            egraph->matches          = new_matches;
+            egraph->matches_capacity = new_capacity;
+        }
+        egraph_match_t *match = egraph->matches + egraph->matches_size++;
+        match->rule   = rule;
+        match->eclass = eclass;
+        memcpy(match->bindings, bindings, sizeof(match->bindings));
+        return EXPRESSION_SUCCESS;
+    }
+
+    egraph_pending_t   current = pending[depth - 1];
+    expression_node_t *pattern = current.pattern;
+    size_t             target  = egraph_find(egraph, current.eclass);
+    switch(pattern->type) {
+        case NODE_TYPE_VAR: {
+            size_t *binding = bindings + pattern->value.variable_index;
+            if(*binding != EgraphNoClass) {
+                if(egraph_find(egraph, *binding) != target) {
+                    return EXPRESSION_SUCCESS;
+                }
+                return egraph_match(egraph, pending, depth - 1, bindings, rule, eclass);
+            }
+            *binding = target;
+            expression_error_t error_code = egraph_match(egraph, pending, depth - 1, bindings, rule, eclass);
+            *binding = EgraphNoClass;
+            return error_code;
+        }
+        case NODE_TYPE_NUM: {
+            egraph_class_t *target_class = egraph->classes + target;
+            if(!target_class->is_constant ||
+               fpclassify(target_class->constant - pattern->value.numeric_value) != FP_ZERO) {
+                return EXPRESSION_SUCCESS;
+            }
+            return egraph_match(egraph, pending, depth - 1, bindings, rule, eclass);
+        }
+        case NODE_TYPE_OP: {
+            for(size_t position = egraph->class_start[target]; position < egraph->class_start[target + 1]; position++) {
+                egraph_node_t *node = egraph->nodes + egraph->class_nodes[position];
+                if(node->type != NODE_TYPE_OP || node->value.operation != pattern->value.operation) {
+                    continue;
+                }
+                size_t next_depth = depth - 1;
+                if(pattern->left != NULL) {
+                    pending[next_depth++] = {pattern->left, node->left};
+                }
+                pending[next_depth++] = {pattern->right, node->right};
+                _RETURN_IF_ERROR(egraph_match(egraph, pending, next_depth, bindings, rule, eclass));
+                pending[depth - 1] = current;
+            }
+            return EXPRESSION_SUCCESS;
+        }
+        default: {
+            return EXPRESSION_UNKNOWN_NODE_TYPE;
+        }
+    }
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_instantiate(egraph_t          *egraph,
+                                      expression_node_t *pattern,
+                                      size_t            *bindings,
+                                      size_t            *eclass) {
+    _C_ASSERT(egraph   != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(pattern  != NULL, return EXPRESSION_NODE_NULL_POINTER  );
+    _C_ASSERT(bindings != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(eclass   != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    if(pattern->type == NODE_TYPE_VAR) {
+        *eclass = bindings[pattern->value.variable_index];
+        return EXPRESSION_SUCCESS;
+    }
+    size_t left  = EgraphNoClass;
+    size_t right = EgraphNoClass;
+    if(pattern->left != NULL) {
+        _RETURN_IF_ERROR(egraph_instantiate(egraph, pattern->left , bindings, &left ));
+    }
+    if(pattern->right != NULL) {
+        _RETURN_IF_ERROR(egraph_instantiate(egraph, pattern->right, bindings, &right));
+    }
+    return egraph_add(egraph, pattern->type, pattern->value, left, right, eclass);
+}
+
+/*=========================================================================================================*/
+
+void egraph_extract(egraph_t *egraph, egraph_cost_t cost) {
+    //Costs only go down, so relaxation stops after at most e-graph depth passes
+    bool is_changed = true;
+    while(is_changed) {
+        is_changed = false;
+        for(size_t index = 0; index < egraph->nodes_size; index++) {
+            egraph_node_t *node = egraph->nodes + index;
+            if(node->is_duplicate) {
+                continue;
+            }
+            double node_cost = cost(node);
+            if(node->left != EgraphNoClass) {
+                node_cost += egraph->classes[egraph_find(egraph, node->left)].cost;
+            }
+            if(node->right != EgraphNoClass) {
+                node_cost += egraph->classes[egraph_find(egraph, node->right)].cost;
+            }
+            egraph_class_t *eclass = egraph->classes + egraph_find(egraph, node->eclass);
+            if(node_cost < eclass->cost) {
+                eclass->cost = node_cost;
+                eclass->best = index;
+                is_changed   = true;
+            }
+        }
+    }
+}
+
+/*=========================================================================================================*/
+
+expression_node_t *egraph_build(egraph_t *egraph, expression_t *expression, size_t eclass) {
+    _C_ASSERT(egraph     != NULL, return NULL);
+    _C_ASSERT(expression != NULL, return NULL);
+
+    egraph_node_t *node = egraph->nodes + egraph->classes[eclass].best;
+    expression_node_t *left  = NULL;
+    expression_node_t *right = NULL;
+    if(node->left != EgraphNoClass) {
+        left = egraph_build(egraph, expression, egraph_find(egraph, node->left));
+        if(left == NULL) {
+            return NULL;
+        }
+    }
+    if(node->right != EgraphNoClass) {
+        right = egraph_build(egraph, expression, egraph_find(egraph, node->right));
+        if(right == NULL) {
+            return NULL;
+        }
+    }
+    return new_node(expression, node->type, node->value, left, right);
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_table_insert(egraph_t *egraph, size_t index, size_t *found) {
+    _C_ASSERT(egraph != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(found  != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    //Table keeps node index + 1, zero is an empty slot
+    egraph_node_t *node = egraph->nodes + index;
+    size_t mask = egraph->table_capacity - 1;
+    size_t slot = egraph_hash(node) & mask;
+    while(egraph->table[slot] != 0) {
+        if(egraph_is_same_node(egraph->nodes + egraph->table[slot] - 1, node)) {
+            *found = egraph->table[slot] - 1;
+            return EXPRESSION_SUCCESS;
+        }
+        slot = (slot + 1) & mask;
+    }
+    egraph->table[slot] = index + 1;
+    *found = EgraphNoClass;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t egraph_table_resize(egraph_t *egraph) {
+    _C_ASSERT(egraph != NULL, return EXPRESSION_NULL_POINTER);
+
+    size_t *new_table = (size_t *)calloc(2 * egraph->table_capacity, sizeof(egraph->table[0]));
+    if(new_table == NULL) {
+        print_error("Error while reallocating e-graph table.\n");
+        return EXPRESSION_EGRAPH_ALLOCATION_ERROR;
+    }
+    free(egraph->table);
+    egraph->table           = new_table;
+    egraph->table_capacity *= 2;
+    for(size_t index = 0; index < egraph->nodes_size; index++) {
+        if(egraph->nodes[index].is_duplicate) {
+            continue;
+        }
+        size_t found = EgraphNoClass;
+        _RETURN_IF_ERROR(egraph_table_insert(egraph, index, &found));
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+size_t egraph_hash(egraph_node_t *node) {
+    size_t key = 0;
+    switch(node->type) {
+        case NODE_TYPE_NUM: {
+            memcpy(&key, &node->value.numeric_value, sizeof(key));
+            break;
+        }
+        case NODE_TYPE_VAR: {
+            key = node->value.variable_index;
+            break;
+        }
+        case NODE_TYPE_OP: {
+            key = (size_t)node->value.operation;
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+    size_t hash = (size_t)node->type + 1;
+    size_t parts[] = {key, node->left, node->right};
+    for(size_t part = 0; part < sizeof(parts) / sizeof(parts[0]); part++) {
+        hash ^= parts[part] + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+        hash *= 0xff51afd7ed558ccd;
+        hash ^= hash >> 33;
+    }
+    return hash;
+}
+
+/*=========================================================================================================*/
+
+bool egraph_is_same_const(double first, double second) {
+    return memcmp(&first, &second, sizeof(first)) == 0;
+}
+
+/*=========================================================================================================*/
+
+bool egraph_is_same_value(expression_node_t *input, expression_node_t *result) {
+    for(size_t point = 0; point < sizeof(EgraphCheckPoints) / sizeof(EgraphCheckPoints[0]); point++) {
+        double variables[MaxVarsNumber] = {};
+        for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+            variables[variable] = EgraphCheckPoints[point] + EgraphCheckStep * (double)variable;
+        }
+        double input_value  = NAN;
+        double result_value = NAN;
+        if(evaluate_scalar_node(input , variables, &input_value ) != EXPRESSION_SUCCESS ||
+           evaluate_scalar_node(result, variables, &result_value) != EXPRESSION_SUCCESS) {
+            return false;
+        }
+        //Rules may widen domain of expression (x / x is 1), so only points where input is defined are checked
+        if(!isfinite(input_value)) {
+            continue;
+        }
+        double scale = fmax(1, fmax(fabs(input_value), fabs(result_value)));
+        if(!(fabs(input_value - result_value) <= EgraphCheckPrecision * scale)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*=========================================================================================================*/
+
+bool egraph_is_same_node(egraph_node_t *first, egraph_node_t *second) {
+    if(first->type != second->type || first->left != second->left || first->right != second->right) {
+        return false;
+    }
+    switch(first->type) {
+        case NODE_TYPE_NUM: {
+            return memcmp(&first->value.numeric_value,
+                          &second->value.numeric_value,
+                          sizeof(first->value.numeric_value)) == 0;
+        }
+        case NODE_TYPE_VAR: {
+            return first->value.variable_index == second->value.variable_index;
+        }
+        case NODE_TYPE_OP: {
+            return first->value.operation == second->value.operation;
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+/*=========================================================================================================*/
+
+bool egraph_is_timeout(egraph_t *egraph) {
+    if(!egraph->is_timeout && egraph->steps++ % EgraphClockPeriod == 0) {
+        egraph->is_timeout = egraph_seconds() > egraph->deadline;
+    }
+    return egraph->is_timeout;
+}
+
+/*=========================================================================================================*/
+
+double egraph_seconds(void) {
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
@@ -0,0 +1,329 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "expression_emit.h"
+#include "expression_cse.h"
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "variable_list.h"
+#include "utils.h"
+#include "colors.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static const size_t MaxEmittedNumberSize = 64;
+
+/*=========================================================================================================*/
+
+static expression_error_t emit_write_temporary   (FILE             *file,
+                                                  cse_program_t    *program,
+                                                  variables_list_t *variables_list,
+                                                  size_t           *locals,
+                                                  size_t            index,
+                                                  bool              is_definition);
+
+static void               emit_write_number      (FILE             *file,
+                                                  double            value);
+
+static void               emit_write_parameters  (FILE             *file,
+                                                  variables_list_t *variables_list,
+                                                  size_t            unused_mask,
+                                                  const char       *prefix,
+                                                  const char       *suffix);
+
+static bool               emit_is_constant_power (cse_program_t    *program,
+                                                  size_t            index);
+
+/*=========================================================================================================*/
+
+expression_error_t emit_cpp_header_begin(FILE *file) {
+    _C_ASSERT(file != NULL, return EXPRESSION_WRITING_FILE_ERROR);
+
+    fprintf(file,
+            "//Generated by matan_killer, do not edit\n"
+            "#pragma once\n"
+            "\n"
+            "#include <cmath>\n"
+            "#include <cstddef>\n"
+            "\n"
+            "namespace expression {\n"
+            "\n");
+    emit_write_power_helpers(file, "constexpr inline", "inline", "std::");
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+//Helpers repeat run_integer_power and run_power, so generated code gives the same values as this program.
+//Emitted C++ header and native C code both take them from here with their own qualifiers.
+void emit_write_power_helpers(FILE       *file,
+                              const char *integer_qualifier,
+                              const char *power_qualifier,
+                              const char *math_namespace) {
+    fprintf(file,
+            "%s double integer_power(double base, long power) {\n"
+            "    switch(power) {\n"
+            "        case -2: return 1 / (base * base);\n"
+            "        case -1: return 1 / base;\n"
+            "        case  2: return base * base;\n"
+            "        case  3: return base * base * base;\n"
+            "        default: break;\n"
+            "    }\n"
+            "    unsigned long rest   = (unsigned long)(power < 0 ? -power : power);\n"
+            "    double        result = 1;\n"
+            "    while(rest != 0) {\n"
+            "        if(rest & 1) {\n"
+            "            result *= base;\n"
+            "        }\n"
+            "        base *= base;\n"
+            "        rest >>= 1;\n"
+            "    }\n"
+            "    return power < 0 ? 1 / result : result;\n"
+            "}\n"
+            "\n"
+            "%s double power(double base, double exponent) {\n"
+            "    if(%sfabs(exponent) > %ld.0 || %sfpclassify(exponent - %srint(exponent)) != FP_ZERO) {\n"
+            "        return %spow(base, exponent);\n"
+            "    }\n"
+            "    return integer_power(base, (long)exponent);\n"
+            "}\n"
+            "\n",
+            integer_qualifier,
+            power_qualifier,
+            math_namespace, MaxIntegerPower, math_namespace, math_namespace,
+            math_namespace);
+}
+
+/*=========================================================================================================*/
+
+//Writes function of all variables from the list and its batch form over arrays.
+//Subtrees used more than once are computed once into local constants.
+expression_error_t emit_cpp_function(FILE *file, expression_t *expression, const char *name) {
+    _C_ASSERT(file             != NULL, return EXPRESSION_WRITING_FILE_ERROR);
+    _C_ASSERT(expression       != NULL, return EXPRESSION_NULL_POINTER      );
+    _C_ASSERT(expression->root != NULL, return EXPRESSION_NODE_NULL_POINTER );
+    _C_ASSERT(name             != NULL, return EXPRESSION_NULL_POINTER      );
+
+    cse_program_t program = {};
+    _RETURN_IF_ERROR(cse_program_ctor(&program, expression->root));
+    size_t *locals = (size_t *)calloc(program.size, sizeof(locals[0]));
+    if(locals == NULL) {
+        cse_program_dtor(&program);
+        print_error("Error while allocating emitted locals.\n");
+        return EXPRESSION_EMIT_ALLOCATION_ERROR;
+    }
+
+    //Number of references in the graph of temporaries: copies inside repeated subtree are not counted twice
+    size_t used_mask    = 0;
+    bool   is_constexpr = true;
+    for(size_t index = 0; index < program.size; index++) {
+        cse_temporary_t *temporary = program.temporaries + index;
+        if(temporary->left != CseNoOperand) {
+            locals[temporary->left]++;
+        }
+        if(temporary->right != CseNoOperand) {
+            locals[temporary->right]++;
+        }
+        if(temporary->node->type == NODE_TYPE_VAR) {
+            used_mask |= (size_t)1 << temporary->node->value.variable_index;
+        }
+        if(temporary->node->type == NODE_TYPE_OP && temporary->node->value.operation != OPERATION_ADD &&
+           temporary->node->value.operation != OPERATION_SUB && temporary->node->value.operation != OPERATION_MUL &&
+           temporary->node->value.operation != OPERATION_DIV && !emit_is_constant_power(&program, index)) {
+            is_constexpr = false;
+        }
+    }
+
+    fprintf(file, "%sinline double %s(", is_constexpr ? "constexpr " : "", name);
+    //Derivative may lose some variables, they are kept to have the same signature as function
+    size_t unused_mask = ~used_mask & (((size_t)1 << expression->variables_list->size) - 1);
+    emit_write_parameters(file, expression->variables_list, unused_mask, "double ", "");
+    fprintf(file, ") {\n");
+    size_t locals_number = 0;
+    for(size_t index = 0; index < program.size; index++) {
+        if(program.temporaries[index].node->type == NODE_TYPE_OP && locals[index] >= 2 && index != program.result) {
+            fprintf(file, "    const double t%lu = ", locals_number);
+            expression_error_t error_code = emit_write_temporary(file, &program, expression->variables_list,
+                                                                 locals, index, true);
+            if(error_code != EXPRESSION_SUCCESS) {
+                free(locals);
+                cse_program_dtor(&program);
+                return error_code;
+            }
+            fprintf(file, ";\n");
+            locals[index] = ++locals_number;
+        }
+        else {
+            locals[index] = 0;
+        }
+    }
+    fprintf(file, "    return ");
+    expression_error_t error_code = emit_write_temporary(file, &program, expression->variables_list,
+                                                         locals, program.result, true);
+    free(locals);
+    _RETURN_IF_ERROR(cse_program_dtor(&program));
+    _RETURN_IF_ERROR(error_code);
+    fprintf(file, ";\n}\n\n");
+
+    //Loop body has no calls except inlined function, so compiler can vectorize it.
+    //Arrays are named in_x, so variable with the same name as function does not hide it.
+    fprintf(file, "inline void %s_batch(", name);
+    emit_write_parameters(file, expression->variables_list, 0, "const double *__restrict in_", "");
+    fprintf(file,
+            "%sdouble *__restrict result, std::size_t size) {\n"
+            "    for(std::size_t point = 0; point < size; point++) {\n"
+            "        result[point] = %s(",
+            expression->variables_list->size == 0 ? "" : ", ",
+            name);
+    emit_write_parameters(file, expression->variables_list, 0, "in_", "[point]");
+    fprintf(file, ");\n    }\n}\n\n");
+
+    if(ferror(file)) {
+        print_error("Error while writing emitted function.\n");
+        return EXPRESSION_WRITING_FILE_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t emit_cpp_header_end(FILE *file) {
+    _C_ASSERT(file != NULL, return EXPRESSION_WRITING_FILE_ERROR);
+
+    fprintf(file, "}\n");
+    if(ferror(file)) {
+        print_error("Error while writing emitted header.\n");
+        return EXPRESSION_WRITING_FILE_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t emit_write_temporary(FILE             *file,
+                                        cse_program_t    *program,
+                                        variables_list_t *variables_list,
+                                        size_t           *locals,
+                                        size_t            index,
+                                        bool              is_definition) {
+    _C_ASSERT(program        != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(variables_list != NULL, return EXPRESSION_VARIABLES_LIST_NULL);
+    _C_ASSERT(locals         != NULL, return EXPRESSION_NULL_POINTER       );
+
+    cse_temporary_t   *temporary = program->temporaries + index;
+    expression_node_t *node      = temporary->node;
+    if(!is_definition && locals[index] != 0) {
+        fprintf(file, "t%lu", locals[index] - 1);
+        return EXPRESSION_SUCCESS;
+    }
+    if(node->type == NODE_TYPE_NUM) {
+        emit_write_number(file, node->value.numeric_value);
+        return EXPRESSION_SUCCESS;
+    }
+    if(node->type == NODE_TYPE_VAR) {
+        fprintf(file, "%c", variables_list_get_varname(variables_list, node->value.variable_index));
+        return EXPRESSION_SUCCESS;
+    }
+    if(node->type != NODE_TYPE_OP) {
+        return EXPRESSION_UNKNOWN_NODE_TYPE;
+    }
+
+    if(emit_is_constant_power(program, index)) {
+        fprintf(file, "integer_power(");
+        _RETURN_IF_ERROR(emit_write_temporary(file, program, variables_list, locals, temporary->left, false));
+        fprintf(file, ", %ld)", (long)program->temporaries[temporary->right].node->value.numeric_value);
+        return EXPRESSION_SUCCESS;
+    }
+
+    //Logarithm keeps its base in the left operand, but base is written second
+    const char *prefix = "(";
+    const char *infix  = NULL;
+    const char *suffix = ")";
+    size_t      first  = temporary->left;
+    size_t      second = temporary->right;
+    switch(node->value.operation) {
+        case OPERATION_ADD:     { infix  = " + ";                                             break; }
+        case OPERATION_SUB:     { infix  = " - ";                                             break; }
+        case OPERATION_MUL:     { infix  = " * ";                                             break; }
+        case OPERATION_DIV:     { infix  = " / ";                                             break; }
+        case OPERATION_POW:     { prefix = "power(";            infix = ", ";                 break; }
+        case OPERATION_LOG:     { prefix = "(std::log(";        infix = ") / std::log(";
+                                  suffix = "))";                first = second;
+                                  second = temporary->left;                                   break; }
+        case OPERATION_SIN:     { prefix = "std::sin(";                                       break; }
+        case OPERATION_COS:     { prefix = "std::cos(";                                       break; }
+        case OPERATION_LN:      { prefix = "std::log(";                                       break; }
+        case OPERATION_TG:      { prefix = "std::tan(";                                       break; }
+        case OPERATION_CTG:     { prefix = "(1 / std::tan(";    suffix = "))";                break; }
+        case OPERATION_ARCSIN:  { prefix = "std::asin(";                                      break; }
+        case OPERATION_ARCCOS:  { prefix = "std::acos(";                                      break; }
+        case OPERATION_ARCTG:   { prefix = "std::atan(";                                      break; }
+        case OPERATION_ARCCTG:  { prefix = "(1.5707963267948966 - std::atan("; suffix = "))"; break; }
+        case OPERATION_SH:      { prefix = "std::sinh(";                                      break; }
+        case OPERATION_CH:      { prefix = "std::cosh(";                                      break; }
+        case OPERATION_TH:      { prefix = "std::tanh(";                                      break; }
+        case OPERATION_CTH:     { prefix = "(1 / std::tanh(";   suffix = "))";                break; }
+        case OPERATION_UNKNOWN: { return EXPRESSION_UNKNOWN_OPERATION;                               }
+        default:                { return EXPRESSION_UNKNOWN_OPERATION;                               }
+    }
+
+    fprintf(file, "%s", prefix);
+    if(infix != NULL) {
+        _RETURN_IF_ERROR(emit_write_temporary(file, program, variables_list, locals, first, false));
+        fprintf(file, "%s", infix);
+    }
+    _RETURN_IF_ERROR(emit_write_temporary(file, program, variables_list, locals, second, false));
+    fprintf(file, "%s", suffix);
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+void emit_write_number(FILE *file, double value) {
+    if(isnan(value)) {
+        fprintf(file, "NAN");
+        return;
+    }
+    if(isinf(value)) {
+        fprintf(file, value > 0 ? "HUGE_VAL" : "(-HUGE_VAL)");
+        return;
+    }
+    //17 digits are enough to read the same double back
+    char number[MaxEmittedNumberSize] = {};
+    snprintf(number, MaxEmittedNumberSize, "%.17g", value);
+    const char *suffix = strpbrk(number, ".e") == NULL ? ".0" : "";
+    fprintf(file, value < 0 ? "(%s%s)" : "%s%s", number, suffix);
+}
+
+/*=========================================================================================================*/
+
+void emit_write_parameters(FILE             *file,
+                           variables_list_t *variables_list,
+                           size_t            unused_mask,
+                           const char       *prefix,
+                           const char       *suffix) {
+    for(size_t variable = 0; variable < variables_list->size; variable++) {
+        fprintf(file, "%s%s%s%c%s",
+                variable == 0                   ? ""                  : ", ",
+                (unused_mask >> variable) & 1   ? "[[maybe_unused]] " : "",
+                prefix,
+                variables_list_get_varname(variables_list, variable),
+                suffix);
+    }
+}
+
+/*=========================================================================================================*/
+
+//Integer exponents known at compile time are written as multiplication chains, which are constexpr
+bool emit_is_constant_power(cse_program_t *program, size_t index) {
+    cse_temporary_t *temporary = program->temporaries + index;
+    if(temporary->node->type != NODE_TYPE_OP || temporary->node->value.operation != OPERATION_POW) {
+        return false;
+    }
+    expression_node_t *exponent = program->temporaries[temporary->right].node;
+    return exponent->type == NODE_TYPE_NUM && is_integer(exponent->value.numeric_value) &&
+           fabs(exponent->value.numeric_value) <= (double)MaxIntegerPower;
+}
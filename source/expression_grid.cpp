@@ -0,0 +1,306 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "expression_grid.h"
+#include "expression_batch.h"
+#include "expression_bytecode.h"
+#include "expression_types.h"
+#include "variable_list.h"
+#include "colors.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+//Coordinates and results of one tile take a few tens of kilobytes, so a tile stays in cache
+static const size_t GridTilePoints   = 2048;
+//Numbers in CSV have fixed width, so every record has the same size and is written at known offset
+static const int    GridNumberWidth  = 24;
+static const int    GridNumberDigits = 16;
+static const size_t GridMaxColumns   = MaxVarsNumber + 2;
+
+/*=========================================================================================================*/
+
+struct grid_task_t {
+    const grid_t        *grid;
+    bytecode_t          *function;
+    bytecode_t          *derivative;
+    grid_format_t        format;
+    int                  file;
+    size_t               points_number;
+    size_t               tiles_number;
+    size_t               next_tile;
+    size_t               columns;
+    size_t               record_size;
+    size_t               header_size;
+};
+
+struct grid_worker_t {
+    pthread_t            thread;
+    bool                 is_started;
+    grid_task_t         *task;
+    double              *values;
+    char                *output;
+    expression_error_t   error;
+};
+
+/*=========================================================================================================*/
+
+static expression_error_t grid_check         (const grid_t  *grid,
+                                              bytecode_t    *bytecode);
+
+static expression_error_t grid_run           (grid_task_t   *task,
+                                              size_t         threads_number);
+
+static void              *grid_worker        (void          *argument);
+
+static expression_error_t grid_compute_tile  (grid_worker_t *worker,
+                                              size_t         tile);
+
+static double             grid_coordinate    (const grid_axis_t *axis,
+                                              size_t         index);
+
+static expression_error_t grid_write         (int            file,
+                                              const char    *data,
+                                              size_t         size,
+                                              size_t         offset);
+
+/*=========================================================================================================*/
+
+//Record of a point is its coordinates, value of expression and value of derivative if it is given.
+//Binary file is an array of such records of doubles, CSV file has header line with names of columns.
+expression_error_t grid_evaluate(const grid_t  *grid,
+                                 expression_t  *expression,
+                                 expression_t  *derivative,
+                                 size_t         threads_number,
+                                 const char    *filename,
+                                 grid_format_t  format) {
+    _C_ASSERT(grid       != NULL, return EXPRESSION_GRID_INVALID     );
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER     );
+    _C_ASSERT(filename   != NULL, return EXPRESSION_INVALID_FILENAME );
+    _C_ASSERT(grid->axes_number <= MaxVarsNumber, return EXPRESSION_GRID_INVALID);
+
+    grid_task_t task      = {};
+    bytecode_t  function  = {};
+    bytecode_t  slope     = {};
+    task.grid          = grid;
+    task.file          = -1;
+    task.format        = format;
+    task.function      = &function;
+    task.derivative    = derivative == NULL ? NULL : &slope;
+    task.columns       = grid->axes_number + (derivative == NULL ? 1 : 2);
+    task.points_number = 1;
+    for(size_t axis = 0; axis < grid->axes_number; axis++) {
+        task.points_number *= grid->axes[axis].points_number;
+    }
+    task.tiles_number  = (task.points_number + GridTilePoints - 1) / GridTilePoints;
+    task.record_size   = format == GRID_FORMAT_BINARY ? task.columns * sizeof(double) :
+                                                        task.columns * (size_t)(GridNumberWidth + 1);
+
+    _RETURN_IF_ERROR(bytecode_ctor(&function, expression));
+    expression_error_t error_code = grid_check(grid, &function);
+    if(error_code == EXPRESSION_SUCCESS && derivative != NULL) {
+        error_code = bytecode_ctor(&slope, derivative);
+        if(error_code == EXPRESSION_SUCCESS) {
+            error_code = grid_check(grid, &slope);
+        }
+    }
+    if(error_code == EXPRESSION_SUCCESS) {
+        task.file = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(task.file < 0) {
+            print_error("Error while opening file '%s'.\n", filename);
+            error_code = EXPRESSION_OPENING_FILE_ERROR;
+        }
+    }
+    if(error_code == EXPRESSION_SUCCESS && format == GRID_FORMAT_CSV) {
+        char header[4 * GridMaxColumns] = {};
+        for(size_t axis = 0; axis < grid->axes_number; axis++) {
+            header[task.header_size++] = variables_list_get_varname(expression->variables_list, axis);
+            header[task.header_size++] = ',';
+        }
+        task.header_size += (size_t)sprintf(header + task.header_size, derivative == NULL ? "f\n" : "f,df\n");
+        error_code = grid_write(task.file, header, task.header_size, 0);
+    }
+    if(error_code == EXPRESSION_SUCCESS) {
+        error_code = grid_run(&task, threads_number);
+    }
+
+    if(task.file >= 0) {
+        close(task.file);
+    }
+    bytecode_dtor(&function);
+    if(derivative != NULL) {
+        bytecode_dtor(&slope);
+    }
+    return error_code;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t grid_check(const grid_t *grid, bytecode_t *bytecode) {
+    _C_ASSERT(grid     != NULL, return EXPRESSION_GRID_INVALID);
+    _C_ASSERT(bytecode != NULL, return EXPRESSION_NULL_POINTER);
+
+    if((bytecode->variables_mask >> grid->axes_number) != 0) {
+        print_error("Grid has no axis for some variables of expression.\n");
+        return EXPRESSION_GRID_INVALID;
+    }
+    for(size_t axis = 0; axis < grid->axes_number; axis++) {
+        if(grid->axes[axis].points_number == 0) {
+            print_error("Grid axis %lu is empty.\n", axis);
+            return EXPRESSION_GRID_INVALID;
+        }
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+//Calling thread is one of the workers, the rest are started for this call only
+expression_error_t grid_run(grid_task_t *task, size_t threads_number) {
+    _C_ASSERT(task != NULL, return EXPRESSION_NULL_POINTER);
+
+    if(threads_number == 0) {
+        threads_number = 1;
+    }
+    grid_worker_t *workers = (grid_worker_t *)calloc(threads_number, sizeof(workers[0]));
+    if(workers == NULL) {
+        print_error("Error while allocating grid workers.\n");
+        return EXPRESSION_GRID_ALLOCATION_ERROR;
+    }
+    expression_error_t error_code = EXPRESSION_SUCCESS;
+    for(size_t worker = 0; worker < threads_number; worker++) {
+        workers[worker].task   = task;
+        workers[worker].values = (double *)calloc(task->columns * GridTilePoints, sizeof(double));
+        workers[worker].output = (char   *)calloc(task->record_size * GridTilePoints + 1, sizeof(char));
+        if(workers[worker].values == NULL || workers[worker].output == NULL) {
+            print_error("Error while allocating grid tiles.\n");
+            error_code = EXPRESSION_GRID_ALLOCATION_ERROR;
+        }
+    }
+
+    if(error_code == EXPRESSION_SUCCESS) {
+        for(size_t worker = 1; worker < threads_number; worker++) {
+            workers[worker].is_started = pthread_create(&workers[worker].thread,
+                                                        NULL,
+                                                        grid_worker,
+                                                        workers + worker) == 0;
+        }
+        grid_worker(workers);
+        for(size_t worker = 1; worker < threads_number; worker++) {
+            if(workers[worker].is_started) {
+                pthread_join(workers[worker].thread, NULL);
+            }
+        }
+        for(size_t worker = 0; worker < threads_number; worker++) {
+            if(workers[worker].error != EXPRESSION_SUCCESS) {
+                error_code = workers[worker].error;
+            }
+        }
+    }
+
+    for(size_t worker = 0; worker < threads_number; worker++) {
+        free(workers[worker].values);
+        free(workers[worker].output);
+    }
+    free(workers);
+    return error_code;
+}
+
+/*=========================================================================================================*/
+
+void *grid_worker(void *argument) {
+    _C_ASSERT(argument != NULL, return NULL);
+
+    grid_worker_t *worker = (grid_worker_t *)argument;
+    while(worker->error == EXPRESSION_SUCCESS) {
+        size_t tile = __atomic_fetch_add(&worker->task->next_tile, 1, __ATOMIC_RELAXED);
+        if(tile >= worker->task->tiles_number) {
+            break;
+        }
+        worker->error = grid_compute_tile(worker, tile);
+    }
+    return NULL;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t grid_compute_tile(grid_worker_t *worker, size_t tile) {
+    _C_ASSERT(worker != NULL, return EXPRESSION_NULL_POINTER);
+
+    grid_task_t  *task        = worker->task;
+    const grid_t *grid        = task->grid;
+    size_t        first_point = tile * GridTilePoints;
+    size_t        points      = task->points_number - first_point < GridTilePoints ?
+                                task->points_number - first_point : GridTilePoints;
+
+    //Values are stored by columns, so coordinates are ready to be inputs of batch evaluation.
+    //Last axis changes fastest.
+    const double *inputs[MaxVarsNumber] = {};
+    for(size_t axis = 0; axis < grid->axes_number; axis++) {
+        inputs[axis] = worker->values + axis * GridTilePoints;
+    }
+    for(size_t point = 0; point < points; point++) {
+        size_t index = first_point + point;
+        for(size_t axis = grid->axes_number; axis-- > 0;) {
+            size_t axis_size = grid->axes[axis].points_number;
+            worker->values[axis * GridTilePoints + point] = grid_coordinate(grid->axes + axis, index % axis_size);
+            index /= axis_size;
+        }
+    }
+    double *results = worker->values + grid->axes_number * GridTilePoints;
+    _RETURN_IF_ERROR(bytecode_evaluate_batch(task->function, inputs, points, results));
+    if(task->derivative != NULL) {
+        _RETURN_IF_ERROR(bytecode_evaluate_batch(task->derivative, inputs, points, results + GridTilePoints));
+    }
+
+    char *output = worker->output;
+    for(size_t point = 0; point < points; point++) {
+        for(size_t column = 0; column < task->columns; column++) {
+            double value = worker->values[column * GridTilePoints + point];
+            if(task->format == GRID_FORMAT_BINARY) {
+                memcpy(output, &value, sizeof(value));
+                output += sizeof(value);
+            }
+            else {
+                output += sprintf(output, "%*.*e%c", GridNumberWidth, GridNumberDigits, value,
+                                  column + 1 == task->columns ? '\n' : ',');
+            }
+        }
+    }
+    return grid_write(task->file, worker->output, points * task->record_size,
+                      task->header_size + first_point * task->record_size);
+}
+
+/*=========================================================================================================*/
+
+double grid_coordinate(const grid_axis_t *axis, size_t index) {
+    if(axis->points != NULL) {
+        return axis->points[index];
+    }
+    if(axis->points_number == 1) {
+        return axis->start;
+    }
+    return axis->start + (axis->end - axis->start) * (double)index / (double)(axis->points_number - 1);
+}
+
+/*=========================================================================================================*/
+
+expression_error_t grid_write(int file, const char *data, size_t size, size_t offset) {
+    _C_ASSERT(data != NULL, return EXPRESSION_NULL_POINTER);
+
+    while(size != 0) {
+        ssize_t written = pwrite(file, data, size, (off_t)offset);
+        if(written <= 0) {
+            print_error("Error while writing grid values.\n");
+            return EXPRESSION_WRITING_FILE_ERROR;
+        }
+        data   += written;
+        size   -= (size_t)written;
+        offset += (size_t)written;
+    }
+    return EXPRESSION_SUCCESS;
+}
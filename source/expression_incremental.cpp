@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "expression_incremental.h"
+#include "expression_cse.h"
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "variable_list.h"
+#include "colors.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static void incremental_recompute (incremental_evaluator_t *evaluator,
+                                   size_t                   index);
+
+/*=========================================================================================================*/
+
+//Values of all nodes are kept between calls together with masks of variables they depend on,
+//so after change of one variable only nodes on paths from it to the root are recomputed.
+expression_error_t incremental_ctor(incremental_evaluator_t *evaluator, expression_t *expression) {
+    _C_ASSERT(evaluator  != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER);
+
+    cse_program_t *program = &evaluator->program;
+    _RETURN_IF_ERROR(cse_program_ctor(program, expression->root));
+    evaluator->masks = (size_t *)calloc(program->size, sizeof(evaluator->masks[0]));
+    if(evaluator->masks == NULL) {
+        incremental_dtor(evaluator);
+        print_error("Error while allocating incremental evaluator.\n");
+        return EXPRESSION_INCREMENTAL_ALLOCATION_ERROR;
+    }
+
+    //Temporaries are in post-order, so masks of operands are ready before their users
+    size_t dependents_number = 0;
+    for(size_t index = 0; index < program->size; index++) {
+        cse_temporary_t *temporary = program->temporaries + index;
+        if(temporary->node->type == NODE_TYPE_VAR) {
+            evaluator->masks[index] = (size_t)1 << temporary->node->value.variable_index;
+        }
+        else if(temporary->node->type == NODE_TYPE_OP) {
+            evaluator->masks[index] = evaluator->masks[temporary->right];
+            if(temporary->left != CseNoOperand) {
+                evaluator->masks[index] |= evaluator->masks[temporary->left];
+            }
+        }
+        for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+            if((evaluator->masks[index] >> variable) & 1) {
+                evaluator->dependents_start[variable + 1]++;
+                dependents_number++;
+            }
+        }
+    }
+    evaluator->dependents = (size_t *)calloc(dependents_number + 1, sizeof(evaluator->dependents[0]));
+    if(evaluator->dependents == NULL) {
+        incremental_dtor(evaluator);
+        print_error("Error while allocating incremental evaluator.\n");
+        return EXPRESSION_INCREMENTAL_ALLOCATION_ERROR;
+    }
+    for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+        evaluator->dependents_start[variable + 1] += evaluator->dependents_start[variable];
+    }
+
+    //Lists of dependents stay in post-order, so they can be recomputed in place
+    size_t filled[MaxVarsNumber] = {};
+    for(size_t index = 0; index < program->size; index++) {
+        for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+            if((evaluator->masks[index] >> variable) & 1) {
+                evaluator->dependents[evaluator->dependents_start[variable] + filled[variable]++] = index;
+            }
+        }
+    }
+
+    size_t used_mask = evaluator->masks[program->result];
+    for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+        if((used_mask >> variable) & 1) {
+            _RETURN_IF_ERROR(variables_list_get_value(expression->variables_list,
+                                                      variable,
+                                                      evaluator->variables + variable));
+        }
+    }
+    for(size_t index = 0; index < program->size; index++) {
+        incremental_recompute(evaluator, index);
+    }
+    evaluator->changed_mask = 0;
+    evaluator->recomputed   = 0;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t incremental_set_variable(incremental_evaluator_t *evaluator, size_t index, double value) {
+    _C_ASSERT(evaluator != NULL, return EXPRESSION_NULL_POINTER);
+
+    if(index >= MaxVarsNumber) {
+        print_error("Variable index %lu is out of range.\n", index);
+        return EXPRESSION_UNKNOWN_VARIABLE;
+    }
+    //Same value does not make anything dirty, bits are compared to keep NaN and signed zeros
+    if(memcmp(evaluator->variables + index, &value, sizeof(value)) == 0) {
+        return EXPRESSION_SUCCESS;
+    }
+    evaluator->variables[index] = value;
+    evaluator->changed_mask    |= (size_t)1 << index;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t incremental_evaluate(incremental_evaluator_t *evaluator, double *result) {
+    _C_ASSERT(evaluator != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(result    != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    size_t changed_mask = evaluator->changed_mask;
+    if(changed_mask != 0 && (changed_mask & (changed_mask - 1)) == 0) {
+        size_t variable = (size_t)__builtin_ctzl(changed_mask);
+        for(size_t dependent = evaluator->dependents_start[variable];
+                   dependent < evaluator->dependents_start[variable + 1];
+                   dependent++) {
+            incremental_recompute(evaluator, evaluator->dependents[dependent]);
+        }
+    }
+    //Several variables changed, so lists would have to be merged; checking masks is cheaper
+    else if(changed_mask != 0) {
+        for(size_t index = 0; index < evaluator->program.size; index++) {
+            if((evaluator->masks[index] & changed_mask) != 0) {
+                incremental_recompute(evaluator, index);
+            }
+        }
+    }
+    evaluator->changed_mask = 0;
+    *result = evaluator->program.values[evaluator->program.result];
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+void incremental_recompute(incremental_evaluator_t *evaluator, size_t index) {
+    cse_program_t   *program   = &evaluator->program;
+    cse_temporary_t *temporary = program->temporaries + index;
+    if(temporary->node->type == NODE_TYPE_NUM) {
+        program->values[index] = temporary->node->value.numeric_value;
+    }
+    else if(temporary->node->type == NODE_TYPE_VAR) {
+        program->values[index] = evaluator->variables[temporary->node->value.variable_index];
+    }
+    else {
+        double left = temporary->left == CseNoOperand ? 0 : program->values[temporary->left];
+        program->values[index] = run_operation(left,
+                                               program->values[temporary->right],
+                                               temporary->node->value.operation);
+    }
+    evaluator->recomputed++;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t incremental_dtor(incremental_evaluator_t *evaluator) {
+    _C_ASSERT(evaluator != NULL, return EXPRESSION_NULL_POINTER);
+
+    cse_program_dtor(&evaluator->program);
+    free(evaluator->masks);
+    free(evaluator->dependents);
+    if(memset(evaluator, 0, sizeof(*evaluator)) != evaluator) {
+        return EXPRESSION_MEMSET_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
@@ -0,0 +1,363 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <dlfcn.h>
+#include <cpuid.h>
+#include <sys/wait.h>
+
+#include "expression_native.h"
+#include "expression_bytecode.h"
+#include "expression_emit.h"
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "variable_list.h"
+#include "colors.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static const char  *NativeCompiler       = "cc";
+//ISO mode turns off contraction into FMA, so compiled code gives the same values as run_operation
+static const char  *NativeFlags[]        = {"-std=c11", "-O3", "-march=native", "-fPIC", "-shared"};
+static const size_t NativeFlagsNumber    = sizeof(NativeFlags) / sizeof(NativeFlags[0]);
+static const char  *NativeFunction       = "expression_native";
+static const char  *NativeBatch          = "expression_native_batch";
+static const size_t MaxNativePathSize    = 512;
+static const size_t MaxNativeOperandSize = 64;
+
+/*=========================================================================================================*/
+
+static expression_error_t native_write_instruction (const bytecode_t             *bytecode,
+                                                    const bytecode_instruction_t *instruction,
+                                                    FILE                         *file);
+
+static void               native_write_register    (const bytecode_t             *bytecode,
+                                                    size_t                        index,
+                                                    char                         *operand);
+
+static expression_error_t native_compile           (const char                   *source,
+                                                    size_t                        source_size,
+                                                    const char                   *cache_directory,
+                                                    size_t                        key);
+
+static expression_error_t native_load              (native_code_t                *native_code,
+                                                    const char                   *library_path);
+
+static size_t             native_string_hash       (size_t                        seed,
+                                                    const char                   *string,
+                                                    size_t                        size);
+
+static size_t             native_cpu_hash          (size_t                        seed);
+
+/*=========================================================================================================*/
+
+expression_error_t native_code_ctor(native_code_t *native_code,
+                                    expression_t  *expression,
+                                    const char    *cache_directory) {
+    _C_ASSERT(native_code     != NULL, return EXPRESSION_NULL_POINTER    );
+    _C_ASSERT(expression      != NULL, return EXPRESSION_NULL_POINTER    );
+    _C_ASSERT(cache_directory != NULL, return EXPRESSION_INVALID_FILENAME);
+
+    bytecode_t bytecode = {};
+    _RETURN_IF_ERROR(bytecode_ctor(&bytecode, expression));
+    native_code->variables_mask = bytecode.variables_mask;
+
+    char  *source      = NULL;
+    size_t source_size = 0;
+    FILE  *stream      = open_memstream(&source, &source_size);
+    if(stream == NULL) {
+        bytecode_dtor(&bytecode);
+        print_error("Error while opening stream for native code.\n");
+        return EXPRESSION_NATIVE_SOURCE_ERROR;
+    }
+    expression_error_t error_code = native_write_source(&bytecode, stream);
+    fclose(stream);
+    bytecode_dtor(&bytecode);
+
+    //Library is taken from cache only if generated source, compilation command and processor are the same,
+    //because -march=native code from other processor can have instructions which this one does not support
+    if(error_code == EXPRESSION_SUCCESS) {
+        native_code->key = native_string_hash(0, NativeCompiler, strlen(NativeCompiler));
+        for(size_t flag = 0; flag < NativeFlagsNumber; flag++) {
+            native_code->key = native_string_hash(native_code->key, NativeFlags[flag], strlen(NativeFlags[flag]) + 1);
+        }
+        native_code->key = native_cpu_hash(native_code->key);
+        native_code->key = native_string_hash(native_code->key, source, source_size);
+
+        char library_path[MaxNativePathSize] = {};
+        snprintf(library_path, MaxNativePathSize, "%s/expression_%016lx.so", cache_directory, native_code->key);
+        native_code->is_cached = access(library_path, R_OK) == 0;
+        if(!native_code->is_cached) {
+            error_code = native_compile(source, source_size, cache_directory, native_code->key);
+        }
+        if(error_code == EXPRESSION_SUCCESS) {
+            error_code = native_load(native_code, library_path);
+        }
+    }
+    free(source);
+    return error_code;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t native_code_evaluate(native_code_t    *native_code,
+                                        variables_list_t *variables_list,
+                                        double           *result) {
+    _C_ASSERT(native_code           != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(native_code->function != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(variables_list        != NULL, return EXPRESSION_VARIABLES_LIST_NULL);
+    _C_ASSERT(result                != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    double variables[MaxVarsNumber] = {};
+    for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+        if((native_code->variables_mask >> variable) & 1) {
+            _RETURN_IF_ERROR(variables_list_get_value(variables_list, variable, variables + variable));
+        }
+    }
+    *result = native_code->function(variables);
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t native_code_dtor(native_code_t *native_code) {
+    _C_ASSERT(native_code != NULL, return EXPRESSION_NULL_POINTER);
+
+    if(native_code->library != NULL) {
+        dlclose(native_code->library);
+    }
+    if(memset(native_code, 0, sizeof(*native_code)) != native_code) {
+        return EXPRESSION_MEMSET_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+//Writes C function with one local constant per bytecode instruction.
+//Power helpers are the same as in emitted header, so that values are the same as in interpreters.
+expression_error_t native_write_source(const bytecode_t *bytecode, FILE *file) {
+    _C_ASSERT(bytecode != NULL, return EXPRESSION_NULL_POINTER      );
+    _C_ASSERT(file     != NULL, return EXPRESSION_WRITING_FILE_ERROR);
+
+    fprintf(file,
+            "#include <math.h>\n"
+            "#include <stddef.h>\n"
+            "\n");
+    emit_write_power_helpers(file, "static inline", "static inline", "");
+    fprintf(file, "double %s(const double *variables) {\n", NativeFunction);
+
+    const bytecode_instruction_t *instruction = bytecode->code;
+    for(; instruction->opcode != BYTECODE_RETURN; instruction++) {
+        _RETURN_IF_ERROR(native_write_instruction(bytecode, instruction, file));
+    }
+    char result[MaxNativeOperandSize] = {};
+    native_write_register(bytecode, bytecode->result, result);
+    fprintf(file, "    return %s;\n}\n\n", result);
+
+    fprintf(file,
+            "void %s(const double *const *inputs, size_t points_number, double *outputs) {\n"
+            "    for(size_t point = 0; point < points_number; point++) {\n"
+            "        double variables[%lu] = {0};\n",
+            NativeBatch,
+            MaxVarsNumber);
+    for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+        if((bytecode->variables_mask >> variable) & 1) {
+            fprintf(file, "        variables[%lu] = inputs[%lu][point];\n", variable, variable);
+        }
+    }
+    fprintf(file,
+            "        outputs[point] = %s(variables);\n"
+            "    }\n"
+            "}\n",
+            NativeFunction);
+    if(ferror(file)) {
+        print_error("Error while writing native code.\n");
+        return EXPRESSION_WRITING_FILE_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t native_write_instruction(const bytecode_t             *bytecode,
+                                            const bytecode_instruction_t *instruction,
+                                            FILE                         *file) {
+    _C_ASSERT(bytecode    != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(instruction != NULL, return EXPRESSION_NULL_POINTER);
+
+    char left [MaxNativeOperandSize] = {};
+    char right[MaxNativeOperandSize] = {};
+    native_write_register(bytecode, instruction->left,  left );
+    native_write_register(bytecode, instruction->right, right);
+    size_t target = (size_t)(instruction - bytecode->code);
+
+    #define _WRITE(_format, ...) {                                                   \
+        fprintf(file, "    const double t%lu = " _format ";\n", target, __VA_ARGS__); \
+        break;                                                                       \
+    }
+    switch((bytecode_opcode_t)instruction->opcode) {
+        case BYTECODE_ADD:        _WRITE("%s + %s",                         left,  right);
+        case BYTECODE_SUB:        _WRITE("%s - %s",                         left,  right);
+        case BYTECODE_DIV:        _WRITE("%s / %s",                         left,  right);
+        case BYTECODE_MUL:        _WRITE("%s * %s",                         left,  right);
+        case BYTECODE_POW:        _WRITE("power(%s, %s)",                   left,  right);
+        case BYTECODE_LOG:        _WRITE("log(%s) / log(%s)",               right, left );
+        case BYTECODE_SIN:        _WRITE("sin(%s)",                         right);
+        case BYTECODE_COS:        _WRITE("cos(%s)",                         right);
+        case BYTECODE_LN:         _WRITE("log(%s)",                         right);
+        case BYTECODE_TG:         _WRITE("tan(%s)",                         right);
+        case BYTECODE_CTG:        _WRITE("1 / tan(%s)",                     right);
+        case BYTECODE_ARCSIN:     _WRITE("asin(%s)",                        right);
+        case BYTECODE_ARCCOS:     _WRITE("acos(%s)",                        right);
+        case BYTECODE_ARCTG:      _WRITE("atan(%s)",                        right);
+        case BYTECODE_ARCCTG:     _WRITE("%a - atan(%s)",                   M_PI * 0.5, right);
+        case BYTECODE_SH:         _WRITE("sinh(%s)",                        right);
+        case BYTECODE_CH:         _WRITE("cosh(%s)",                        right);
+        case BYTECODE_TH:         _WRITE("tanh(%s)",                        right);
+        case BYTECODE_CTH:        _WRITE("1 / tanh(%s)",                    right);
+        case BYTECODE_SQUARE:     _WRITE("%s * %s",                         left,  left );
+        case BYTECODE_CUBE:       _WRITE("%s * %s * %s",                    left,  left, left);
+        case BYTECODE_RECIPROCAL: _WRITE("1 / %s",                          left );
+        //Exponent is stored in place of right register
+        case BYTECODE_POWER_INT:  _WRITE("integer_power(%s, %d)",           left,  (int32_t)instruction->right);
+        case BYTECODE_RETURN: {
+            return EXPRESSION_UNKNOWN_OPERATION;
+        }
+        default: {
+            return EXPRESSION_UNKNOWN_OPERATION;
+        }
+    }
+    #undef _WRITE
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+void native_write_register(const bytecode_t *bytecode, size_t index, char *operand) {
+    if(index < MaxVarsNumber) {
+        snprintf(operand, MaxNativeOperandSize, "variables[%lu]", index);
+    }
+    else if(index < bytecode->temporaries_start) {
+        //Hexadecimal form keeps all bits of constant, but it has no form for infinity and NaN
+        double value = bytecode->registers[index];
+        if(isnan(value)) {
+            snprintf(operand, MaxNativeOperandSize, "NAN");
+        }
+        else if(isinf(value)) {
+            snprintf(operand, MaxNativeOperandSize, value > 0 ? "HUGE_VAL" : "(-HUGE_VAL)");
+        }
+        else {
+            snprintf(operand, MaxNativeOperandSize, "(%a)", value);
+        }
+    }
+    else {
+        snprintf(operand, MaxNativeOperandSize, "t%lu", index - bytecode->temporaries_start);
+    }
+}
+
+/*=========================================================================================================*/
+
+expression_error_t native_compile(const char *source,
+                                  size_t      source_size,
+                                  const char *cache_directory,
+                                  size_t      key) {
+    _C_ASSERT(source          != NULL, return EXPRESSION_NULL_POINTER    );
+    _C_ASSERT(cache_directory != NULL, return EXPRESSION_INVALID_FILENAME);
+
+    char source_path   [MaxNativePathSize] = {};
+    char temporary_path[MaxNativePathSize] = {};
+    char library_path  [MaxNativePathSize] = {};
+    snprintf(source_path,    MaxNativePathSize, "%s/expression_%016lx.c",      cache_directory, key);
+    snprintf(temporary_path, MaxNativePathSize, "%s/expression_%016lx.so.%d",  cache_directory, key, getpid());
+    snprintf(library_path,   MaxNativePathSize, "%s/expression_%016lx.so",     cache_directory, key);
+
+    FILE *file = fopen(source_path, "wb");
+    if(file == NULL) {
+        print_error("Error while opening file '%s'.\n", source_path);
+        return EXPRESSION_OPENING_FILE_ERROR;
+    }
+    size_t written = fwrite(source, sizeof(source[0]), source_size, file);
+    fclose(file);
+    if(written != source_size) {
+        print_error("Error while writing file '%s'.\n", source_path);
+        return EXPRESSION_WRITING_FILE_ERROR;
+    }
+
+    //Compiler is started without shell, so paths are passed as they are, with spaces or quotes in them
+    const char *arguments[NativeFlagsNumber + 6] = {NativeCompiler};
+    size_t      arguments_number                 = 1;
+    for(size_t flag = 0; flag < NativeFlagsNumber; flag++) {
+        arguments[arguments_number++] = NativeFlags[flag];
+    }
+    arguments[arguments_number++] = "-o";
+    arguments[arguments_number++] = temporary_path;
+    arguments[arguments_number++] = source_path;
+    arguments[arguments_number++] = "-lm";
+    arguments[arguments_number++] = NULL;
+
+    //Library is built under unique name and renamed, so other processes never load half-written file
+    int   status   = 0;
+    pid_t compiler = fork();
+    if(compiler == 0) {
+        execvp(NativeCompiler, const_cast<char *const *>(arguments));
+        _exit(127);
+    }
+    if(compiler < 0 || waitpid(compiler, &status, 0) != compiler || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        remove(temporary_path);
+        print_error("Error while compiling '%s'.\n", source_path);
+        return EXPRESSION_NATIVE_COMPILATION_ERROR;
+    }
+    if(rename(temporary_path, library_path) != 0) {
+        remove(temporary_path);
+        print_error("Error while saving '%s'.\n", library_path);
+        return EXPRESSION_NATIVE_COMPILATION_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t native_load(native_code_t *native_code, const char *library_path) {
+    _C_ASSERT(native_code  != NULL, return EXPRESSION_NULL_POINTER    );
+    _C_ASSERT(library_path != NULL, return EXPRESSION_INVALID_FILENAME);
+
+    native_code->library = dlopen(library_path, RTLD_NOW | RTLD_LOCAL);
+    if(native_code->library == NULL) {
+        print_error("Error while loading '%s': %s.\n", library_path, dlerror());
+        return EXPRESSION_NATIVE_LOADING_ERROR;
+    }
+    native_code->function       = (native_function_t      )dlsym(native_code->library, NativeFunction);
+    native_code->batch_function = (native_batch_function_t)dlsym(native_code->library, NativeBatch   );
+    if(native_code->function == NULL || native_code->batch_function == NULL) {
+        print_error("Library '%s' has no expression functions.\n", library_path);
+        return EXPRESSION_NATIVE_LOADING_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+size_t native_string_hash(size_t seed, const char *string, size_t size) {
+    //FNV-1a, it is enough to tell apart generated sources
+    size_t hash = seed ^ 0xcbf29ce484222325;
+    for(size_t index = 0; index < size; index++) {
+        hash ^= (unsigned char)string[index];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+/*=========================================================================================================*/
+
+size_t native_cpu_hash(size_t seed) {
+    //Vendor, family and model with feature bits, register with APIC identifier differs between cores and is skipped
+    unsigned int registers[8] = {};
+    unsigned int unused       = 0;
+    __get_cpuid(0, &unused, registers + 0, registers + 1, registers + 2);
+    __get_cpuid(1, registers + 3, &unused, registers + 4, registers + 5);
+    __get_cpuid_count(7, 0, &unused, registers + 6, registers + 7, &unused);
+    return native_string_hash(seed, (const char *)registers, sizeof(registers));
+}
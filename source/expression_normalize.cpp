@@ -0,0 +1,601 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include "expression_normalize.h"
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "utils.h"
+#include "expression_budget.h"
+#include "diff_dump.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static const size_t NormalizeListMinCapacity = 8;
+
+/*=========================================================================================================*/
+
+static expression_error_t normalize_node            (expression_t       *expression,
+                                                     expression_node_t **node);
+
+static expression_error_t normalize_sum             (expression_t       *expression,
+                                                     expression_node_t **node,
+                                                     normalize_list_t   *terms);
+
+static expression_error_t normalize_product         (expression_t       *expression,
+                                                     expression_node_t **node,
+                                                     normalize_list_t   *factors);
+
+static expression_error_t normalize_collect_sum     (expression_t       *expression,
+                                                     expression_node_t  *node,
+                                                     double              sign,
+                                                     bool                is_normalized,
+                                                     normalize_list_t   *terms,
+                                                     double             *constant);
+
+static expression_error_t normalize_collect_product (expression_t       *expression,
+                                                     expression_node_t  *node,
+                                                     double              exponent,
+                                                     bool                is_normalized,
+                                                     normalize_list_t   *factors,
+                                                     double             *coefficient);
+
+static expression_error_t normalize_merge           (expression_t       *expression,
+                                                     normalize_list_t   *list);
+
+static expression_node_t *normalize_build_sum       (expression_t       *expression,
+                                                     normalize_list_t   *terms,
+                                                     double              constant);
+
+static expression_node_t *normalize_build_term      (expression_t       *expression,
+                                                     expression_node_t  *monomial,
+                                                     double              coefficient);
+
+static expression_node_t *normalize_build_product   (expression_t       *expression,
+                                                     normalize_list_t   *factors,
+                                                     double              coefficient);
+
+static expression_node_t *normalize_build_chain     (expression_t       *expression,
+                                                     expression_node_t  *chain,
+                                                     expression_node_t  *factor);
+
+static expression_error_t normalize_list_push       (normalize_list_t   *list,
+                                                     expression_node_t  *node,
+                                                     double              value,
+                                                     bool                is_normalized);
+
+static int                normalize_item_compare    (const void         *first,
+                                                     const void         *second);
+
+static bool               is_sum                    (expression_node_t  *node);
+
+static bool               is_product                (expression_node_t  *node);
+
+static bool               is_integer_power          (expression_node_t  *node);
+
+static bool               is_flattening_exact       (expression_node_t  *base,
+                                                     double              exponent);
+
+static bool               is_exact                  (double              value,
+                                                     double              expected);
+
+/*=========================================================================================================*/
+
+expression_error_t expression_normalize(expression_t     *expression,
+                                        latex_log_info_t *log_info) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER);
+
+    if(expression->root == NULL) {
+        return EXPRESSION_SUCCESS;
+    }
+    //Normalization takes terms apart, so it is not stopped in the middle and only checked before start
+    _RETURN_IF_ERROR(expression_budget_check(expression->budget, expression->nodes_storage.size));
+    _LATEX_LOG_WRITE(log_info, SIMPLIFICATION_NORMALIZE, expression->root);
+    _RETURN_IF_ERROR(normalize_node(expression, &expression->root));
+    _LATEX_LOG_WRITE(log_info, DIFF_RESULT, expression->root);
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t normalize_node(expression_t       *expression,
+                                  expression_node_t **node) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER     );
+    _C_ASSERT(node       != NULL, return EXPRESSION_NODE_NULL_POINTER);
+
+    if(*node == NULL || (*node)->type != NODE_TYPE_OP) {
+        return EXPRESSION_SUCCESS;
+    }
+
+    //Lists are owned by chain root, so every chain is collected and rebuilt exactly once
+    normalize_list_t list = {};
+    expression_error_t error_code = EXPRESSION_SUCCESS;
+    if(is_sum(*node)) {
+        error_code = normalize_sum(expression, node, &list);
+    }
+    else if(is_product(*node)) {
+        error_code = normalize_product(expression, node, &list);
+    }
+    else {
+        error_code = normalize_node(expression, &(*node)->left);
+        if(error_code == EXPRESSION_SUCCESS) {
+            error_code = normalize_node(expression, &(*node)->right);
+        }
+        (*node)->is_simplified = false;
+    }
+    free(list.items);
+    return error_code;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t normalize_sum(expression_t       *expression,
+                                 expression_node_t **node,
+                                 normalize_list_t   *terms) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(node       != NULL, return EXPRESSION_NODE_NULL_POINTER  );
+    _C_ASSERT(terms      != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    double constant = 0;
+    _RETURN_IF_ERROR(normalize_collect_sum(expression, *node, 1, false, terms, &constant));
+
+    //List grows while nested sums are flattened, so items are accessed by index
+    for(size_t index = 0; index < terms->size; index++) {
+        if(!terms->items[index].is_normalized) {
+            _RETURN_IF_ERROR(normalize_node(expression, &terms->items[index].node));
+            terms->items[index].is_normalized = true;
+        }
+        expression_node_t *term = terms->items[index].node;
+        double             sign = terms->items[index].value;
+        if(is_sum(term)) {
+            terms->items[index].node = NULL;
+            _RETURN_IF_ERROR(normalize_collect_sum(expression, term, sign, true, terms, &constant));
+        }
+        else if(term->type == NODE_TYPE_NUM) {
+            constant += sign * term->value.numeric_value;
+            terms->items[index].node = NULL;
+            _RETURN_IF_ERROR(nodes_storage_remove(&expression->nodes_storage, term));
+        }
+        //Index of variable shares memory with operation, so type is checked first
+        else if(term->type != NODE_TYPE_OP) {
+            continue;
+        }
+        else if(term->value.operation == OPERATION_MUL && term->left->type == NODE_TYPE_NUM) {
+            //Term without coefficient is checked again at the end of list, it can be a sum itself
+            terms->items[index].node = NULL;
+            _RETURN_IF_ERROR(normalize_list_push(terms, term->right, sign * term->left->value.numeric_value, true));
+            _RETURN_IF_ERROR(nodes_storage_remove(&expression->nodes_storage, term->left));
+            _RETURN_IF_ERROR(nodes_storage_remove(&expression->nodes_storage, term));
+        }
+        else if(term->value.operation == OPERATION_DIV && term->left->type == NODE_TYPE_NUM) {
+            //c / u is stored as c * (1 / u), so it is collected with other terms 1 / u
+            terms->items[index].value *= term->left->value.numeric_value;
+            term->left->value.numeric_value = 1;
+            node_hash_update(term->left);
+            node_hash_update(term);
+        }
+    }
+
+    _RETURN_IF_ERROR(normalize_merge(expression, terms));
+    *node = normalize_build_sum(expression, terms, constant);
+    if(*node == NULL) {
+        return EXPRESSION_NORMALIZE_ALLOCATION_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t normalize_product(expression_t       *expression,
+                                     expression_node_t **node,
+                                     normalize_list_t   *factors) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(node       != NULL, return EXPRESSION_NODE_NULL_POINTER  );
+    _C_ASSERT(factors    != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    double coefficient = 1;
+    _RETURN_IF_ERROR(normalize_collect_product(expression, *node, 1, false, factors, &coefficient));
+
+    //Merged exponents can make a factor flat, as (u / v)^3 / (u / v)^4 is (u / v)^-1, so merge is repeated
+    bool is_flat = false;
+    while(!is_flat) {
+        for(size_t index = 0; index < factors->size; index++) {
+            if(!factors->items[index].is_normalized) {
+                _RETURN_IF_ERROR(normalize_node(expression, &factors->items[index].node));
+                factors->items[index].is_normalized = true;
+            }
+            expression_node_t *base     = factors->items[index].node;
+            double             exponent = factors->items[index].value;
+            if(base->type == NODE_TYPE_NUM) {
+                coefficient *= pow(base->value.numeric_value, exponent);
+                factors->items[index].node = NULL;
+                _RETURN_IF_ERROR(nodes_storage_remove(&expression->nodes_storage, base));
+            }
+            else if(is_flattening_exact(base, exponent)) {
+                factors->items[index].node = NULL;
+                _RETURN_IF_ERROR(normalize_collect_product(expression, base, exponent, true, factors, &coefficient));
+            }
+        }
+        _RETURN_IF_ERROR(normalize_merge(expression, factors));
+        is_flat = true;
+        for(size_t index = 0; index < factors->size; index++) {
+            if(is_flattening_exact(factors->items[index].node, factors->items[index].value)) {
+                is_flat = false;
+            }
+        }
+    }
+    if(is_exact(coefficient, 0)) {
+        for(size_t index = 0; index < factors->size; index++) {
+            _RETURN_IF_ERROR(expression_delete_subtree(expression, factors->items[index].node));
+        }
+        factors->size = 0;
+    }
+    *node = normalize_build_product(expression, factors, coefficient);
+    if(*node == NULL) {
+        return EXPRESSION_NORMALIZE_ALLOCATION_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t normalize_collect_sum(expression_t      *expression,
+                                         expression_node_t *node,
+                                         double             sign,
+                                         bool               is_normalized,
+                                         normalize_list_t  *terms,
+                                         double            *constant) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(node       != NULL, return EXPRESSION_NODE_NULL_POINTER  );
+    _C_ASSERT(constant   != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    if(node->type == NODE_TYPE_NUM) {
+        *constant += sign * node->value.numeric_value;
+        return nodes_storage_remove(&expression->nodes_storage, node);
+    }
+    if(!is_sum(node)) {
+        return normalize_list_push(terms, node, sign, is_normalized);
+    }
+
+    double right_sign = node->value.operation == OPERATION_SUB ? -sign : sign;
+    _RETURN_IF_ERROR(normalize_collect_sum(expression, node->left , sign      , is_normalized, terms, constant));
+    _RETURN_IF_ERROR(normalize_collect_sum(expression, node->right, right_sign, is_normalized, terms, constant));
+    return nodes_storage_remove(&expression->nodes_storage, node);
+}
+
+/*=========================================================================================================*/
+
+expression_error_t normalize_collect_product(expression_t      *expression,
+                                             expression_node_t *node,
+                                             double             exponent,
+                                             bool               is_normalized,
+                                             normalize_list_t  *factors,
+                                             double            *coefficient) {
+    _C_ASSERT(expression  != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(node        != NULL, return EXPRESSION_NODE_NULL_POINTER  );
+    _C_ASSERT(coefficient != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    if(node->type == NODE_TYPE_NUM) {
+        *coefficient *= pow(node->value.numeric_value, exponent);
+        return nodes_storage_remove(&expression->nodes_storage, node);
+    }
+    if(!is_product(node)) {
+        return normalize_list_push(factors, node, exponent, is_normalized);
+    }
+
+    switch(node->value.operation) {
+        case OPERATION_MUL: {
+            _RETURN_IF_ERROR(normalize_collect_product(expression, node->left , exponent, is_normalized, factors, coefficient));
+            _RETURN_IF_ERROR(normalize_collect_product(expression, node->right, exponent, is_normalized, factors, coefficient));
+            break;
+        }
+        case OPERATION_DIV: {
+            _RETURN_IF_ERROR(normalize_collect_product(expression, node->left ,  exponent, is_normalized, factors, coefficient));
+            _RETURN_IF_ERROR(normalize_collect_product(expression, node->right, -exponent, is_normalized, factors, coefficient));
+            break;
+        }
+        case OPERATION_POW: {
+            //Base of power is a single factor, its own operands are not flattened
+            _RETURN_IF_ERROR(normalize_list_push(factors,
+                                                 node->left,
+                                                 exponent * node->right->value.numeric_value,
+                                                 is_normalized));
+            _RETURN_IF_ERROR(nodes_storage_remove(&expression->nodes_storage, node->right));
+            break;
+        }
+        case OPERATION_UNKNOWN:
+        case OPERATION_ADD:
+        case OPERATION_SUB:
+        case OPERATION_SIN:
+        case OPERATION_COS:
+        case OPERATION_LN:
+        case OPERATION_LOG:
+        case OPERATION_TG:
+        case OPERATION_CTG:
+        case OPERATION_ARCSIN:
+        case OPERATION_ARCCOS:
+        case OPERATION_ARCTG:
+        case OPERATION_ARCCTG:
+        case OPERATION_SH:
+        case OPERATION_CH:
+        case OPERATION_TH:
+        case OPERATION_CTH: {
+            return EXPRESSION_UNKNOWN_OPERATION;
+        }
+        default: {
+            return EXPRESSION_UNKNOWN_OPERATION;
+        }
+    }
+    return nodes_storage_remove(&expression->nodes_storage, node);
+}
+
+/*=========================================================================================================*/
+
+expression_error_t normalize_merge(expression_t     *expression,
+                                   normalize_list_t *list) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(list       != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    size_t size = 0;
+    for(size_t index = 0; index < list->size; index++) {
+        if(list->items[index].node != NULL) {
+            list->items[size++] = list->items[index];
+        }
+    }
+    list->size = size;
+    if(size == 0) {
+        return EXPRESSION_SUCCESS;
+    }
+
+    //Equal operands are neighbours after sorting, their coefficients or exponents are added
+    qsort(list->items, list->size, sizeof(list->items[0]), normalize_item_compare);
+    size = 0;
+    for(size_t index = 1; index < list->size; index++) {
+        if(normalize_compare(list->items[size].node, list->items[index].node) == 0) {
+            list->items[size].value += list->items[index].value;
+            _RETURN_IF_ERROR(expression_delete_subtree(expression, list->items[index].node));
+        }
+        else {
+            list->items[++size] = list->items[index];
+        }
+    }
+    list->size = size + 1;
+
+    size = 0;
+    for(size_t index = 0; index < list->size; index++) {
+        if(is_exact(list->items[index].value, 0)) {
+            _RETURN_IF_ERROR(expression_delete_subtree(expression, list->items[index].node));
+        }
+        else {
+            list->items[size++] = list->items[index];
+        }
+    }
+    list->size = size;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_node_t *normalize_build_sum(expression_t     *expression,
+                                       normalize_list_t *terms,
+                                       double            constant) {
+    _C_ASSERT(expression != NULL, return NULL);
+    _C_ASSERT(terms      != NULL, return NULL);
+
+    expression_node_t *result = NULL;
+    for(size_t index = 0; index < terms->size; index++) {
+        expression_node_t *monomial    = terms->items[index].node;
+        double             coefficient = terms->items[index].value;
+        if(result == NULL) {
+            result = normalize_build_term(expression, monomial, coefficient);
+        }
+        else if(coefficient < 0) {
+            result = new_node(expression, NODE_TYPE_OP, {.operation = OPERATION_SUB},
+                              result, normalize_build_term(expression, monomial, -coefficient));
+        }
+        else {
+            result = new_node(expression, NODE_TYPE_OP, {.operation = OPERATION_ADD},
+                              result, normalize_build_term(expression, monomial, coefficient));
+        }
+    }
+
+    if(result == NULL || !is_exact(constant, 0)) {
+        if(result == NULL) {
+            return new_node(expression, NODE_TYPE_NUM, {.numeric_value = constant}, NULL, NULL);
+        }
+        operation_t operation = constant < 0 ? OPERATION_SUB : OPERATION_ADD;
+        result = new_node(expression, NODE_TYPE_OP, {.operation = operation}, result,
+                          new_node(expression, NODE_TYPE_NUM, {.numeric_value = fabs(constant)}, NULL, NULL));
+    }
+    return result;
+}
+
+/*=========================================================================================================*/
+
+expression_node_t *normalize_build_term(expression_t      *expression,
+                                        expression_node_t *monomial,
+                                        double             coefficient) {
+    _C_ASSERT(expression != NULL, return NULL);
+    _C_ASSERT(monomial   != NULL, return NULL);
+
+    if(is_exact(coefficient, 1)) {
+        return monomial;
+    }
+    if(monomial->type == NODE_TYPE_OP && monomial->value.operation == OPERATION_DIV &&
+       is_node_equal(monomial->left, 1)) {
+        monomial->left->value.numeric_value = coefficient;
+        node_hash_update(monomial->left);
+        node_hash_update(monomial);
+        return monomial;
+    }
+    return new_node(expression, NODE_TYPE_OP, {.operation = OPERATION_MUL},
+                    new_node(expression, NODE_TYPE_NUM, {.numeric_value = coefficient}, NULL, NULL),
+                    monomial);
+}
+
+/*=========================================================================================================*/
+
+expression_node_t *normalize_build_product(expression_t     *expression,
+                                           normalize_list_t *factors,
+                                           double            coefficient) {
+    _C_ASSERT(expression != NULL, return NULL);
+    _C_ASSERT(factors    != NULL, return NULL);
+
+    expression_node_t *numerator   = NULL;
+    expression_node_t *denominator = NULL;
+    for(size_t index = 0; index < factors->size; index++) {
+        expression_node_t *factor   = factors->items[index].node;
+        double             exponent = factors->items[index].value;
+        //Canonical form keeps u ^ 2, so like powers are collected and rewrite rules match it,
+        //evaluation lowers square to one multiplication of a computed register
+        if(!is_exact(fabs(exponent), 1)) {
+            factor = new_node(expression, NODE_TYPE_OP, {.operation = OPERATION_POW}, factor,
+                              new_node(expression, NODE_TYPE_NUM, {.numeric_value = fabs(exponent)}, NULL, NULL));
+        }
+        if(exponent > 0) {
+            numerator = normalize_build_chain(expression, numerator, factor);
+        }
+        else {
+            denominator = normalize_build_chain(expression, denominator, factor);
+        }
+    }
+
+    if(denominator != NULL && numerator == NULL) {
+        numerator = new_node(expression, NODE_TYPE_NUM, {.numeric_value = coefficient}, NULL, NULL);
+        coefficient = 1;
+    }
+    expression_node_t *result = numerator;
+    if(denominator != NULL) {
+        result = new_node(expression, NODE_TYPE_OP, {.operation = OPERATION_DIV}, numerator, denominator);
+    }
+    if(result == NULL) {
+        return new_node(expression, NODE_TYPE_NUM, {.numeric_value = coefficient}, NULL, NULL);
+    }
+    if(is_exact(coefficient, 1)) {
+        return result;
+    }
+    return new_node(expression, NODE_TYPE_OP, {.operation = OPERATION_MUL},
+                    new_node(expression, NODE_TYPE_NUM, {.numeric_value = coefficient}, NULL, NULL),
+                    result);
+}
+
+/*=========================================================================================================*/
+
+expression_node_t *normalize_build_chain(expression_t      *expression,
+                                         expression_node_t *chain,
+                                         expression_node_t *factor) {
+    if(chain == NULL) {
+        return factor;
+    }
+    return new_node(expression, NODE_TYPE_OP, {.operation = OPERATION_MUL}, chain, factor);
+}
+
+/*=========================================================================================================*/
+
+expression_error_t normalize_list_push(normalize_list_t  *list,
+                                       expression_node_t *node,
+                                       double             value,
+                                       bool               is_normalized) {
+    _C_ASSERT(list != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+    _C_ASSERT(node != NULL, return EXPRESSION_NODE_NULL_POINTER  );
+
+    if(list->size == list->capacity) {
+        size_t new_capacity = list->capacity == 0 ? NormalizeListMinCapacity : list->capacity * 2;
+        normalize_item_t *new_items = (normalize_item_t *)realloc(list->items, new_capacity * sizeof(list->items[0]));
+        if(new_items == NULL) {
+            return EXPRESSION_NORMALIZE_ALLOCATION_ERROR;
+        }
+        list->items    = new_items;
+        list->capacity = new_capacity;
+    }
+    list->items[list->size++] = {node, value, is_normalized};
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+int normalize_compare(expression_node_t *first,
+                      expression_node_t *second) {
+    if(first == second) {
+        return 0;
+    }
+    if(first == NULL || second == NULL) {
+        return first == NULL ? -1 : 1;
+    }
+
+    //Numbers go first, then variables, then operations
+    static const int TypeOrder[] = {[NODE_TYPE_NUM] = 0, [NODE_TYPE_OP] = 2, [NODE_TYPE_VAR] = 1};
+    if(first->type != second->type) {
+        return TypeOrder[first->type] - TypeOrder[second->type];
+    }
+    switch(first->type) {
+        case NODE_TYPE_NUM: {
+            return (first->value.numeric_value > second->value.numeric_value) -
+                   (first->value.numeric_value < second->value.numeric_value);
+        }
+        case NODE_TYPE_VAR: {
+            return (first->value.variable_index > second->value.variable_index) -
+                   (first->value.variable_index < second->value.variable_index);
+        }
+        case NODE_TYPE_OP: {
+            if(first->value.operation != second->value.operation) {
+                return (int)first->value.operation - (int)second->value.operation;
+            }
+            int left_order = normalize_compare(first->left, second->left);
+            if(left_order != 0) {
+                return left_order;
+            }
+            return normalize_compare(first->right, second->right);
+        }
+        default: {
+            return 0;
+        }
+    }
+}
+
+/*=========================================================================================================*/
+
+int normalize_item_compare(const void *first, const void *second) {
+    return normalize_compare(((const normalize_item_t *)first )->node,
+                             ((const normalize_item_t *)second)->node);
+}
+
+/*=========================================================================================================*/
+
+bool is_sum(expression_node_t *node) {
+    return node->type == NODE_TYPE_OP &&
+           (node->value.operation == OPERATION_ADD || node->value.operation == OPERATION_SUB);
+}
+
+/*=========================================================================================================*/
+
+bool is_product(expression_node_t *node) {
+    if(node->type != NODE_TYPE_OP) {
+        return false;
+    }
+    return node->value.operation == OPERATION_MUL ||
+           node->value.operation == OPERATION_DIV ||
+           (node->value.operation == OPERATION_POW && node->right->type == NODE_TYPE_NUM);
+}
+
+/*=========================================================================================================*/
+
+bool is_integer_power(expression_node_t *node) {
+    return node->type == NODE_TYPE_OP && node->value.operation == OPERATION_POW &&
+           node->right->type == NODE_TYPE_NUM && is_integer(node->right->value.numeric_value);
+}
+
+/*=========================================================================================================*/
+
+//Only (u * v)^(+-1) and (u^a)^b with integer a and b are flattened,
+//other powers of product are not equal to product of powers
+bool is_flattening_exact(expression_node_t *base, double exponent) {
+    return is_product(base) && (is_exact(exponent, 1) || is_exact(exponent, -1) ||
+                                (is_integer_power(base) && is_integer(exponent)));
+}
+
+/*=========================================================================================================*/
+
+bool is_exact(double value, double expected) {
+    return fpclassify(value - expected) == FP_ZERO;
+}
@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "expression_plot.h"
+#include "expression_bytecode.h"
+#include "expression_types.h"
+#include "variable_list.h"
+#include "colors.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static const size_t PlotInitCapacity = 256;
+
+/*=========================================================================================================*/
+
+enum plot_function_t {
+    PLOT_VALUE     = 0,
+    PLOT_SLOPE     = 1,
+    PLOT_CURVATURE = 2,
+};
+
+static const size_t PlotFunctionsNumber = PLOT_CURVATURE + 1;
+
+struct plot_sample_t {
+    double                 x;
+    double                 values[PlotFunctionsNumber];
+};
+
+struct plot_sampler_t {
+    plot_t                *plot;
+    const plot_settings_t *settings;
+    bytecode_t             functions[PlotFunctionsNumber];
+    size_t                 functions_number;
+};
+
+/*=========================================================================================================*/
+
+static expression_error_t plot_load_function (plot_sampler_t      *sampler,
+                                              expression_t        *expression);
+
+static void               plot_evaluate      (plot_sampler_t      *sampler,
+                                              double               x,
+                                              plot_sample_t       *sample);
+
+static expression_error_t plot_refine        (plot_sampler_t      *sampler,
+                                              const plot_sample_t *left,
+                                              const plot_sample_t *right,
+                                              size_t               depth);
+
+static double             plot_error         (plot_sampler_t      *sampler,
+                                              const plot_sample_t *left,
+                                              const plot_sample_t *right);
+
+static double             plot_tolerance     (plot_sampler_t      *sampler,
+                                              const plot_sample_t *left,
+                                              const plot_sample_t *right);
+
+static bool               plot_is_jump       (const plot_sample_t *left,
+                                              const plot_sample_t *right);
+
+static expression_error_t plot_add_point     (plot_t              *plot,
+                                              const plot_sample_t *sample);
+
+/*=========================================================================================================*/
+
+expression_error_t plot_ctor(plot_t *plot) {
+    _C_ASSERT(plot != NULL, return EXPRESSION_NULL_POINTER);
+
+    plot->points = (plot_point_t *)calloc(PlotInitCapacity, sizeof(plot->points[0]));
+    if(plot->points == NULL) {
+        print_error("Error while allocating plot points.\n");
+        return EXPRESSION_PLOT_ALLOCATION_ERROR;
+    }
+    plot->capacity    = PlotInitCapacity;
+    plot->size        = 0;
+    plot->evaluations = 0;
+    plot->is_broken   = false;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+//Plots expression by variable with index 0, other variables keep their values from variables list.
+//Interval is split while linear interpolation error estimated from derivatives is bigger than tolerance,
+//so flat regions get few points and steep regions get many.
+expression_error_t plot_sample(plot_t                *plot,
+                               expression_t          *expression,
+                               expression_t          *derivative,
+                               expression_t          *second_derivative,
+                               const plot_settings_t *settings) {
+    _C_ASSERT(plot       != NULL, return EXPRESSION_NULL_POINTER         );
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER         );
+    _C_ASSERT(derivative != NULL, return EXPRESSION_NULL_POINTER         );
+    _C_ASSERT(settings   != NULL, return EXPRESSION_PLOT_INVALID_SETTINGS);
+
+    if(settings->initial_intervals == 0 || !(settings->start < settings->end) || !(settings->tolerance > 0)) {
+        print_error("Plot settings are invalid.\n");
+        return EXPRESSION_PLOT_INVALID_SETTINGS;
+    }
+    plot_sampler_t sampler = {};
+    sampler.plot     = plot;
+    sampler.settings = settings;
+    plot->size       = 0;
+    plot->is_broken  = false;
+
+    expression_error_t error_code = plot_load_function(&sampler, expression);
+    if(error_code == EXPRESSION_SUCCESS) {
+        error_code = plot_load_function(&sampler, derivative);
+    }
+    if(error_code == EXPRESSION_SUCCESS && second_derivative != NULL) {
+        error_code = plot_load_function(&sampler, second_derivative);
+    }
+
+    plot_sample_t left  = {};
+    plot_sample_t right = {};
+    if(error_code == EXPRESSION_SUCCESS) {
+        plot_evaluate(&sampler, settings->start, &left);
+        error_code = plot_add_point(plot, &left);
+    }
+    double width = (settings->end - settings->start) / (double)settings->initial_intervals;
+    for(size_t interval = 1; interval <= settings->initial_intervals && error_code == EXPRESSION_SUCCESS; interval++) {
+        double x = interval == settings->initial_intervals ? settings->end :
+                                                             settings->start + width * (double)interval;
+        plot_evaluate(&sampler, x, &right);
+        error_code = plot_refine(&sampler, &left, &right, 0);
+        left = right;
+    }
+
+    for(size_t function = 0; function < sampler.functions_number; function++) {
+        bytecode_dtor(sampler.functions + function);
+    }
+    return error_code;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t plot_load_function(plot_sampler_t *sampler, expression_t *expression) {
+    _C_ASSERT(sampler    != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER);
+
+    bytecode_t *function = sampler->functions + sampler->functions_number;
+    _RETURN_IF_ERROR(bytecode_ctor(function, expression));
+    sampler->functions_number++;
+    for(size_t variable = 1; variable < MaxVarsNumber; variable++) {
+        if((function->variables_mask >> variable) & 1) {
+            _RETURN_IF_ERROR(variables_list_get_value(expression->variables_list,
+                                                      variable,
+                                                      function->registers + variable));
+        }
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+void plot_evaluate(plot_sampler_t *sampler, double x, plot_sample_t *sample) {
+    sample->x = x;
+    for(size_t function = 0; function < sampler->functions_number; function++) {
+        sampler->functions[function].registers[0] = x;
+        sample->values[function] = bytecode_run(sampler->functions + function,
+                                                sampler->functions[function].registers);
+    }
+    sampler->plot->evaluations++;
+}
+
+/*=========================================================================================================*/
+
+//Adds points inside the interval and its right end, left end is already added
+expression_error_t plot_refine(plot_sampler_t      *sampler,
+                               const plot_sample_t *left,
+                               const plot_sample_t *right,
+                               size_t               depth) {
+    _C_ASSERT(sampler != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(left    != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(right   != NULL, return EXPRESSION_NULL_POINTER);
+
+    bool is_left_finite  = isfinite(left ->values[PLOT_VALUE]);
+    bool is_right_finite = isfinite(right->values[PLOT_VALUE]);
+    bool can_split       = depth < sampler->settings->max_depth &&
+                           sampler->plot->size < sampler->settings->max_points;
+    //Bound of domain or pole is searched by bisection when only one end is defined
+    bool is_over = is_left_finite != is_right_finite ||
+                   (is_left_finite && !(plot_error(sampler, left, right) <= plot_tolerance(sampler, left, right)));
+
+    if(is_over && can_split) {
+        plot_sample_t middle = {};
+        plot_evaluate(sampler, (left->x + right->x) / 2, &middle);
+        _RETURN_IF_ERROR(plot_refine(sampler, left, &middle, depth + 1));
+        _RETURN_IF_ERROR(plot_refine(sampler, &middle, right, depth + 1));
+        return EXPRESSION_SUCCESS;
+    }
+    if(is_over && is_left_finite && is_right_finite && plot_is_jump(left, right)) {
+        sampler->plot->is_broken = true;
+    }
+    return plot_add_point(sampler->plot, right);
+}
+
+/*=========================================================================================================*/
+
+//Chord differs from cubic Hermite interpolation by about width / 4 * |slope - chord slope|,
+//and from the function by width^2 / 8 * |second derivative|
+double plot_error(plot_sampler_t *sampler, const plot_sample_t *left, const plot_sample_t *right) {
+    double width = right->x - left->x;
+    double chord = (right->values[PLOT_VALUE] - left->values[PLOT_VALUE]) / width;
+    double error = width / 4 * fmax(fabs(left ->values[PLOT_SLOPE] - chord),
+                                     fabs(right->values[PLOT_SLOPE] - chord));
+    if(sampler->functions_number > PLOT_CURVATURE) {
+        double curvature = fmax(fabs(left->values[PLOT_CURVATURE]), fabs(right->values[PLOT_CURVATURE]));
+        error = fmax(error, width * width / 8 * curvature);
+    }
+    return isnan(error) ? INFINITY : error;
+}
+
+/*=========================================================================================================*/
+
+//Tolerance is relative for big values, otherwise pole would be approached with tiny steps all the way
+double plot_tolerance(plot_sampler_t *sampler, const plot_sample_t *left, const plot_sample_t *right) {
+    double scale = fmax(1, fmax(fabs(left->values[PLOT_VALUE]), fabs(right->values[PLOT_VALUE])));
+    return sampler->settings->tolerance * scale;
+}
+
+/*=========================================================================================================*/
+
+//Function grows on both ends of the interval but falls between them or vice versa, as near poles of tg
+bool plot_is_jump(const plot_sample_t *left, const plot_sample_t *right) {
+    double change = right->values[PLOT_VALUE] - left->values[PLOT_VALUE];
+    return (change < 0 && left->values[PLOT_SLOPE] > 0 && right->values[PLOT_SLOPE] > 0) ||
+           (change > 0 && left->values[PLOT_SLOPE] < 0 && right->values[PLOT_SLOPE] < 0);
+}
+
+/*=========================================================================================================*/
+
+//Undefined points are not stored, polyline is interrupted instead
+expression_error_t plot_add_point(plot_t *plot, const plot_sample_t *sample) {
+    _C_ASSERT(plot   != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(sample != NULL, return EXPRESSION_NULL_POINTER);
+
+    if(!isfinite(sample->values[PLOT_VALUE])) {
+        plot->is_broken = true;
+        return EXPRESSION_SUCCESS;
+    }
+    if(plot->size == plot->capacity) {
+        plot_point_t *new_points = (plot_point_t *)realloc(plot->points, plot->capacity * 2 * sizeof(plot->points[0]));
+        if(new_points == NULL) {
+            print_error("Error while reallocating plot points.\n");
+            return EXPRESSION_PLOT_ALLOCATION_ERROR;
+        }
+        plot->points    = new_points;
+        plot->capacity *= 2;
+    }
+    plot->points[plot->size].x        = sample->x;
+    plot->points[plot->size].value    = sample->values[PLOT_VALUE];
+    plot->points[plot->size].is_break = plot->is_broken && plot->size != 0;
+    plot->size++;
+    plot->is_broken = false;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+//Each line is "x value", pieces of polyline are separated by empty lines as gnuplot expects
+expression_error_t plot_write(const plot_t *plot, const char *filename) {
+    _C_ASSERT(plot     != NULL, return EXPRESSION_NULL_POINTER    );
+    _C_ASSERT(filename != NULL, return EXPRESSION_INVALID_FILENAME);
+
+    FILE *file = fopen(filename, "w");
+    if(file == NULL) {
+        print_error("Error while opening file '%s'.\n", filename);
+        return EXPRESSION_OPENING_FILE_ERROR;
+    }
+    for(size_t point = 0; point < plot->size; point++) {
+        if(plot->points[point].is_break) {
+            fputc('\n', file);
+        }
+        fprintf(file, "%.17g %.17g\n", plot->points[point].x, plot->points[point].value);
+    }
+    if(fclose(file) != 0) {
+        print_error("Error while writing file '%s'.\n", filename);
+        return EXPRESSION_WRITING_FILE_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t plot_dtor(plot_t *plot) {
+    _C_ASSERT(plot != NULL, return EXPRESSION_NULL_POINTER);
+
+    free(plot->points);
+    plot->points   = NULL;
+    plot->size     = 0;
+    plot->capacity = 0;
+    return EXPRESSION_SUCCESS;
+}
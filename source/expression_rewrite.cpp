@@ -0,0 +1,534 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "expression_rewrite.h"
+#include "expression_types.h"
+#include "expression_utils.h"
+#include "expression_cost.h"
+#include "string_parser.h"
+#include "variable_list.h"
+#include "colors.h"
+#include "custom_assert.h"
+
+/*=========================================================================================================*/
+
+static const size_t RewriteNoIndex         = (size_t)-1;
+static const size_t RewriteMinCapacity     = 32;
+static const size_t RewriteMaxRuleLength   = 256;
+static const size_t RewriteMaxPatternSize  = 32;
+
+//Every rule must make tree smaller, so rewriting always stops
+static const char *RewriteDefaultRules[] = {
+    "sin(arcsin(a)) -> a",
+    "cos(arccos(a)) -> a",
+    "tg(arctg(a)) -> a",
+    "ctg(arcctg(a)) -> a",
+    "(a + b) - b -> a",
+    "(a - b) + b -> a",
+    "(a * b) / b -> a",
+    "(a / b) * b -> a",
+    "sin(a)^2 + cos(a)^2 -> 1",
+    "cos(a)^2 + sin(a)^2 -> 1",
+    "ch(a)^2 - sh(a)^2 -> 1",
+    //Normalized sum keeps difference as addition of term with coefficient -1
+    "-1 * sh(a)^2 + ch(a)^2 -> 1",
+    "ch(a)^2 + -1 * sh(a)^2 -> 1",
+    "sin(a) / cos(a) -> tg(a)",
+    "cos(a) / sin(a) -> ctg(a)",
+    "sh(a) / ch(a) -> th(a)",
+    "ch(a) / sh(a) -> cth(a)",
+    "tg(a) * cos(a) -> sin(a)",
+    "ctg(a) * sin(a) -> cos(a)",
+};
+static const size_t RewriteDefaultRulesNumber = sizeof(RewriteDefaultRules) / sizeof(RewriteDefaultRules[0]);
+
+/*=========================================================================================================*/
+
+template <typename T>
+static expression_error_t rewrite_reserve      (T                  **array,
+                                                size_t               size,
+                                                size_t              *capacity);
+
+static expression_error_t rewrite_parse_rule   (rewriter_t          *rewriter,
+                                                char                *rule,
+                                                expression_node_t  **pattern,
+                                                expression_node_t  **result);
+
+static bool               rewrite_check_rule   (expression_node_t   *pattern,
+                                                expression_node_t   *result);
+
+static size_t             rewrite_count        (expression_node_t   *node,
+                                                size_t              *occurrences);
+
+static expression_error_t rewrite_insert       (rewriter_t          *rewriter,
+                                                expression_node_t   *pattern,
+                                                size_t              *state);
+
+static void               rewrite_lookup       (rewriter_t          *rewriter,
+                                                size_t               state,
+                                                expression_node_t  **stack,
+                                                size_t               depth,
+                                                expression_node_t   *root,
+                                                rewrite_choice_t    *best);
+
+static double             rewrite_result_flops (expression_node_t   *result,
+                                                expression_node_t ***bindings);
+
+static bool               rewrite_match        (expression_node_t   *pattern,
+                                                expression_node_t  **slot,
+                                                expression_node_t ***bindings);
+
+static expression_node_t *rewrite_instantiate  (expression_t        *expression,
+                                                expression_node_t   *pattern,
+                                                expression_node_t ***bindings,
+                                                expression_node_t  **bound,
+                                                bool                *is_moved);
+
+static bool               rewrite_same_symbol  (rewrite_symbol_t    *symbol,
+                                                expression_node_t   *node);
+
+/*=========================================================================================================*/
+
+expression_error_t rewriter_ctor(rewriter_t *rewriter) {
+    _C_ASSERT(rewriter != NULL, return EXPRESSION_NULL_POINTER);
+
+    _RETURN_IF_ERROR(nodes_storage_ctor(&rewriter->patterns_storage));
+    _RETURN_IF_ERROR(variables_list_ctor(&rewriter->variables));
+    _RETURN_IF_ERROR(rewrite_reserve(&rewriter->states, 0, &rewriter->states_capacity));
+    rewriter->states[rewriter->states_size++] = {.first_edge = RewriteNoIndex, .first_rule = RewriteNoIndex};
+
+    for(size_t rule = 0; rule < RewriteDefaultRulesNumber; rule++) {
+        _RETURN_IF_ERROR(rewriter_add_rule(rewriter, RewriteDefaultRules[rule]));
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t rewriter_add_rule(rewriter_t *rewriter, const char *rule) {
+    _C_ASSERT(rewriter != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(rule     != NULL, return EXPRESSION_NULL_POINTER);
+
+    //Parser does not skip spaces, so they are removed before parsing
+    char buffer[RewriteMaxRuleLength] = {};
+    size_t length = 0;
+    for(const char *symbol = rule; *symbol != '\0'; symbol++) {
+        if(isspace(*symbol)) {
+            continue;
+        }
+        if(length + 1 == RewriteMaxRuleLength) {
+            print_error("Rewrite rule '%s' is too long.\n", rule);
+            return EXPRESSION_REWRITE_RULE_ERROR;
+        }
+        buffer[length++] = *symbol;
+    }
+
+    expression_node_t *pattern = NULL;
+    expression_node_t *result  = NULL;
+    if(rewrite_parse_rule(rewriter, buffer, &pattern, &result) != EXPRESSION_SUCCESS ||
+       !rewrite_check_rule(pattern, result)) {
+        print_error("Wrong rewrite rule '%s'.\n", rule);
+        return EXPRESSION_REWRITE_RULE_ERROR;
+    }
+
+    _RETURN_IF_ERROR(rewrite_reserve(&rewriter->rules, rewriter->rules_size, &rewriter->rules_capacity));
+    size_t state = 0;
+    _RETURN_IF_ERROR(rewrite_insert(rewriter, pattern, &state));
+    rewriter->rules[rewriter->rules_size] = {.pattern = pattern,
+                                             .result  = result,
+                                             .next    = rewriter->states[state].first_rule};
+    rewriter->states[state].first_rule = rewriter->rules_size++;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t rewriter_load_file(rewriter_t *rewriter, const char *filename) {
+    _C_ASSERT(rewriter != NULL, return EXPRESSION_NULL_POINTER    );
+    _C_ASSERT(filename != NULL, return EXPRESSION_INVALID_FILENAME);
+
+    FILE *rules_file = fopen(filename, "r");
+    if(rules_file == NULL) {
+        print_error("Error while opening rules file %s.\n", filename);
+        return EXPRESSION_OPENING_FILE_ERROR;
+    }
+
+    //One rule in line, lines starting with '#' are comments
+    char line[RewriteMaxRuleLength] = {};
+    while(fgets(line, sizeof(line), rules_file) != NULL) {
+        size_t start = strspn(line, " \t\r\n");
+        if(line[start] == '\0' || line[start] == '#') {
+            continue;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        expression_error_t error_code = rewriter_add_rule(rewriter, line + start);
+        if(error_code != EXPRESSION_SUCCESS) {
+            fclose(rules_file);
+            return error_code;
+        }
+    }
+
+    fclose(rules_file);
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+size_t rewriter_find(rewriter_t *rewriter, expression_node_t *node) {
+    _C_ASSERT(rewriter != NULL, return RewriteNoRule);
+
+    if(node == NULL || node->type != NODE_TYPE_OP) {
+        return RewriteNoRule;
+    }
+    //Rule with the cheapest result wins, rules loaded earlier win among equally cheap ones. Cost of node
+    //itself is only found when some rule matches
+    expression_node_t *stack[2 * RewriteMaxPatternSize] = {node};
+    rewrite_choice_t best = {.rule = RewriteNoRule, .flops = NAN};
+    rewrite_lookup(rewriter, 0, stack, 1, node, &best);
+    return best.rule;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t rewriter_apply(rewriter_t         *rewriter,
+                                  expression_t       *expression,
+                                  expression_node_t **node,
+                                  size_t              rule) {
+    _C_ASSERT(rewriter   != NULL, return EXPRESSION_NULL_POINTER     );
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER     );
+    _C_ASSERT(node       != NULL, return EXPRESSION_NODE_NULL_POINTER);
+    _C_ASSERT(rule        < rewriter->rules_size, return EXPRESSION_REWRITE_RULE_ERROR);
+
+    expression_node_t **bindings[MaxVarsNumber] = {};
+    if(!rewrite_match(rewriter->rules[rule].pattern, node, bindings)) {
+        return EXPRESSION_REWRITE_RULE_ERROR;
+    }
+    expression_node_t *bound[MaxVarsNumber] = {};
+    for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+        bound[variable] = bindings[variable] == NULL ? NULL : *bindings[variable];
+    }
+
+    //Matched subtrees are moved to result, so only the rest of old subtree is deleted
+    bool is_moved[MaxVarsNumber] = {};
+    expression_node_t *result = rewrite_instantiate(expression, rewriter->rules[rule].result, bindings, bound, is_moved);
+    if(result == NULL) {
+        return EXPRESSION_REWRITE_ALLOCATION_ERROR;
+    }
+    _RETURN_IF_ERROR(expression_delete_subtree(expression, *node));
+    *node = result;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t rewriter_dtor(rewriter_t *rewriter) {
+    _C_ASSERT(rewriter != NULL, return EXPRESSION_NULL_POINTER);
+
+    _RETURN_IF_ERROR(nodes_storage_dtor(&rewriter->patterns_storage));
+    free(rewriter->states);
+    free(rewriter->edges);
+    free(rewriter->rules);
+    if(memset(rewriter, 0, sizeof(*rewriter)) != rewriter) {
+        return EXPRESSION_MEMSET_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+template <typename T>
+expression_error_t rewrite_reserve(T **array, size_t size, size_t *capacity) {
+    _C_ASSERT(array    != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(capacity != NULL, return EXPRESSION_NULL_POINTER);
+
+    if(size < *capacity) {
+        return EXPRESSION_SUCCESS;
+    }
+    size_t new_capacity = *capacity == 0 ? RewriteMinCapacity : 2 * *capacity;
+    T *new_array = (T *)realloc(*array, new_capacity * sizeof(T));
+    if(new_array == NULL) {
+        print_error("Error while reallocating rewriter.\n");
+        return EXPRESSION_REWRITE_ALLOCATION_ERROR;
+    }
+    *array    = new_array;
+    *capacity = new_capacity;
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+expression_error_t rewrite_parse_rule(rewriter_t         *rewriter,
+                                      char               *rule,
+                                      expression_node_t **pattern,
+                                      expression_node_t **result) {
+    _C_ASSERT(rewriter != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(rule     != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(pattern  != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+    _C_ASSERT(result   != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    char *arrow = strstr(rule, "->");
+    if(arrow == NULL) {
+        return EXPRESSION_REWRITE_RULE_ERROR;
+    }
+    *arrow = '\0';
+
+    //Letters of all rules are pattern variables from one list, so same letter has the same index
+    expression_t patterns = {};
+    patterns.nodes_storage  = rewriter->patterns_storage;
+    patterns.variables_list = &rewriter->variables;
+    parser_info_t pattern_info = {.input = rule     , .position = 0};
+    parser_info_t result_info  = {.input = arrow + 2, .position = 0};
+    expression_error_t error_code = read_expression(&patterns, &pattern_info);
+    *pattern = patterns.root;
+    if(error_code == EXPRESSION_SUCCESS) {
+        error_code = read_expression(&patterns, &result_info);
+        *result = patterns.root;
+    }
+    rewriter->patterns_storage = patterns.nodes_storage;
+    return error_code;
+}
+
+/*=========================================================================================================*/
+
+bool rewrite_check_rule(expression_node_t *pattern, expression_node_t *result) {
+    if(pattern == NULL || result == NULL || pattern->type != NODE_TYPE_OP) {
+        return false;
+    }
+    size_t pattern_occurrences[MaxVarsNumber] = {};
+    size_t result_occurrences [MaxVarsNumber] = {};
+    size_t pattern_size = rewrite_count(pattern, pattern_occurrences);
+    size_t result_size  = rewrite_count(result , result_occurrences );
+    if(pattern_size > RewriteMaxPatternSize || result_size >= pattern_size) {
+        return false;
+    }
+    for(size_t variable = 0; variable < MaxVarsNumber; variable++) {
+        if(result_occurrences[variable] > pattern_occurrences[variable]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*=========================================================================================================*/
+
+size_t rewrite_count(expression_node_t *node, size_t *occurrences) {
+    if(node == NULL) {
+        return 0;
+    }
+    if(node->type == NODE_TYPE_VAR) {
+        occurrences[node->value.variable_index]++;
+    }
+    return 1 + rewrite_count(node->left, occurrences) + rewrite_count(node->right, occurrences);
+}
+
+/*=========================================================================================================*/
+
+expression_error_t rewrite_insert(rewriter_t        *rewriter,
+                                  expression_node_t *pattern,
+                                  size_t            *state) {
+    _C_ASSERT(rewriter != NULL, return EXPRESSION_NULL_POINTER       );
+    _C_ASSERT(pattern  != NULL, return EXPRESSION_NODE_NULL_POINTER  );
+    _C_ASSERT(state    != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+
+    //Pattern is a path in discrimination tree: its nodes in preorder, any variable is a wildcard
+    rewrite_symbol_t symbol = {.type = pattern->type, .value = pattern->value};
+    size_t edge = rewriter->states[*state].first_edge;
+    while(edge != RewriteNoIndex) {
+        rewrite_edge_t *current = rewriter->edges + edge;
+        if(current->symbol.type == symbol.type &&
+           (symbol.type == NODE_TYPE_VAR ||
+            (symbol.type == NODE_TYPE_OP  && current->symbol.value.operation == symbol.value.operation) ||
+            (symbol.type == NODE_TYPE_NUM && memcmp(&current->symbol.value.numeric_value,
+                                                    &symbol.value.numeric_value,
+                                                    sizeof(symbol.value.numeric_value)) == 0))) {
+            break;
+        }
+        edge = current->next;
+    }
+    if(edge == RewriteNoIndex) {
+        _RETURN_IF_ERROR(rewrite_reserve(&rewriter->states, rewriter->states_size, &rewriter->states_capacity));
+        _RETURN_IF_ERROR(rewrite_reserve(&rewriter->edges , rewriter->edges_size , &rewriter->edges_capacity ));
+        rewriter->states[rewriter->states_size] = {.first_edge = RewriteNoIndex, .first_rule = RewriteNoIndex};
+        rewriter->edges [rewriter->edges_size ] = {.symbol = symbol,
+                                                   .target = rewriter->states_size++,
+                                                   .next   = rewriter->states[*state].first_edge};
+        edge = rewriter->edges_size++;
+        rewriter->states[*state].first_edge = edge;
+    }
+    *state = rewriter->edges[edge].target;
+
+    if(pattern->type != NODE_TYPE_OP) {
+        return EXPRESSION_SUCCESS;
+    }
+    if(pattern->left != NULL) {
+        _RETURN_IF_ERROR(rewrite_insert(rewriter, pattern->left, state));
+    }
+    return rewrite_insert(rewriter, pattern->right, state);
+}
+
+/*=========================================================================================================*/
+
+void rewrite_lookup(rewriter_t         *rewriter,
+                    size_t              state,
+                    expression_node_t **stack,
+                    size_t              depth,
+                    expression_node_t  *root,
+                    rewrite_choice_t   *best) {
+    //Whole expression subtree is read, rules of the state are candidates and only have to be checked for
+    //repeated variables
+    if(depth == 0) {
+        for(size_t rule = rewriter->states[state].first_rule; rule != RewriteNoIndex; rule = rewriter->rules[rule].next) {
+            expression_node_t **bindings[MaxVarsNumber] = {};
+            if(!rewrite_match(rewriter->rules[rule].pattern, &root, bindings)) {
+                continue;
+            }
+            if(isnan(best->flops)) {
+                best->flops = subtree_estimate_cost(root).flops;
+            }
+            double flops = rewrite_result_flops(rewriter->rules[rule].result, bindings);
+            if(flops < best->flops || (!(flops > best->flops) && rule < best->rule)) {
+                *best = {.rule = rule, .flops = flops};
+            }
+        }
+        return;
+    }
+
+    expression_node_t *node = stack[depth - 1];
+    for(size_t edge = rewriter->states[state].first_edge; edge != RewriteNoIndex; edge = rewriter->edges[edge].next) {
+        rewrite_edge_t *current = rewriter->edges + edge;
+        if(current->symbol.type == NODE_TYPE_VAR) {
+            rewrite_lookup(rewriter, current->target, stack, depth - 1, root, best);
+            continue;
+        }
+        if(!rewrite_same_symbol(&current->symbol, node)) {
+            continue;
+        }
+        //Children replace node on stack in reverse order, so that left one is read first
+        size_t next_depth = depth - 1;
+        if(node->type == NODE_TYPE_OP) {
+            stack[next_depth++] = node->right;
+            if(node->left != NULL) {
+                stack[next_depth++] = node->left;
+            }
+        }
+        rewrite_lookup(rewriter, current->target, stack, next_depth, root, best);
+        stack[depth - 1] = node;
+    }
+}
+
+/*=========================================================================================================*/
+
+double rewrite_result_flops(expression_node_t   *result,
+                            expression_node_t ***bindings) {
+    switch(result->type) {
+        case NODE_TYPE_VAR: {
+            return subtree_estimate_cost(*bindings[result->value.variable_index]).flops;
+        }
+        case NODE_TYPE_OP: {
+            double flops = operation_flops(result->value.operation);
+            if(result->left != NULL) {
+                flops += rewrite_result_flops(result->left, bindings);
+            }
+            return flops + rewrite_result_flops(result->right, bindings);
+        }
+        case NODE_TYPE_NUM:
+        default: {
+            return 0;
+        }
+    }
+}
+
+/*=========================================================================================================*/
+
+bool rewrite_match(expression_node_t   *pattern,
+                   expression_node_t  **slot,
+                   expression_node_t ***bindings) {
+    expression_node_t *node = *slot;
+    if(node == NULL) {
+        return false;
+    }
+    switch(pattern->type) {
+        case NODE_TYPE_VAR: {
+            expression_node_t ***binding = bindings + pattern->value.variable_index;
+            if(*binding == NULL) {
+                *binding = slot;
+                return true;
+            }
+            return is_subtree_equal(**binding, node);
+        }
+        case NODE_TYPE_NUM: {
+            return is_node_equal(node, pattern->value.numeric_value);
+        }
+        case NODE_TYPE_OP: {
+            if(node->type != NODE_TYPE_OP || node->value.operation != pattern->value.operation) {
+                return false;
+            }
+            if(pattern->left != NULL && !rewrite_match(pattern->left, &node->left, bindings)) {
+                return false;
+            }
+            return rewrite_match(pattern->right, &node->right, bindings);
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+/*=========================================================================================================*/
+
+expression_node_t *rewrite_instantiate(expression_t        *expression,
+                                       expression_node_t   *pattern,
+                                       expression_node_t ***bindings,
+                                       expression_node_t  **bound,
+                                       bool                *is_moved) {
+    if(pattern->type == NODE_TYPE_VAR) {
+        size_t variable = pattern->value.variable_index;
+        if(is_moved[variable]) {
+            return copy_node(expression, bound[variable]);
+        }
+        is_moved[variable]  = true;
+        *bindings[variable] = NULL;
+        return bound[variable];
+    }
+
+    expression_node_t *left  = NULL;
+    expression_node_t *right = NULL;
+    if(pattern->left != NULL) {
+        left = rewrite_instantiate(expression, pattern->left, bindings, bound, is_moved);
+        if(left == NULL) {
+            return NULL;
+        }
+    }
+    if(pattern->right != NULL) {
+        right = rewrite_instantiate(expression, pattern->right, bindings, bound, is_moved);
+        if(right == NULL) {
+            return NULL;
+        }
+    }
+    return new_node(expression, pattern->type, pattern->value, left, right);
+}
+
+/*=========================================================================================================*/
+
+bool rewrite_same_symbol(rewrite_symbol_t *symbol, expression_node_t *node) {
+    if(symbol->type != node->type) {
+        return false;
+    }
+    switch(symbol->type) {
+        case NODE_TYPE_NUM: {
+            return is_node_equal(node, symbol->value.numeric_value);
+        }
+        case NODE_TYPE_OP: {
+            return symbol->value.operation == node->value.operation;
+        }
+        case NODE_TYPE_VAR: {
+            return true;
+        }
+        default: {
+            return false;
+        }
+    }
+}
@@ -1,53 +1,92 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <stdint.h>
 
 #include "matan_killer.h"
 #include "expression_types.h"
 #include "expression_simplify.h"
 #include "expression_utils.h"
+#include "expression_builders.h"
+#include "operation_rules.h"
+#include "expression_rewrite.h"
+#include "expression_budget.h"
+#include "expression_cost.h"
 #include "diff_dump.h"
+#include "utils.h"
 #include "custom_assert.h"
 
 /*=========================================================================================================*/
 
-static expression_error_t evaluate_subtree_operation (expression_t       *expression,
-                                                      expression_node_t  *node,
-                                                      double             *result,
-                                                      size_t             *changes_counter,
+static expression_error_t evaluate_subtree_operation (expression_t            *expression,
+                                                      expression_node_t       *node,
+                                                      double                  *result,
+                                                      size_t                  *changes_counter,
+                                                      const bound_variables_t *bound,
+                                                      latex_log_info_t        *log_info);
+
+static expression_error_t simplify_evaluate_subtree  (expression_t            *expression,
+                                                      expression_node_t       *node,
+                                                      double                  *result,
+                                                      size_t                  *changes_counter,
+                                                      const bound_variables_t *bound,
+                                                      latex_log_info_t        *log_info);
+
+static expression_error_t simplify_node              (expression_t       *expression,
+                                                      expression_node_t **node,
+                                                      size_t             *constant_pass,
                                                       latex_log_info_t   *log_info);
 
-static expression_error_t simplify_evaluate_subtree  (expression_t       *expression,
-                                                      expression_node_t  *node,
-                                                      double             *result,
-                                                      size_t             *changes_counter,
+static bool               simplify_invalidate_path   (expression_node_t  *subtree,
+                                                      expression_node_t  *node);
+
+static expression_error_t simplify_apply_fold        (expression_t       *expression,
+                                                      expression_node_t **node,
+                                                      build_fold_t        fold,
+                                                      double              value,
                                                       latex_log_info_t   *log_info);
 
-static expression_error_t simplify_neutrals          (expression_t       *expression,
-                                                      expression_node_t  *node,
-                                                      size_t             *changes_counter,
-                                                      expression_node_t **result,
+static bool               simplify_is_power_folded   (expression_node_t  *node);
+
+static expression_error_t simplify_power             (expression_t       *expression,
+                                                      expression_node_t **node,
+                                                      size_t             *constant_pass,
+                                                      latex_log_info_t   *log_info);
+
+static expression_error_t simplify_identical         (expression_t       *expression,
+                                                      expression_node_t **node,
+                                                      size_t             *constant_pass,
+                                                      latex_log_info_t   *log_info);
+
+static expression_error_t simplify_rewrite           (expression_t       *expression,
+                                                      expression_node_t **node,
+                                                      size_t             *constant_pass,
                                                       latex_log_info_t   *log_info);
 
 /*=========================================================================================================*/
 
-expression_error_t simplify_evaluate_subtree(expression_t      *expression,
-                                             expression_node_t *node,
-                                             double            *result,
-                                             size_t            *changes_counter,
-                                             latex_log_info_t  *log_info) {
+//Bound variables are known as numbers, simplified subtrees can contain them and are not skipped then
+expression_error_t simplify_evaluate_subtree(expression_t            *expression,
+                                             expression_node_t       *node,
+                                             double                  *result,
+                                             size_t                  *changes_counter,
+                                             const bound_variables_t *bound,
+                                             latex_log_info_t        *log_info) {
     _C_ASSERT(expression      != NULL, return EXPRESSION_NULL_POINTER         );
     _C_ASSERT(result          != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
     _C_ASSERT(changes_counter != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
-    _C_ASSERT(log_info        != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
 
     // technical_dump(expression, node, "Trying to evaluate subtree");
-    if(node == NULL) {
+    if(node == NULL || (node->type == NODE_TYPE_OP && node->is_simplified && bound == NULL)) {
         *result = NAN;
         return EXPRESSION_SUCCESS;
     }
     switch(node->type) {
         case NODE_TYPE_VAR: {
+            if(bound != NULL && ((bound->mask >> node->value.variable_index) & 1)) {
+                *result = bound->values[node->value.variable_index];
+                return EXPRESSION_SUCCESS;
+            }
             *result = NAN;
             return EXPRESSION_SUCCESS;
         }
@@ -60,6 +99,7 @@ expression_error_t simplify_evaluate_subtree(expression_t      *expression,
                                                         node,
                                                         result,
                                                         changes_counter,
+                                                        bound,
                                                         log_info));
             return EXPRESSION_SUCCESS;
         }
@@ -72,28 +112,31 @@ expression_error_t simplify_evaluate_subtree(expression_t      *expression,
 
 /*=========================================================================================================*/
 
-expression_error_t evaluate_subtree_operation(expression_t      *expression,
-                                              expression_node_t *node,
-                                              double            *result,
-                                              size_t            *changes_counter,
-                                              latex_log_info_t  *log_info) {
+expression_error_t evaluate_subtree_operation(expression_t            *expression,
+                                              expression_node_t       *node,
+                                              double                  *result,
+                                              size_t                  *changes_counter,
+                                              const bound_variables_t *bound,
+                                              latex_log_info_t        *log_info) {
     _C_ASSERT(expression      != NULL, return EXPRESSION_NULL_POINTER         );
     _C_ASSERT(result          != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
     _C_ASSERT(changes_counter != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
-    _C_ASSERT(log_info        != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
     _C_ASSERT(node            != NULL, return EXPRESSION_NODE_NULL_POINTER    );
 
     double result_left = NAN;
     double result_right = NAN;
+    size_t changes_before = *changes_counter;
     _RETURN_IF_ERROR(simplify_evaluate_subtree(expression,
                                                node->left,
                                                &result_left,
                                                changes_counter,
+                                               bound,
                                                log_info));
     _RETURN_IF_ERROR(simplify_evaluate_subtree(expression,
                                                node->right,
                                                &result_right,
                                                changes_counter,
+                                               bound,
                                                log_info));
 
     if(!isnan(result_left) && !isnan(result_right)) {
@@ -102,338 +145,357 @@ expression_error_t evaluate_subtree_operation(expression_t      *expression,
     }
 
     if(!isnan(result_left) && isnan(result_right)) {
-        if(node->left->left == NULL && node->left->right == NULL) {
+        if(node->left->type == NODE_TYPE_NUM) {
             return EXPRESSION_SUCCESS;
         }
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_EVALUATE, node));
+        _LATEX_LOG_WRITE(log_info, SIMPLIFICATION_EVALUATE, node);
 
         _RETURN_IF_ERROR(expression_delete_subtree(expression, node->left));
         node->left = new_node(expression, NODE_TYPE_NUM, {.numeric_value = result_left}, NULL, NULL);
+        node->is_simplified = false;
 
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node));
+        _LATEX_LOG_WRITE(log_info, DIFF_RESULT, node);
         (*changes_counter)++;
         return EXPRESSION_SUCCESS;
     }
 
     if(isnan(result_left) && !isnan(result_right)) {
-        if(node->right->left == NULL && node->right->right == NULL) {
+        if(node->right->type == NODE_TYPE_NUM) {
             return EXPRESSION_SUCCESS;
         }
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_EVALUATE, node));
+        _LATEX_LOG_WRITE(log_info, SIMPLIFICATION_EVALUATE, node);
 
         _RETURN_IF_ERROR(expression_delete_subtree(expression, node->right));
         node->right = new_node(expression, NODE_TYPE_NUM, {.numeric_value = result_right}, NULL, NULL);
+        node->is_simplified = false;
 
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node));
+        _LATEX_LOG_WRITE(log_info, DIFF_RESULT, node);
         (*changes_counter)++;
         return EXPRESSION_SUCCESS;
     }
 
+    //Subtree below was changed, so the node has to be simplified again
+    if(*changes_counter != changes_before) {
+        node->is_simplified = false;
+    }
     *result = NAN;
     return EXPRESSION_SUCCESS;
 }
 
 /*=========================================================================================================*/
 
-expression_error_t simplify_neutrals(expression_t       *expression,
-                                     expression_node_t  *node,
-                                     size_t             *changes_counter,
-                                     expression_node_t **result,
-                                     latex_log_info_t   *log_info) {
-    _C_ASSERT(expression      != NULL, return EXPRESSION_NULL_POINTER         );
-    _C_ASSERT(result          != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
-    _C_ASSERT(changes_counter != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
-    _C_ASSERT(log_info        != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
+//Tree is simplified in one bottom-up traversal, but the result is the same as of repeating whole-tree
+//passes (constant evaluation, then top-down neutral elements, no descent below folded node) until
+//nothing changes. Rules only look at operands which are numbers and a number never changes, so each
+//subtree is described by number of the pass on which it becomes a number (NotConstantPass if never).
+//Node is checked on the passes when its operands become numbers, and folded on the first one which
+//matches, as the whole-tree passes would do.
+
+static const size_t NotConstantPass = SIZE_MAX;
+
+/*=========================================================================================================*/
 
-    // technical_dump(expression, node, "Trying to simplify neutrals");
-    if(node == NULL) {
+expression_error_t simplify_node(expression_t       *expression,
+                                 expression_node_t **node,
+                                 size_t             *constant_pass,
+                                 latex_log_info_t   *log_info) {
+    _C_ASSERT(expression    != NULL, return EXPRESSION_NULL_POINTER        );
+    _C_ASSERT(node          != NULL, return EXPRESSION_NODE_NULL_POINTER   );
+    _C_ASSERT(constant_pass != NULL, return EXPRESSION_RESULT_NULL_POINTER );
+
+    *constant_pass = NotConstantPass;
+    if(*node == NULL) {
         return EXPRESSION_SUCCESS;
     }
-    if(node->type != NODE_TYPE_OP) {
+    if((*node)->type == NODE_TYPE_NUM) {
+        *constant_pass = 1;
         return EXPRESSION_SUCCESS;
     }
-    if(SupportedOperations[node->value.operation].neutrals_simplifier != NULL) {
-        _RETURN_IF_ERROR(SupportedOperations[node->value.operation].neutrals_simplifier(expression,
-                                                                                        node,
-                                                                                        result,
-                                                                                        log_info));
-    }
-    if(*result != NULL) {
-        (*changes_counter)++;
+    if((*node)->type != NODE_TYPE_OP || (*node)->is_simplified) {
         return EXPRESSION_SUCCESS;
     }
+    //Every change below keeps tree valid, so stopped simplification leaves the best tree found so far
+    _RETURN_IF_ERROR(expression_budget_check(expression->budget, expression->nodes_storage.size));
+
+    size_t left_pass  = NotConstantPass;
+    size_t right_pass = NotConstantPass;
+    _RETURN_IF_ERROR(simplify_node(expression, &(*node)->left , &left_pass , log_info));
+    _RETURN_IF_ERROR(simplify_node(expression, &(*node)->right, &right_pass, log_info));
+
+    size_t passes[] = {1, left_pass < right_pass ? left_pass : right_pass,
+                          left_pass < right_pass ? right_pass : left_pass};
+    for(size_t pass_index = 0; pass_index < sizeof(passes) / sizeof(passes[0]); pass_index++) {
+        size_t pass = passes[pass_index];
+        if(pass == NotConstantPass || (pass_index != 0 && pass == passes[pass_index - 1])) {
+            continue;
+        }
+        expression_node_t *left  = left_pass  <= pass ? (*node)->left  : NULL;
+        expression_node_t *right = right_pass <= pass ? (*node)->right : NULL;
 
-    if(node->left != NULL) {
-        expression_node_t *result_left = NULL;
-        _RETURN_IF_ERROR(simplify_neutrals(expression,
-                                           node->left,
-                                           changes_counter,
-                                           &result_left,
-                                           log_info));
-        if(node->left->is_free) {
-            node->left = NULL;
+        double value = NAN;
+        if(left != NULL && right != NULL) {
+            value = run_operation(left->value.numeric_value, right->value.numeric_value, (*node)->value.operation);
         }
-        if(result_left != NULL) {
-            node->left = result_left;
+        if(!isnan(value)) {
+            _LATEX_LOG_WRITE(log_info, SIMPLIFICATION_EVALUATE, *node);
+            _RETURN_IF_ERROR(set_node_to_const(expression, *node, value));
+            _LATEX_LOG_WRITE(log_info, DIFF_RESULT, *node);
+            *constant_pass = pass;
+            return EXPRESSION_SUCCESS;
         }
-    }
-    if(node->right != NULL) {
-        expression_node_t *result_right = NULL;
-        _RETURN_IF_ERROR(simplify_neutrals(expression,
-                                           node->right,
-                                           changes_counter,
-                                           &result_right,
-                                           log_info));
-        if(node->right->is_free) {
-            node->right = NULL;
+
+        build_fold_t fold = neutral_fold((*node)->value.operation, left, right, &value);
+        if(fold == BUILD_FOLD_NONE) {
+            continue;
         }
-        if(result_right != NULL) {
-            node->right = result_right;
+        //Operand which replaces node is not changed on the pass of folding
+        size_t result_pass = fold == BUILD_FOLD_LEFT  ? left_pass  :
+                             fold == BUILD_FOLD_RIGHT ? right_pass : pass;
+        if(result_pass != NotConstantPass) {
+            *constant_pass = result_pass <= pass ? pass + 1 : result_pass + 1;
         }
+        return simplify_apply_fold(expression, node, fold, value, log_info);
     }
-
-    return EXPRESSION_SUCCESS;
+    if(simplify_is_power_folded(*node)) {
+        return simplify_power(expression, node, constant_pass, log_info);
+    }
+    //Children are already simplified and hashed, so only this node has to be hashed again
+    node_hash_update(*node);
+    if(is_subtree_equal((*node)->left, (*node)->right)) {
+        return simplify_identical(expression, node, constant_pass, log_info);
+    }
+    (*node)->is_simplified = true;
+    return simplify_rewrite(expression, node, constant_pass, log_info);
 }
 
 /*=========================================================================================================*/
 
-expression_error_t simplify_neutrals_add(expression_t       *expression,
-                                         expression_node_t  *node,
-                                         expression_node_t **result,
-                                         latex_log_info_t   *log_info) {
-    _C_ASSERT(expression      != NULL, return EXPRESSION_NULL_POINTER         );
-    _C_ASSERT(result          != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
-    _C_ASSERT(log_info        != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
-    _C_ASSERT(node            != NULL, return EXPRESSION_NODE_NULL_POINTER    );
-
-    if(is_node_equal(node->right, 0)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
-
-        _RETURN_IF_ERROR(expression_delete_subtree(expression, node->right));
-        *result =  node->left;
-
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node->left));
-        return EXPRESSION_SUCCESS;
+bool simplify_is_power_folded(expression_node_t *node) {
+    if(node->value.operation != OPERATION_POW || node->right->type != NODE_TYPE_NUM ||
+       !is_integer(node->right->value.numeric_value)) {
+        return false;
     }
-    if(is_node_equal(node->left, 0)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
-
-        _RETURN_IF_ERROR(expression_delete_subtree(expression, node->left));
-        *result = node->right;
-
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node->right));
-        return EXPRESSION_SUCCESS;
+    if(is_node_equal(node->right, -1)) {
+        return true;
     }
-
-    return EXPRESSION_SUCCESS;
+    //(u ^ a) ^ b is u ^ (a * b) only for integer a, otherwise sign of u could be lost
+    return node->left->type == NODE_TYPE_OP && node->left->value.operation == OPERATION_POW &&
+           node->left->right->type == NODE_TYPE_NUM && is_integer(node->left->right->value.numeric_value);
 }
 
 /*=========================================================================================================*/
 
-expression_error_t simplify_neutrals_sub(expression_t       *expression,
-                                         expression_node_t  *node,
-                                         expression_node_t **result,
-                                         latex_log_info_t   *log_info) {
-    _C_ASSERT(expression      != NULL, return EXPRESSION_NULL_POINTER         );
-    _C_ASSERT(result          != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
-    _C_ASSERT(log_info        != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
-    _C_ASSERT(node            != NULL, return EXPRESSION_NODE_NULL_POINTER    );
-
-    if(is_node_equal(node->right, 0)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
-
-        _RETURN_IF_ERROR(expression_delete_subtree(expression, node->right));
-        *result = node->left;
-
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node->left));
-        return EXPRESSION_SUCCESS;
+expression_error_t simplify_power(expression_t       *expression,
+                                  expression_node_t **node,
+                                  size_t             *constant_pass,
+                                  latex_log_info_t   *log_info) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER     );
+    _C_ASSERT(node       != NULL, return EXPRESSION_NODE_NULL_POINTER);
+    _C_ASSERT(*node      != NULL, return EXPRESSION_NODE_NULL_POINTER);
+
+    //Node is u ^ n with integer n, exponent node is reused
+    expression_node_t *power    = *node;
+    expression_node_t *exponent = power->right;
+    _LATEX_LOG_WRITE(log_info, SIMPLIFICATION_NEUTRALS, power);
+    if(is_node_equal(exponent, -1)) {
+        //u ^ -1 is 1 / u
+        exponent->value.numeric_value = 1;
+        node_hash_update(exponent);
+        power->right           = power->left;
+        power->left            = exponent;
+        power->value.operation = OPERATION_DIV;
     }
-    return EXPRESSION_SUCCESS;
+    else {
+        expression_node_t *inner = power->left;
+        exponent->value.numeric_value *= inner->right->value.numeric_value;
+        node_hash_update(exponent);
+        power->left = inner->left;
+        _RETURN_IF_ERROR(nodes_storage_remove(&expression->nodes_storage, inner->right));
+        _RETURN_IF_ERROR(nodes_storage_remove(&expression->nodes_storage, inner));
+    }
+    power->is_simplified = false;
+    node_hash_update(power);
+    _LATEX_LOG_WRITE(log_info, DIFF_RESULT, power);
+    return simplify_node(expression, node, constant_pass, log_info);
 }
 
 /*=========================================================================================================*/
 
-expression_error_t simplify_neutrals_mul(expression_t       *expression,
-                                         expression_node_t  *node,
-                                         expression_node_t **result,
-                                         latex_log_info_t   *log_info) {
-    _C_ASSERT(expression      != NULL, return EXPRESSION_NULL_POINTER         );
-    _C_ASSERT(result          != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
-    _C_ASSERT(log_info        != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
-    _C_ASSERT(node            != NULL, return EXPRESSION_NODE_NULL_POINTER    );
-
-    if(is_node_equal(node->left, 0) || is_node_equal(node->right, 0)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
-
-        _RETURN_IF_ERROR(set_node_to_const(expression, node, 0));
-        *result = node;
-
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node));
-        return EXPRESSION_SUCCESS;
+expression_error_t simplify_identical(expression_t       *expression,
+                                      expression_node_t **node,
+                                      size_t             *constant_pass,
+                                      latex_log_info_t   *log_info) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER     );
+    _C_ASSERT(node       != NULL, return EXPRESSION_NODE_NULL_POINTER);
+    _C_ASSERT(*node      != NULL, return EXPRESSION_NODE_NULL_POINTER);
+
+    //Node is u op u, where operands are equal subtrees
+    expression_node_t *operation        = *node;
+    operation_t        code             = operation->value.operation;
+    bool               is_power_cheaper = code == OPERATION_MUL && is_square_power_cheaper(operation->left);
+    if(code == OPERATION_SUB || code == OPERATION_DIV) {
+        _LATEX_LOG_WRITE(log_info, SIMPLIFICATION_NEUTRALS, operation);
+        _RETURN_IF_ERROR(set_node_to_const(expression, operation, code == OPERATION_SUB ? 0 : 1));
     }
-    if(is_node_equal(node->right, 1)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
-        _RETURN_IF_ERROR(expression_delete_subtree(expression, node->right));
-        *result = node->left;
-
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node->left));
-        return EXPRESSION_SUCCESS;
+    else if(code == OPERATION_ADD || is_power_cheaper) {
+        expression_node_t *two = new_node(expression, NODE_TYPE_NUM, {.numeric_value = 2}, NULL, NULL);
+        if(two == NULL) {
+            return EXPRESSION_CONTAINER_ALLOCATION_ERROR;
+        }
+        _LATEX_LOG_WRITE(log_info, SIMPLIFICATION_NEUTRALS, operation);
+        _RETURN_IF_ERROR(expression_delete_subtree(expression, operation->right));
+        //u + u is turned to 2 * u and u * u to u ^ 2
+        if(code == OPERATION_ADD) {
+            operation->right           = operation->left;
+            operation->left            = two;
+            operation->value.operation = OPERATION_MUL;
+        }
+        else {
+            operation->right           = two;
+            operation->value.operation = OPERATION_POW;
+        }
     }
-    if(is_node_equal(node->left, 1)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
-        _RETURN_IF_ERROR(expression_delete_subtree(expression, node->left));
-        *result = node->right;
-
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node->right));
-        return EXPRESSION_SUCCESS;
+    else {
+        operation->is_simplified = true;
+        return simplify_rewrite(expression, node, constant_pass, log_info);
     }
-
-    return EXPRESSION_SUCCESS;
+    node_hash_update(operation);
+    _LATEX_LOG_WRITE(log_info, DIFF_RESULT, operation);
+    return simplify_node(expression, node, constant_pass, log_info);
 }
 
 /*=========================================================================================================*/
 
-expression_error_t simplify_neutrals_div(expression_t       *expression,
-                                         expression_node_t  *node,
-                                         expression_node_t **result,
-                                         latex_log_info_t   *log_info) {
-    _C_ASSERT(expression      != NULL, return EXPRESSION_NULL_POINTER         );
-    _C_ASSERT(result          != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
-    _C_ASSERT(log_info        != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
-    _C_ASSERT(node            != NULL, return EXPRESSION_NODE_NULL_POINTER    );
-
-    if(is_node_equal(node->right, 1)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
-
-        _RETURN_IF_ERROR(expression_delete_subtree(expression, node->right));
-        *result = node->left;
+expression_error_t simplify_rewrite(expression_t       *expression,
+                                    expression_node_t **node,
+                                    size_t             *constant_pass,
+                                    latex_log_info_t   *log_info) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER     );
+    _C_ASSERT(node       != NULL, return EXPRESSION_NODE_NULL_POINTER);
 
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node->left));
+    if(expression->rewriter == NULL) {
         return EXPRESSION_SUCCESS;
     }
-    if(is_node_equal(node->left, 0)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
-
-        _RETURN_IF_ERROR(set_node_to_const(expression, node, 0));
-        *result = node;
-
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node));
+    size_t rule = rewriter_find(expression->rewriter, *node);
+    if(rule == RewriteNoRule) {
         return EXPRESSION_SUCCESS;
     }
+    _LATEX_LOG_WRITE(log_info, SIMPLIFICATION_NEUTRALS, *node);
+    _RETURN_IF_ERROR(rewriter_apply(expression->rewriter, expression, node, rule));
+    _LATEX_LOG_WRITE(log_info, DIFF_RESULT, *node);
 
-    return EXPRESSION_SUCCESS;
+    //Rules make tree smaller, so new nodes are simplified again without risk of endless rewriting
+    return simplify_node(expression, node, constant_pass, log_info);
 }
 
 /*=========================================================================================================*/
 
-expression_error_t simplify_neutrals_pow(expression_t       *expression,
-                                         expression_node_t  *node,
-                                         expression_node_t **result,
-                                         latex_log_info_t   *log_info) {
-    _C_ASSERT(expression      != NULL, return EXPRESSION_NULL_POINTER         );
-    _C_ASSERT(result          != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
-    _C_ASSERT(log_info        != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
-    _C_ASSERT(node            != NULL, return EXPRESSION_NODE_NULL_POINTER    );
-
-    if(is_node_equal(node->left, 0)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
-
-        _RETURN_IF_ERROR(set_node_to_const(expression, node, 0));
-        *result = node;
-
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node));
-        return EXPRESSION_SUCCESS;
+expression_error_t simplify_apply_fold(expression_t       *expression,
+                                       expression_node_t **node,
+                                       build_fold_t        fold,
+                                       double              value,
+                                       latex_log_info_t   *log_info) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER      );
+    _C_ASSERT(node       != NULL, return EXPRESSION_NODE_NULL_POINTER );
+    _C_ASSERT(*node      != NULL, return EXPRESSION_NODE_NULL_POINTER );
+
+    _LATEX_LOG_WRITE(log_info, SIMPLIFICATION_NEUTRALS, *node);
+    expression_node_t *folded = *node;
+    switch(fold) {
+        case BUILD_FOLD_CONST: {
+            _RETURN_IF_ERROR(set_node_to_const(expression, folded, value));
+            break;
+        }
+        case BUILD_FOLD_LEFT: {
+            _RETURN_IF_ERROR(expression_delete_subtree(expression, folded->right));
+            *node = folded->left;
+            _RETURN_IF_ERROR(nodes_storage_remove(&expression->nodes_storage, folded));
+            break;
+        }
+        case BUILD_FOLD_RIGHT: {
+            _RETURN_IF_ERROR(expression_delete_subtree(expression, folded->left));
+            *node = folded->right;
+            _RETURN_IF_ERROR(nodes_storage_remove(&expression->nodes_storage, folded));
+            break;
+        }
+        case BUILD_FOLD_NONE: {
+            return EXPRESSION_SUCCESS;
+        }
+        default: {
+            return EXPRESSION_UNKNOWN_ACTION;
+        }
     }
-    if(is_node_equal(node->left, 1)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
-
-        _RETURN_IF_ERROR(set_node_to_const(expression, node, 1));
-        *result = node;
+    _LATEX_LOG_WRITE(log_info, DIFF_RESULT, *node);
+    return EXPRESSION_SUCCESS;
+}
 
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node));
-        return EXPRESSION_SUCCESS;
-    }
-    if(is_node_equal(node->right, 1)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
+/*=========================================================================================================*/
 
-        _RETURN_IF_ERROR(expression_delete_subtree(expression, node->right));
-        *result = node->left;
+expression_error_t expression_simplify(expression_t     *expression,
+                                       latex_log_info_t *log_info) {
+    return expression_simplify_bound(expression, NULL, log_info);
+}
 
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node->left));
-        return EXPRESSION_SUCCESS;
-    }
-    if(is_node_equal(node->right, 0)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
+/*=========================================================================================================*/
 
-        _RETURN_IF_ERROR(set_node_to_const(expression, node, 1));
-        *result = node;
+expression_error_t expression_simplify_bound(expression_t            *expression,
+                                             const bound_variables_t *bound,
+                                             latex_log_info_t        *log_info) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER         );
 
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node));
+    //Constant subtrees are evaluated before neutral elements are searched
+    size_t changes_counter = 0;
+    double evaluating_result = NAN;
+    _RETURN_IF_ERROR(simplify_evaluate_subtree(expression,
+                                               expression->root,
+                                               &evaluating_result,
+                                               &changes_counter,
+                                               bound,
+                                               log_info));
+    if(!isnan(evaluating_result)) {
+        _RETURN_IF_ERROR(expression_delete_subtree(expression, expression->root));
+        expression->root = new_node(expression, NODE_TYPE_NUM, {.numeric_value = evaluating_result}, NULL, NULL);
         return EXPRESSION_SUCCESS;
     }
 
+    size_t constant_pass = NotConstantPass;
+    _RETURN_IF_ERROR(simplify_node(expression, &expression->root, &constant_pass, log_info));
     return EXPRESSION_SUCCESS;
 }
 
 /*=========================================================================================================*/
 
-expression_error_t simplify_neutrals_log(expression_t       *expression,
-                                         expression_node_t  *node,
-                                         expression_node_t **result,
-                                         latex_log_info_t   *log_info) {
-    _C_ASSERT(expression      != NULL, return EXPRESSION_NULL_POINTER         );
-    _C_ASSERT(result          != NULL, return EXPRESSION_RESULT_NULL_POINTER  );
-    _C_ASSERT(log_info        != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
-    _C_ASSERT(node            != NULL, return EXPRESSION_NODE_NULL_POINTER    );
-
-    if(is_node_equal(node->right, 1)) {
-        _RETURN_IF_ERROR(latex_log_write(log_info, SIMPLIFICATION_NEUTRALS, node));
-
-        _RETURN_IF_ERROR(set_node_to_const(expression, node, 0));
-        *result = node;
+expression_error_t expression_invalidate(expression_t      *expression,
+                                         expression_node_t *node) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER     );
+    _C_ASSERT(node       != NULL, return EXPRESSION_NODE_NULL_POINTER);
 
-        _RETURN_IF_ERROR(latex_log_write(log_info, DIFF_RESULT, node));
-        return EXPRESSION_SUCCESS;
+    //Nodes do not know their parents, so path to changed node is searched from root
+    if(!simplify_invalidate_path(expression->root, node)) {
+        return EXPRESSION_NODE_NOT_FOUND;
     }
-
     return EXPRESSION_SUCCESS;
 }
 
 /*=========================================================================================================*/
 
-expression_error_t expression_simplify(expression_t     *expression,
-                                       latex_log_info_t *log_info) {
-    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER         );
-    _C_ASSERT(log_info   != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
-
-    while(true) {
-        size_t changes_counter = 0;
-        double evaluating_result = NAN;
-        _RETURN_IF_ERROR(simplify_evaluate_subtree(expression,
-                                                   expression->root,
-                                                   &evaluating_result,
-                                                   &changes_counter,
-                                                   log_info));
-        if(!isnan(evaluating_result)) {
-            _RETURN_IF_ERROR(expression_delete_subtree(expression, expression->root));
-            expression->root = new_node(expression, NODE_TYPE_NUM, {.numeric_value = evaluating_result}, NULL, NULL);
-            return EXPRESSION_SUCCESS;
-        }
-
-        expression_node_t *simplifying_neutrals_result = NULL;
-        _RETURN_IF_ERROR(simplify_neutrals(expression,
-                                           expression->root,
-                                           &changes_counter,
-                                           &simplifying_neutrals_result,
-                                           log_info));
-        if(simplifying_neutrals_result != NULL) {
-            _RETURN_IF_ERROR(nodes_storage_remove(&expression->nodes_storage, expression->root));
-            expression->root = simplifying_neutrals_result;
-        }
-
-        if(changes_counter == 0) {
-            break;
-        }
+bool simplify_invalidate_path(expression_node_t *subtree,
+                              expression_node_t *node) {
+    if(subtree == NULL) {
+        return false;
     }
-    return EXPRESSION_SUCCESS;
+    if(subtree != node &&
+       !simplify_invalidate_path(subtree->left , node) &&
+       !simplify_invalidate_path(subtree->right, node)) {
+        return false;
+    }
+    subtree->is_simplified = false;
+    //Changed node could be edited in any way, nodes above it only got new children
+    if(subtree == node) {
+        subtree_hash_update(subtree);
+    }
+    else {
+        node_hash_update(subtree);
+    }
+    return true;
 }
@@ -3,8 +3,10 @@
 #include <math.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "expression_utils.h"
+#include "expression_scalar.h"
 #include "utils.h"
 #include "colors.h"
 #include "matan_killer.h"
@@ -17,8 +19,11 @@ static const size_t InitNodesContainersNumber     = 64;
 
 /*=========================================================================================================*/
 
-static expression_error_t nodes_check_containers_array_size (nodes_storage_t *storage);
-static expression_error_t nodes_storage_new_container       (nodes_storage_t *storage);
+static expression_error_t nodes_check_containers_array_size (nodes_storage_t   *storage);
+static expression_error_t nodes_storage_new_container       (nodes_storage_t   *storage);
+static size_t             node_value_key                    (expression_node_t *node);
+static size_t             hash_combine                      (size_t             seed,
+                                                             size_t             value);
 
 /*=========================================================================================================*/
 
@@ -107,6 +112,7 @@ expression_error_t nodes_storage_new_node(nodes_storage_t *storage, expression_n
     storage->free_head->right              = NULL;
     storage->free_head->is_substitution    = false;
     storage->free_head->is_free            = false;
+    storage->free_head->is_simplified      = false;
     *output                                = storage->free_head;
     storage->free_head                     = new_free_head;
     storage->size++;
@@ -127,72 +133,60 @@ expression_error_t nodes_storage_dtor(nodes_storage_t *storage) {
 
 /*=========================================================================================================*/
 
-double run_operation(double left, double right, operation_t operation) {
-    switch(operation) {
-        case OPERATION_ADD: {
-            return left + right;
-        }
-        case OPERATION_SUB: {
-            return left - right;
-        }
-        case OPERATION_DIV: {
-            return left / right;
-        }
-        case OPERATION_MUL: {
-            return left * right;
-        }
-        case OPERATION_SIN: {
-            return sin(right);
-        }
-        case OPERATION_COS: {
-            return cos(right);
-        }
-        case OPERATION_POW: {
-            return pow(left, right);
-        }
-        case OPERATION_LOG: {
-            return log(right) / log(left);
-        }
-        case OPERATION_LN: {
-            return log(right);
-        }
-        case OPERATION_TG: {
-            return tan(right);
-        }
-        case OPERATION_CTG: {
-            return 1 / tan(right);
-        }
-        case OPERATION_ARCSIN: {
-            return asin(right);
-        }
-        case OPERATION_ARCCOS: {
-            return acos(right);
-        }
-        case OPERATION_ARCTG: {
-            return atan(right);
-        }
-        case OPERATION_ARCCTG: {
-            return M_PI * 0.5 - atan(right);
-        }
-        case OPERATION_SH: {
-            return sinh(right);
-        }
-        case OPERATION_CH: {
-            return cosh(right);
-        }
-        case OPERATION_TH: {
-            return tanh(right);
-        }
-        case OPERATION_CTH: {
-            return 1 / tanh(right);
+expression_error_t nodes_storage_merge(nodes_storage_t *storage, nodes_storage_t *other) {
+    _C_ASSERT(storage != NULL, return EXPRESSION_NODES_STORAGE_NULL);
+    _C_ASSERT(other   != NULL, return EXPRESSION_NODES_STORAGE_NULL);
+    _C_ASSERT(storage->container_capacity == other->container_capacity, return EXPRESSION_NODES_STORAGE_NULL);
+
+    size_t containers_used  = storage->capacity / storage->container_capacity;
+    size_t containers_other = other->capacity   / other->container_capacity;
+    if(containers_used + containers_other >= storage->containers_number) {
+        size_t new_containers_number = storage->containers_number;
+        while(containers_used + containers_other >= new_containers_number) {
+            new_containers_number *= 2;
         }
-        case OPERATION_UNKNOWN: {
-            return NAN;
+        expression_node_t **new_containers_array = (expression_node_t **)realloc(storage->containers,
+                                                                                 new_containers_number *
+                                                                                 sizeof(storage->containers[0]));
+        if(new_containers_array == NULL) {
+            print_error("Error while reallocating nodes containers array.\n");
+            return EXPRESSION_CONTAINERS_ARRAY_ALLOCATION_ERROR;
         }
-        default: {
-            return NAN;
+        memset(new_containers_array + storage->containers_number,
+               0,
+               (new_containers_number - storage->containers_number) * sizeof(storage->containers[0]));
+        storage->containers        = new_containers_array;
+        storage->containers_number = new_containers_number;
+    }
+
+    for(size_t container = 0; container < containers_other; container++) {
+        storage->containers[containers_used + container] = other->containers[container];
+    }
+
+    //Free list of other storage is prepended so that both lists stay NULL terminated
+    if(other->free_head != NULL) {
+        expression_node_t *other_tail = other->free_head;
+        while(other_tail->right != NULL) {
+            other_tail = other_tail->right;
         }
+        other_tail->right  = storage->free_head;
+        storage->free_head = other->free_head;
     }
+
+    storage->capacity += other->capacity;
+    storage->size     += other->size;
+
+    free(other->containers);
+    if(memset(other, 0, sizeof(*other)) != other) {
+        return EXPRESSION_SETTING_TO_ZERO_ERROR;
+    }
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+double run_operation(double left, double right, operation_t operation) {
+    return run_scalar_operation(left, right, operation);
 }
 
 /*=========================================================================================================*/
@@ -212,6 +206,7 @@ expression_node_t *new_node(expression_t      *expression,
     node->value = value;
     node->left = left;
     node->right = right;
+    node_hash_update(node);
     return node;
 }
 
@@ -222,11 +217,28 @@ expression_node_t *copy_node(expression_t *derivative, expression_node_t *node)
         return NULL;
     }
 
-    return new_node(derivative,
-                    node->type,
-                    node->value,
-                    copy_node(derivative, node->left),
-                    copy_node(derivative, node->right));
+    expression_node_t *copy = new_node(derivative,
+                                       node->type,
+                                       node->value,
+                                       copy_node(derivative, node->left),
+                                       copy_node(derivative, node->right));
+    //Copy of simplified subtree does not need to be simplified again
+    if(copy != NULL) {
+        copy->is_simplified = node->is_simplified;
+    }
+    return copy;
+}
+
+/*=========================================================================================================*/
+
+double run_power(double base, double exponent) {
+    return run_scalar_power(base, exponent);
+}
+
+/*=========================================================================================================*/
+
+double run_integer_power(double base, long power) {
+    return run_scalar_integer_power(base, power);
 }
 
 /*=========================================================================================================*/
@@ -356,6 +368,7 @@ expression_error_t set_node_to_const(expression_t *expression, expression_node_t
     node->is_substitution = false;
     node->type = NODE_TYPE_NUM;
     node->value.numeric_value = value;
+    node_hash_update(node);
 
     return EXPRESSION_SUCCESS;
 }
@@ -374,3 +387,83 @@ bool is_bigger_priority(expression_node_t *node, expression_node_t *child) {
     }
     return false;
 }
+
+/*=========================================================================================================*/
+
+size_t node_value_key(expression_node_t *node) {
+    _C_ASSERT(node != NULL, return 0);
+
+    switch(node->type) {
+        case NODE_TYPE_NUM: {
+            uint64_t bits = 0;
+            memcpy(&bits, &node->value.numeric_value, sizeof(bits));
+            return (size_t)bits;
+        }
+        case NODE_TYPE_VAR: {
+            return node->value.variable_index;
+        }
+        case NODE_TYPE_OP: {
+            return (size_t)node->value.operation;
+        }
+        default: {
+            return 0;
+        }
+    }
+}
+
+/*=========================================================================================================*/
+
+size_t hash_combine(size_t seed, size_t value) {
+    //Finalizer of murmur hash spreads value bits, so that low bits can be used as table index
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccd;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53;
+    value ^= value >> 33;
+    return seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
+}
+
+/*=========================================================================================================*/
+
+size_t node_hash_update(expression_node_t *node) {
+    if(node == NULL) {
+        return 0;
+    }
+
+    //Hash of node is built from hashes of children, so changing a node only needs the path to root
+    size_t hash = hash_combine((size_t)node->type + 1, node_value_key(node));
+    hash = hash_combine(hash, node->left  == NULL ? 0 : node->left->hash );
+    hash = hash_combine(hash, node->right == NULL ? 0 : node->right->hash);
+    node->hash = hash;
+    return hash;
+}
+
+/*=========================================================================================================*/
+
+size_t subtree_hash_update(expression_node_t *node) {
+    if(node == NULL) {
+        return 0;
+    }
+
+    subtree_hash_update(node->left );
+    subtree_hash_update(node->right);
+    return node_hash_update(node);
+}
+
+/*=========================================================================================================*/
+
+bool is_subtree_equal(expression_node_t *first, expression_node_t *second) {
+    if(first == second) {
+        return true;
+    }
+    if(first == NULL || second == NULL) {
+        return false;
+    }
+    if(first->hash != second->hash ||
+       first->type != second->type ||
+       node_value_key(first) != node_value_key(second)) {
+        return false;
+    }
+    return is_subtree_equal(first->left , second->left ) &&
+           is_subtree_equal(first->right, second->right);
+}
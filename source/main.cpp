@@ -6,14 +6,39 @@
 
 #include "variable_list.h"
 #include "matan_killer.h"
+#include "expression_cse.h"
+#include "expression_rewrite.h"
+#include "expression_budget.h"
+#include "expression_emit.h"
+#include "expression_plot.h"
 #include "diff_dump.h"
 #include "diff_dump.h"
 
+//Pathological inputs are stopped instead of running for minutes
+static const double MaxSeconds = 10;
+static const size_t MaxNodes   = 1 << 24;
+
+static const char  *EmittedHeaderFilename = "logs/expression.h";
+static const size_t MaxEmittedNameSize    = 32;
+
+static const char  *PlotFilename          = "logs/plot.txt";
+static const size_t PlotInitialIntervals  = 16;
+static const size_t PlotMaxDepth          = 30;
+static const size_t PlotMaxPoints         = 1 << 20;
+
 int main(int argc, const char *argv[]) {
-    if(argc != 2) {
+    if(argc != 2 && argc != 3) {
         printf("Unexpected amount of console parameters.\n");
         return EXIT_FAILURE;
     }
+    //Optional second parameter is a file with extra rewrite rules
+    rewriter_t rewriter = {};
+    printf("rules ctor| %d\n", rewriter_ctor(&rewriter));
+    if(argc == 3) {
+        printf("rules load| %d\n", rewriter_load_file(&rewriter, argv[2]));
+    }
+    expression_budget_t budget = {};
+    printf("budget    | %d\n", expression_budget_ctor(&budget, MaxSeconds, MaxNodes));
     if(strcmp(argv[1], "--diff") == 0) {
         variables_list_t varlist = {};
         printf("vars ctor | %d\n", variables_list_ctor(&varlist));
@@ -23,6 +48,10 @@ int main(int argc, const char *argv[]) {
 
         expression_t derivative = {};
         printf("diff ctor | %d\n", expression_ctor(&derivative, "derv", &varlist));
+        expression.rewriter = &rewriter;
+        derivative.rewriter = &rewriter;
+        expression.budget   = &budget;
+        derivative.budget   = &budget;
 
         latex_log_info_t log_info = {};
         printf("log ctor  | %d\n", latex_log_ctor(&log_info, "diff", &expression, &derivative));
@@ -30,7 +59,11 @@ int main(int argc, const char *argv[]) {
 
         printf("diff      | %d\n", expression_differentiate(&expression, &derivative, &log_info));
 
+        cse_program_t program = {};
+        printf("cse ctor  | %d\n", cse_program_ctor(&program, derivative.root));
+        printf("cse mark  | %d\n", cse_program_mark_substitutions(&program, derivative.root, &log_info));
         latex_log_write(&log_info, WRITING_RESULT, derivative.root);
+        printf("cse dtor  | %d\n", cse_program_dtor(&program));
 
         printf("dtor log  | %d\n", latex_log_dtor(&log_info));
         printf("dtor expr | %d\n", expression_dtor(&expression));
@@ -47,6 +80,10 @@ int main(int argc, const char *argv[]) {
 
         expression_t derivative = {};
         printf("diff ctor | %d\n", expression_ctor(&derivative, "derv", &varlist));
+        expression.rewriter = &rewriter;
+        derivative.rewriter = &rewriter;
+        expression.budget   = &budget;
+        derivative.budget   = &budget;
 
         latex_log_info_t log_info = {};
         printf("log ctor  | %d\n", latex_log_ctor(&log_info, "tailor", &expression, &derivative));
@@ -59,9 +96,99 @@ int main(int argc, const char *argv[]) {
         printf("diff dtor | %d\n", expression_dtor(&derivative));
         printf("log dtor  | %d\n", latex_log_dtor(&log_info));
     }
+    else if(strcmp(argv[1], "--emit-cpp") == 0) {
+        variables_list_t varlist = {};
+        printf("vars ctor | %d\n", variables_list_ctor(&varlist));
+
+        expression_t expression = {};
+        printf("expr ctor | %d\n", expression_ctor(&expression, "expr", &varlist));
+        printf("expr read | %d\n", expression_read_from_user(&expression, NULL));
+
+        expression_t derivative = {};
+        printf("diff ctor | %d\n", expression_ctor(&derivative, "derv", &varlist));
+        expression.rewriter = &rewriter;
+        derivative.rewriter = &rewriter;
+        expression.budget   = &budget;
+        derivative.budget   = &budget;
+
+        //Function is written as f, its derivatives as f_d1, f_d2 and so on
+        size_t derivatives_number = 0;
+        printf("Enter number of derivatives:\n");
+        if(scanf("%zu", &derivatives_number) != 1) {
+            derivatives_number = 0;
+        }
+        FILE *header = fopen(EmittedHeaderFilename, "w");
+        if(header == NULL) {
+            printf("Error while opening '%s'.\n", EmittedHeaderFilename);
+        }
+        else {
+            printf("emit begin| %d\n", emit_cpp_header_begin(header));
+            printf("emit f    | %d\n", emit_cpp_function(header, &expression, "f"));
+            for(size_t order = 1; order <= derivatives_number; order++) {
+                char name[MaxEmittedNameSize] = {};
+                snprintf(name, MaxEmittedNameSize, "f_d%lu", order);
+                printf("diff      | %d\n", expression_differentiate(order == 1 ? &expression : &derivative, &derivative, NULL));
+                printf("emit %-5s| %d\n", name, emit_cpp_function(header, &derivative, name));
+            }
+            printf("emit end  | %d\n", emit_cpp_header_end(header));
+            fclose(header);
+        }
+
+        printf("vars dtor | %d\n", variables_list_dtor(&varlist));
+        printf("expr dtor | %d\n", expression_dtor(&expression));
+        printf("diff dtor | %d\n", expression_dtor(&derivative));
+    }
+    else if(strcmp(argv[1], "--plot") == 0) {
+        variables_list_t varlist = {};
+        printf("vars ctor | %d\n", variables_list_ctor(&varlist));
+
+        expression_t expression = {};
+        printf("expr ctor | %d\n", expression_ctor(&expression, "expr", &varlist));
+        printf("expr read | %d\n", expression_read_from_user(&expression, NULL));
+        //Plotted variable is the first one, the rest need values
+        if(varlist.size > 1) {
+            printf("vars set  | %d\n", variables_list_set_from_console(&varlist));
+        }
+
+        expression_t derivative        = {};
+        expression_t second_derivative = {};
+        printf("diff ctor | %d\n", expression_ctor(&derivative,        "derv", &varlist));
+        printf("diff ctor | %d\n", expression_ctor(&second_derivative, "dder", &varlist));
+        expression.rewriter        = &rewriter;
+        derivative.rewriter        = &rewriter;
+        second_derivative.rewriter = &rewriter;
+        expression.budget          = &budget;
+        derivative.budget          = &budget;
+        second_derivative.budget   = &budget;
+        printf("diff      | %d\n", expression_differentiate(&expression, &derivative,        NULL));
+        printf("diff      | %d\n", expression_differentiate(&derivative, &second_derivative, NULL));
+
+        plot_settings_t settings = {};
+        settings.initial_intervals = PlotInitialIntervals;
+        settings.max_depth         = PlotMaxDepth;
+        settings.max_points        = PlotMaxPoints;
+        printf("Enter start, end and tolerance:\n");
+        if(scanf("%lg %lg %lg", &settings.start, &settings.end, &settings.tolerance) != 3) {
+            printf("Error while reading plot settings.\n");
+        }
+
+        plot_t plot = {};
+        printf("plot ctor | %d\n", plot_ctor(&plot));
+        printf("plot      | %d\n", plot_sample(&plot, &expression, &derivative, &second_derivative, &settings));
+        printf("plot write| %d\n", plot_write(&plot, PlotFilename));
+        printf("Plot has %lu points after %lu evaluations.\n", plot.size, plot.evaluations);
+        printf("plot dtor | %d\n", plot_dtor(&plot));
+
+        printf("vars dtor | %d\n", variables_list_dtor(&varlist));
+        printf("expr dtor | %d\n", expression_dtor(&expression));
+        printf("diff dtor | %d\n", expression_dtor(&derivative));
+        printf("diff dtor | %d\n", expression_dtor(&second_derivative));
+    }
     else {
         printf("Unknown flag '%s'.\n", argv[1]);
+        rewriter_dtor(&rewriter);
         return EXIT_FAILURE;
     }
+    printf("rules dtor| %d\n", rewriter_dtor(&rewriter));
     return EXIT_SUCCESS;
 }
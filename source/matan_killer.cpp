@@ -11,25 +11,32 @@
 #include "colors.h"
 #include "utils.h"
 #include "expression_utils.h"
+#include "expression_scalar.h"
 #include "expression_simplify.h"
+#include "expression_normalize.h"
 #include "diff_dump.h"
 #include "string_parser.h"
+#include "diff_memo.h"
+#include "diff_parallel.h"
+#include "expression_budget.h"
 #include "custom_assert.h"
 
 /*=========================================================================================================*/
 
 static const size_t MaxFunctionNameLength = 32;
+//Simplification and normalization can undo each other, so their alternation is bounded
+static const size_t MaxNormalizeRounds    = 8;
 
 /*=========================================================================================================*/
 
-static expression_error_t expression_read_from_file    (char             **expression_string,
-                                                        const char        *filename);
+static expression_error_t expression_read_from_file     (char                   **expression_string,
+                                                         const char              *filename);
 
-static expression_error_t expression_read_from_console (char             **expression_string);
+static expression_error_t expression_read_from_console  (char                   **expression_string);
 
-static expression_error_t expression_evaluate_node     (expression_t      *expression,
-                                                        expression_node_t *node,
-                                                        double            *output);
+static expression_error_t expression_simplify_normalize (expression_t            *expression,
+                                                         const bound_variables_t *bound,
+                                                         latex_log_info_t        *log_info);
 
 /*=========================================================================================================*/
 
@@ -38,12 +45,14 @@ expression_error_t expression_ctor(expression_t     *expression,
                                    variables_list_t *variables_list) {
     _C_ASSERT(expression         != NULL, return EXPRESSION_NULL_POINTER       );
     _C_ASSERT(variables_list     != NULL, return EXPRESSION_VARIABLES_LIST_NULL);
-    _C_ASSERT(technical_filename != NULL, return EXPRESSION_INVALID_FILENAME   );
 
     expression->variables_list = variables_list;
     _RETURN_IF_ERROR(nodes_storage_ctor(&expression->nodes_storage));
 
-    _RETURN_IF_ERROR(technical_dump_ctor(expression, technical_filename));
+    //Expression without technical filename is headless and does not create dump files
+    if(technical_filename != NULL) {
+        _RETURN_IF_ERROR(technical_dump_ctor(expression, technical_filename));
+    }
     return EXPRESSION_SUCCESS;
 }
 
@@ -117,7 +126,11 @@ expression_error_t expression_evaluate(expression_t *expression,
     _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER       );
     _C_ASSERT(result     != NULL, return EXPRESSION_RESULT_NULL_POINTER);
 
-    _RETURN_IF_ERROR(expression_evaluate_node(expression, expression->root, result));
+    double variables[MaxVarsNumber] = {};
+    for(size_t variable = 0; variable < expression->variables_list->size; variable++) {
+        _RETURN_IF_ERROR(variables_list_get_value(expression->variables_list, variable, variables + variable));
+    }
+    _RETURN_IF_ERROR(expression_evaluate_scalar(expression, variables, result));
     return EXPRESSION_SUCCESS;
 }
 
@@ -138,52 +151,101 @@ expression_error_t expression_dtor(expression_t *expression) {
 
 /*=========================================================================================================*/
 
-expression_error_t expression_evaluate_node(expression_t      *expression,
-                                            expression_node_t *node,
-                                            double            *output) {
-    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER       );
-    _C_ASSERT(node       != NULL, return EXPRESSION_NODE_NULL_POINTER  );
-    _C_ASSERT(output     != NULL, return EXPRESSION_RESULT_NULL_POINTER);
+expression_error_t expression_differentiate(expression_t     *expression,
+                                            expression_t     *derivative,
+                                            latex_log_info_t *log_info) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(derivative != NULL, return EXPRESSION_NULL_POINTER);
 
-    if(node->type == NODE_TYPE_NUM) {
-        *output = node->value.numeric_value;
-        return EXPRESSION_SUCCESS;
-    }
-    if(node->type == NODE_TYPE_VAR) {
-        _RETURN_IF_ERROR(variables_list_get_value(expression->variables_list, node->value.variable_index, output));
-        return EXPRESSION_SUCCESS;
-    }
-    if(node->type == NODE_TYPE_OP) {
-        double left = 0, right = 0;
-        if(node->left != NULL) {
-            _RETURN_IF_ERROR(expression_evaluate_node(expression, node->left, &left));
-        }
-        if(node->right != NULL) {
-            _RETURN_IF_ERROR(expression_evaluate_node(expression, node->right, &right));
-        }
+    diff_memo_t diff_memo = {};
+    _RETURN_IF_ERROR(diff_memo_ctor(&diff_memo, expression->root));
+    derivative->diff_memo = &diff_memo;
 
-        *output = run_operation(left, right, node->value.operation);
-        return EXPRESSION_SUCCESS;
+    expression_node_t *root = differentiate_node(derivative, expression->root, 0, log_info);
+
+    derivative->diff_memo = NULL;
+    _RETURN_IF_ERROR(diff_memo_dtor(&diff_memo, derivative));
+    //Derivative keeps its old root if differentiation was stopped
+    if(root == NULL) {
+        _RETURN_IF_ERROR(expression_budget_check(derivative->budget, derivative->nodes_storage.size));
+        return EXPRESSION_DIFFERENTIATING_ERROR;
     }
+    derivative->root = root;
+    //Stopped simplification leaves valid, but not fully simplified derivative
+    _RETURN_IF_ERROR(expression_simplify_normalize(derivative, NULL, log_info));
 
-    return EXPRESSION_UNKNOWN_NODE_TYPE;
+    return EXPRESSION_SUCCESS;
 }
 
 /*=========================================================================================================*/
 
-expression_error_t expression_differentiate(expression_t     *expression,
-                                            expression_t     *derivative,
-                                            latex_log_info_t *log_info) {
+expression_error_t expression_differentiate_parallel(expression_t *expression,
+                                                     expression_t *derivative,
+                                                     size_t        threads_number) {
     _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER);
     _C_ASSERT(derivative != NULL, return EXPRESSION_NULL_POINTER);
 
-    derivative->root = differentiate_node(derivative, expression->root, 0, log_info);
+    diff_parallel_t diff_parallel = {};
+    expression_error_t error_code = diff_parallel_ctor(&diff_parallel, expression->root, threads_number);
+    if(error_code == EXPRESSION_SUCCESS) {
+        error_code = diff_parallel_run(&diff_parallel, derivative, 0, threads_number);
+    }
+    if(error_code == EXPRESSION_SUCCESS) {
+        derivative->diff_parallel = &diff_parallel;
+        derivative->root = differentiate_node(derivative, expression->root, 0, NULL);
+        derivative->diff_parallel = NULL;
+    }
+    _RETURN_IF_ERROR(diff_parallel_dtor(&diff_parallel, derivative));
+    _RETURN_IF_ERROR(error_code);
     if(derivative->root == NULL) {
         return EXPRESSION_DIFFERENTIATING_ERROR;
     }
-    _RETURN_IF_ERROR(expression_simplify(derivative, log_info));
+    _RETURN_IF_ERROR(expression_simplify_normalize(derivative, NULL, NULL));
+
+    return EXPRESSION_SUCCESS;
+}
+
+/*=========================================================================================================*/
+
+//Subtrees which depend only on bound variables are folded to numbers, so specialized expression
+//is smaller and cheaper to differentiate and evaluate many times
+expression_error_t expression_specialize(expression_t            *expression,
+                                         const bound_variables_t *bound,
+                                         expression_t            *specialized,
+                                         latex_log_info_t        *log_info) {
+    _C_ASSERT(expression  != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(bound       != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(specialized != NULL, return EXPRESSION_NULL_POINTER);
+
+    expression_node_t *root = copy_node(specialized, expression->root);
+    if(root == NULL) {
+        return EXPRESSION_CONTAINER_ALLOCATION_ERROR;
+    }
+    specialized->root = root;
+    _RETURN_IF_ERROR(expression_simplify_normalize(specialized, bound, log_info));
 
+    return EXPRESSION_SUCCESS;
+}
 
+/*=========================================================================================================*/
+
+//Normalization builds new sums, products and powers which can match rules of simplification,
+//so simplification is repeated on them while it changes the tree
+expression_error_t expression_simplify_normalize(expression_t            *expression,
+                                                 const bound_variables_t *bound,
+                                                 latex_log_info_t        *log_info) {
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER);
+
+    _RETURN_IF_ERROR(expression_simplify_bound(expression, bound, log_info));
+    _RETURN_IF_ERROR(expression_normalize(expression, log_info));
+    for(size_t round = 1; round < MaxNormalizeRounds; round++) {
+        size_t hash = subtree_hash_update(expression->root);
+        _RETURN_IF_ERROR(expression_simplify(expression, log_info));
+        if(subtree_hash_update(expression->root) == hash) {
+            break;
+        }
+        _RETURN_IF_ERROR(expression_normalize(expression, log_info));
+    }
     return EXPRESSION_SUCCESS;
 }
 
@@ -193,9 +255,8 @@ expression_error_t expression_tailor(expression_t     *expression,
                                      expression_t     *tailor,
                                      size_t            members,
                                      latex_log_info_t *log_info) {
-    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER         );
-    _C_ASSERT(tailor     != NULL, return EXPRESSION_NULL_POINTER         );
-    _C_ASSERT(log_info   != NULL, return EXPRESSION_LOG_INFO_NULL_POINTER);
+    _C_ASSERT(expression != NULL, return EXPRESSION_NULL_POINTER);
+    _C_ASSERT(tailor     != NULL, return EXPRESSION_NULL_POINTER);
 
     _RETURN_IF_ERROR(nodes_storage_new_node(&tailor->nodes_storage, &tailor->root));
     double point = 0;
@@ -205,11 +266,12 @@ expression_error_t expression_tailor(expression_t     *expression,
     expression_node_t *prev_node = NULL;
     expression_node_t *current_node = tailor->root;
     double factorial = 1;
+    expression_error_t error_code = EXPRESSION_SUCCESS;
     for(size_t mem = 0; mem < members; mem++) {
         double value = 0;
         _RETURN_IF_ERROR(expression_evaluate(expression, &value));
-        _RETURN_IF_ERROR(latex_log_write(log_info, TAILOR_EVALUATE, expression->root, mem, value));
-        _RETURN_IF_ERROR(latex_log_write(log_info, TAILOR_NEW_DIFF, expression->root, mem));
+        _LATEX_LOG_WRITE(log_info, TAILOR_EVALUATE, expression->root, mem, value);
+        _LATEX_LOG_WRITE(log_info, TAILOR_NEW_DIFF, expression->root, mem);
         expression_node_t *new_member = new_node(tailor, NODE_TYPE_OP, {.operation = OPERATION_MUL},
                                                  new_node(tailor, NODE_TYPE_NUM, {.numeric_value = value / factorial}, NULL, NULL),
                                                  new_node(tailor, NODE_TYPE_OP , {.operation = OPERATION_POW},
@@ -219,18 +281,29 @@ expression_error_t expression_tailor(expression_t     *expression,
                                                           new_node(tailor, NODE_TYPE_NUM, {.numeric_value = (double)mem}, NULL, NULL)));
         factorial *= (double)(mem + 1);
         if(mem + 1 != members) {
-            current_node->left = new_member;
-            _RETURN_IF_ERROR(expression_differentiate(expression, expression, log_info));
-            _RETURN_IF_ERROR(latex_log_write(log_info, WRITING_RESULT, expression->root));
-            current_node->right = new_node(tailor, NODE_TYPE_OP, {.operation = OPERATION_ADD}, NULL, NULL);
-            prev_node = current_node;
-            current_node = current_node->right;
+            error_code = expression_budget_check(tailor->budget, tailor->nodes_storage.size);
+            if(error_code == EXPRESSION_SUCCESS) {
+                error_code = expression_differentiate(expression, expression, log_info);
+            }
         }
-        else {
-            _RETURN_IF_ERROR(nodes_storage_remove(&tailor->nodes_storage, prev_node->right));
-            prev_node->right = new_member;
+        //Series is closed by the last member, or by current one if budget is over
+        if(mem + 1 == members || error_code != EXPRESSION_SUCCESS) {
+            _RETURN_IF_ERROR(nodes_storage_remove(&tailor->nodes_storage, current_node));
+            if(prev_node == NULL) {
+                tailor->root = new_member;
+            }
+            else {
+                prev_node->right = new_member;
+            }
+            break;
         }
+        current_node->left = new_member;
+        _LATEX_LOG_WRITE(log_info, WRITING_RESULT, expression->root);
+        current_node->right = new_node(tailor, NODE_TYPE_OP, {.operation = OPERATION_ADD}, NULL, NULL);
+        prev_node = current_node;
+        current_node = current_node->right;
     }
+    _RETURN_IF_ERROR(error_code);
     _RETURN_IF_ERROR(expression_simplify(tailor, log_info));
     return EXPRESSION_SUCCESS;
 }
@@ -47,6 +47,8 @@ expression_error_t read_expression(expression_t  *expression,
         return EXPRESSION_READING_ERROR;
     }
     parser_info->position++;
+    //Parser fills nodes after they are allocated, so hashes are set when the whole tree is read
+    subtree_hash_update(root);
     expression->root = root;
     return EXPRESSION_SUCCESS;
 }
@@ -181,7 +183,7 @@ expression_error_t expression_get_num(expression_t       *expression,
         parser_info->position++;
     }
     if(parser_info->input[parser_info->position] != '.') {
-        (*output)->value.numeric_value = result;
+        (*output)->value.numeric_value = result * multiplier;
         return EXPRESSION_SUCCESS;
     }
     parser_info->position++;
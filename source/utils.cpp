@@ -18,6 +18,10 @@ bool is_equal(double first, double second) {
     return false;
 }
 
+bool is_integer(double value) {
+    return fpclassify(value - rint(value)) == FP_ZERO;
+}
+
 size_t get_random_index(size_t size) {
     return (size_t)rand() % size;
 }